@@ -20,6 +20,9 @@ let package = Package(
         .target(
             name: "SwiftLibUSB",
             dependencies: ["CoreSwiftVISA", "Usb"]),
+        .target(
+            name: "SwiftLibUSBBenchmarks",
+            dependencies: ["SwiftLibUSB"]),
         .testTarget(
             name: "SwiftLibUSBTests",
             dependencies: ["SwiftLibUSB"])
@@ -0,0 +1,151 @@
+//
+//  CommandBatch.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// Packs SCPI commands into messages and splits the combined responses.
+///
+/// IEEE 488.2 lets a program message hold several commands separated by `;`. A device answers all of the queries in
+/// one message with a single response message, again separated by `;`.
+internal enum CommandBatch {
+    /// Groups of commands that are sent together as one message.
+    struct Pack {
+        /// The commands joined with `;`, without a terminator
+        var message: String
+        /// The number of queries in the message, and so the number of responses it produces
+        var queryCount: Int
+    }
+
+    /// Pack commands, in order, into messages of at most `maxLength` bytes.
+    ///
+    /// Commands after a `;` are interpreted relative to the header of the command before them, so each command that is
+    /// not already rooted with `:` or a common command starting with `*` is rooted before being joined. A single
+    /// command longer than `maxLength` is sent in a message by itself.
+    /// - Parameters:
+    ///   - commands: The commands to pack
+    ///   - maxLength: The largest message, in UTF-8 bytes, to build, including `terminatorLength`
+    ///   - terminatorLength: The number of bytes the write terminator adds to each message
+    /// - Returns: The messages to send, in order
+    static func pack(_ commands: [String], maxLength: Int, terminatorLength: Int) -> [Pack] {
+        var packs: [Pack] = []
+        var current = Pack(message: "", queryCount: 0)
+        var currentLength = 0
+
+        for command in commands {
+            let trimmed = command.trimmingCharacters(in: .whitespacesAndNewlines)
+            if trimmed.isEmpty {
+                continue
+            }
+            let rooted = trimmed.hasPrefix(":") || trimmed.hasPrefix("*") ? trimmed : ":" + trimmed
+            let length = rooted.utf8.count
+
+            if currentLength > 0 && currentLength + 1 + length + terminatorLength > maxLength {
+                packs.append(current)
+                current = Pack(message: "", queryCount: 0)
+                currentLength = 0
+            }
+            if currentLength > 0 {
+                current.message += ";"
+                currentLength += 1
+            }
+            current.message += rooted
+            currentLength += length
+            current.queryCount += queryCount(rooted)
+        }
+
+        if currentLength > 0 {
+            packs.append(current)
+        }
+        return packs
+    }
+
+    /// The number of queries in a command that may itself hold several commands joined with `;`, such as
+    /// `"VOLT 1;VOLT?"`.
+    static func queryCount(_ command: String) -> Int {
+        split(command).filter { unit in
+            isQuery(unit.trimmingCharacters(in: .whitespacesAndNewlines))
+        }.count
+    }
+
+    /// True if the header of `command`, the part before any parameters, ends in `?`.
+    static func isQuery(_ command: String) -> Bool {
+        let header = command.prefix { !$0.isWhitespace }
+        return header.hasSuffix("?")
+    }
+
+    /// Split a response message into the responses of its queries.
+    ///
+    /// Responses are separated by `;`. Separators inside quoted strings are kept, and a doubled quote inside a string
+    /// stands for one quote character, as IEEE 488.2 describes.
+    /// - Parameter response: The response message, without its terminator
+    /// - Returns: The response to each query, in order
+    static func split(_ response: String) -> [String] {
+        var units: [String] = []
+        var unitStart = response.startIndex
+        var quote: Character? = nil
+
+        var index = response.startIndex
+        while index < response.endIndex {
+            let character = response[index]
+            if let open = quote {
+                if character == open {
+                    quote = nil
+                }
+            } else if character == "\"" || character == "'" {
+                quote = character
+            } else if character == ";" {
+                units.append(String(response[unitStart..<index]))
+                unitStart = response.index(after: index)
+            }
+            index = response.index(after: index)
+        }
+        units.append(String(response[unitStart...]))
+        return units
+    }
+}
+
+extension USBTMCInstrument {
+    /// Send many SCPI commands using as few messages as possible, and return the response to each query.
+    ///
+    /// Commands are joined with `;` into messages that fit in `maxMessageLength` bytes, so a message of short commands
+    /// goes out as a single bulk transfer. Each message holding queries is sent with ``query(_:writeTerminator:readTerminator:strippingTerminator:encoding:chunkSize:)``
+    /// and its single response is split back into one response per query; messages without queries are only written.
+    /// Messages are sent in the order of `commands`, so settings take effect before the queries that follow them.
+    ///
+    /// Responses that are definite length blocks may contain `;` and should be read with ``readBlock(chunkSize:)``
+    /// instead.
+    /// - Parameters:
+    ///   - commands: The commands and queries to send, such as `[":SOUR:VOLT 1.0", ":MEAS:CURR?"]`
+    ///   - maxMessageLength: The largest message, in bytes, the device accepts. Defaults to one bulk transfer.
+    /// - Returns: The response to each query in `commands`, in order
+    /// - Throws: ``USBTMCInstrument/Error/responseCountMismatch`` if a response does not hold one response for each query, or any error thrown while writing or reading
+    public func batch(_ commands: [String], maxMessageLength: Int? = nil) throws -> [String] {
+        lock.lock()
+        defer { lock.unlock() }
+
+        let packs = CommandBatch.pack(
+            commands,
+            maxLength: maxMessageLength ?? Self.maxWriteChunkSize,
+            terminatorLength: attributes.writeTerminator.utf8.count)
+
+        var responses: [String] = []
+        for pack in packs {
+            if pack.queryCount == 0 {
+                _ = try write(pack.message, appending: attributes.writeTerminator, encoding: attributes.encoding)
+                continue
+            }
+
+            let response = try query(pack.message)
+            let units = CommandBatch.split(response)
+            if units.count != pack.queryCount {
+                throw Error.responseCountMismatch
+            }
+            responses.append(contentsOf: units)
+        }
+        return responses
+    }
+}
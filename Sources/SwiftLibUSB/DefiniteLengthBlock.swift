@@ -0,0 +1,230 @@
+//
+//  DefiniteLengthBlock.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// Follows an IEEE 488.2 definite length arbitrary block, `#<n><length><payload>`, as its bytes arrive.
+///
+/// The header may be split across chunks. Once it has been parsed, the payload is passed on as it is consumed, and
+/// anything after the payload is ignored.
+internal struct DefiniteLengthBlockReader {
+    /// The number of payload bytes not yet consumed, once the header has been parsed.
+    private(set) var remaining: Int?
+    /// The number of digits in the length field, once the `#` and the digit count have been parsed.
+    private var digitCount: Int?
+    private var digitsRead = 0
+    private var partialLength = 0
+    private var sawHash = false
+
+    /// True once the whole payload has been consumed.
+    var isComplete: Bool {
+        remaining == 0
+    }
+
+    /// Consume the next bytes of the block.
+    /// - Parameters:
+    ///   - bytes: The next bytes received
+    ///   - start: Called with the payload length once the header has been parsed
+    ///   - body: Called with the payload bytes in `bytes`, if there are any
+    /// - Throws: ``USBTMCInstrument/Error/invalidBlock`` if the bytes are not a definite length block, or any error thrown by `start` or `body`
+    mutating func consume(
+        _ bytes: UnsafeRawBufferPointer,
+        start: (Int) throws -> Void,
+        body: (UnsafeRawBufferPointer) throws -> Void
+    ) throws {
+        var offset = 0
+        while remaining == nil && offset < bytes.count {
+            try consumeHeader(byte: bytes[offset])
+            offset += 1
+            if let length = remaining {
+                try start(length)
+            }
+        }
+
+        guard let left = remaining else {
+            return
+        }
+        let count = min(left, bytes.count - offset)
+        if count > 0 {
+            try body(UnsafeRawBufferPointer(rebasing: bytes[offset..<offset + count]))
+            remaining = left - count
+        }
+    }
+
+    /// Parse one byte of the header.
+    private mutating func consumeHeader(byte: UInt8) throws {
+        if !sawHash {
+            guard byte == UInt8(ascii: "#") else {
+                throw USBTMCInstrument.Error.invalidBlock
+            }
+            sawHash = true
+        } else if let count = digitCount {
+            guard let digit = Self.digitValue(byte) else {
+                throw USBTMCInstrument.Error.invalidBlock
+            }
+            partialLength = partialLength * 10 + digit
+            digitsRead += 1
+            if digitsRead == count {
+                remaining = partialLength
+            }
+        } else {
+            // "#0" starts an indefinite length block, whose size can't be known in advance
+            guard let count = Self.digitValue(byte), count > 0 else {
+                throw USBTMCInstrument.Error.invalidBlock
+            }
+            digitCount = count
+        }
+    }
+
+    /// The value of an ASCII digit, or `nil` if the byte is not a digit.
+    private static func digitValue(_ byte: UInt8) -> Int? {
+        if byte >= UInt8(ascii: "0") && byte <= UInt8(ascii: "9") {
+            return Int(byte - UInt8(ascii: "0"))
+        }
+        return nil
+    }
+}
+
+extension USBTMCInstrument {
+    /// Read an IEEE 488.2 definite length block, handing the payload to `body` as each chunk arrives.
+    ///
+    /// Waveform queries such as `CURV?` or `:WAV:DATA?` respond with a block of the form `#<n><length><payload>`.
+    /// The header is parsed from the first chunk, then the payload is passed on chunk by chunk without being collected.
+    /// Anything after the payload in the same message, such as a terminator, is discarded.
+    ///
+    /// If the block is invalid or `start` or `body` throws, the rest of the message is still read and discarded before
+    /// the error is thrown, so it is not taken as the response to the next query.
+    /// - Parameters:
+    ///   - chunkSize: The number of bytes to read at a time. Defaults to `attributes.chunkSize`.
+    ///   - start: Called once with the payload length in bytes, before any of the payload is passed to `body`.
+    ///   - body: Called with consecutive pieces of the payload. The bytes are only valid until `body` returns.
+    /// - Throws: ``USBTMCInstrument/Error/invalidBlock`` if the response is not a definite length block, ``USBTMCInstrument/Error/transferIncomplete`` if the message ended before the payload did, a ``USBError`` if a failure occurs during a data transfer, or any error thrown by `start` or `body`
+    public func readBlock(
+        chunkSize: Int? = nil,
+        start: (Int) throws -> Void,
+        body: (UnsafeRawBufferPointer) throws -> Void
+    ) throws {
+        lock.lock()
+        defer { lock.unlock() }
+
+        var reader = DefiniteLengthBlockReader()
+
+        // Bytes left over from an earlier read are the rest of a message, so the block has to end within them
+        if !readAhead.isEmpty {
+            let pending = readAhead.takeAll()
+            try pending.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                try reader.consume(bytes, start: start, body: body)
+            }
+            if !reader.isComplete {
+                throw Error.transferIncomplete
+            }
+            return
+        }
+
+        var failure: Swift.Error?
+        try receiveMessage(
+            headerSuffix: Data([0, 0, 0, 0]),
+            length: nil,
+            chunkSize: chunkSize ?? attributes.chunkSize
+        ) { bytes in
+            if failure == nil && !reader.isComplete {
+                do {
+                    try reader.consume(bytes, start: start, body: body)
+                } catch {
+                    failure = error
+                }
+            }
+        }
+
+        if let failure = failure {
+            throw failure
+        }
+        if !reader.isComplete {
+            throw Error.transferIncomplete
+        }
+    }
+
+    /// Read an IEEE 488.2 definite length block straight into memory owned by the caller.
+    ///
+    /// The payload bytes are copied into `buffer` as they arrive, in the byte order the device sent them.
+    /// `T` must be a trivial type such as `Int16` or `Float`, which can be filled by copying bytes into its memory.
+    /// - Parameters:
+    ///   - buffer: The memory to read the payload into
+    ///   - chunkSize: The number of bytes to read at a time. Defaults to `attributes.chunkSize`.
+    /// - Returns: The number of elements of `buffer` that were filled
+    /// - Throws: ``USBTMCInstrument/Error/bufferTooSmall`` if the payload does not fit in `buffer`, ``USBTMCInstrument/Error/invalidBlock`` if the response is not a block of whole elements, or any error thrown by ``readBlock(chunkSize:start:body:)``
+    public func readBlock<T>(into buffer: UnsafeMutableBufferPointer<T>, chunkSize: Int? = nil) throws -> Int {
+        precondition(_isPOD(T.self), "Blocks can only be read into trivial types")
+        let destination = UnsafeMutableRawBufferPointer(buffer)
+        var written = 0
+
+        try readBlock(chunkSize: chunkSize, start: { length in
+            if length % MemoryLayout<T>.stride != 0 {
+                throw Error.invalidBlock
+            }
+            if length > destination.count {
+                throw Error.bufferTooSmall
+            }
+        }, body: { bytes in
+            UnsafeMutableRawBufferPointer(rebasing: destination[written..<written + bytes.count]).copyMemory(from: bytes)
+            written += bytes.count
+        })
+
+        return written / MemoryLayout<T>.stride
+    }
+
+    /// Read an IEEE 488.2 definite length block as an array of numbers.
+    ///
+    /// The array is allocated once, at its final size, as soon as the header has been read. The values are in the byte
+    /// order the device sent them.
+    /// - Parameters:
+    ///   - type: The type of each element of the block, such as `Int16` or `Float`. It must be a trivial type.
+    ///   - chunkSize: The number of bytes to read at a time. Defaults to `attributes.chunkSize`.
+    /// - Returns: The elements of the block
+    /// - Throws: ``USBTMCInstrument/Error/invalidBlock`` if the response is not a block of whole elements, or any error thrown by ``readBlock(chunkSize:start:body:)``
+    public func readBlock<T: Numeric>(as type: T.Type, chunkSize: Int? = nil) throws -> [T] {
+        precondition(_isPOD(T.self), "Blocks can only be read as trivial types")
+        var values: [T] = []
+        var written = 0
+
+        try readBlock(chunkSize: chunkSize, start: { length in
+            if length % MemoryLayout<T>.stride != 0 {
+                throw Error.invalidBlock
+            }
+            values = [T](repeating: 0, count: length / MemoryLayout<T>.stride)
+        }, body: { bytes in
+            values.withUnsafeMutableBytes { destination in
+                UnsafeMutableRawBufferPointer(rebasing: destination[written..<written + bytes.count]).copyMemory(from: bytes)
+            }
+            written += bytes.count
+        })
+
+        return values
+    }
+
+    /// Read an IEEE 488.2 definite length block as raw bytes.
+    ///
+    /// The returned data is allocated once, at its final size, as soon as the header has been read.
+    /// - Parameter chunkSize: The number of bytes to read at a time. Defaults to `attributes.chunkSize`.
+    /// - Returns: The payload of the block, without the header
+    /// - Throws: Any error thrown by ``readBlock(chunkSize:start:body:)``
+    public func readBlock(chunkSize: Int? = nil) throws -> Data {
+        var data = Data()
+        var written = 0
+
+        try readBlock(chunkSize: chunkSize, start: { length in
+            data = Data(count: length)
+        }, body: { bytes in
+            data.withUnsafeMutableBytes { (destination: UnsafeMutableRawBufferPointer) in
+                UnsafeMutableRawBufferPointer(rebasing: destination[written..<written + bytes.count]).copyMemory(from: bytes)
+            }
+            written += bytes.count
+        })
+
+        return data
+    }
+}
@@ -0,0 +1,164 @@
+//
+//  Discovery.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+import CoreSwiftVISA
+import Usb
+
+/// A USBTMC interface found on a connected device.
+public struct USBTMCResource: Hashable {
+    /// The number identifying the manufacturer of the device.
+    public let vendorID: Int
+    /// The number identifying the kind of device, qualified by the vendor ID.
+    public let productID: Int
+    /// The serial number of the device, or an empty string if the device does not report one or could not be opened.
+    public let serialNumber: String
+    /// The number of the USBTMC interface on the device.
+    public let interfaceNumber: Int
+    /// True if the interface implements the USB488 subclass, which adds IEEE 488.2 features such as service requests.
+    public let isUSB488: Bool
+
+    /// The VISA resource string for the interface, in the form `USB0::<vendor ID>::<product ID>::<serial number>::<interface>::INSTR`.
+    ///
+    /// The IDs are written in decimal, so the string can be passed to ``USBTMCInstrument/init(visaString:)``.
+    public var visaString: String {
+        "USB0::\(vendorID)::\(productID)::\(serialNumber)::\(interfaceNumber)::INSTR"
+    }
+}
+
+extension USBTMCInstrument {
+    /// Find every USBTMC and USB488 interface on the devices connected to the host.
+    ///
+    /// Devices are filtered using the descriptors the operating system has already read, so devices without a USBTMC
+    /// interface are never opened. The remaining devices are opened at the same time to read their serial numbers.
+    /// Unlike creating a ``Context``, a device that can't be opened does not stop the search.
+    /// - Returns: The interfaces found, ordered by vendor ID, product ID, serial number and interface number
+    /// - Throws: A ``USBError`` if libUSB could not be initialized or could not list the devices
+    public static func discoverResources() throws -> [USBTMCResource] {
+        let context = try ContextRef()
+
+        var deviceList: UnsafeMutablePointer<OpaquePointer?>? = nil
+        let size = libusb_get_device_list(context.context, &deviceList)
+        if size < 0 {
+            throw USBError(rawValue: Int32(size)) ?? USBError.other
+        }
+        defer {
+            libusb_free_device_list(deviceList, 1)
+        }
+
+        // Find the USBTMC interfaces using only descriptors, without opening any device
+        var candidates: [(device: OpaquePointer, descriptor: libusb_device_descriptor, interfaces: [(Int, Bool)])] = []
+        for i in 0..<size {
+            guard let device = deviceList?[i] else {
+                continue
+            }
+            var descriptor = libusb_device_descriptor()
+            if libusb_get_device_descriptor(device, &descriptor) < 0 {
+                continue
+            }
+            let interfaces = tmcInterfaces(device: device, descriptor: descriptor)
+            if !interfaces.isEmpty {
+                candidates.append((device, descriptor, interfaces))
+            }
+        }
+
+        // Opening a device and reading a string descriptor both wait on the bus, so read every serial number at once
+        var serialNumbers = [String](repeating: "", count: candidates.count)
+        serialNumbers.withUnsafeMutableBufferPointer { output in
+            DispatchQueue.concurrentPerform(iterations: candidates.count) { index in
+                output[index] = serialNumber(
+                    device: candidates[index].device,
+                    index: candidates[index].descriptor.iSerialNumber)
+            }
+        }
+
+        var resources: [USBTMCResource] = []
+        for (candidate, serialNumber) in zip(candidates, serialNumbers) {
+            for (interfaceNumber, isUSB488) in candidate.interfaces {
+                resources.append(USBTMCResource(
+                    vendorID: Int(candidate.descriptor.idVendor),
+                    productID: Int(candidate.descriptor.idProduct),
+                    serialNumber: serialNumber,
+                    interfaceNumber: interfaceNumber,
+                    isUSB488: isUSB488))
+            }
+        }
+        return resources.sorted {
+            ($0.vendorID, $0.productID, $0.serialNumber, $0.interfaceNumber) <
+                ($1.vendorID, $1.productID, $1.serialNumber, $1.interfaceNumber)
+        }
+    }
+
+    /// The USBTMC interfaces of a device, read from its cached configuration descriptors.
+    /// - Returns: The number of each USBTMC interface and whether it implements USB488
+    private static func tmcInterfaces(device: OpaquePointer, descriptor: libusb_device_descriptor) -> [(Int, Bool)] {
+        // Only devices that describe their class per interface can have a USBTMC interface
+        let deviceClass = ClassCode(rawValue: descriptor.bDeviceClass) ?? ClassCode.other
+        if deviceClass != .perInterface && deviceClass != .miscellaneous && deviceClass != .application {
+            return []
+        }
+
+        var found: [(Int, Bool)] = []
+        for configIndex in 0..<descriptor.bNumConfigurations {
+            var config: UnsafeMutablePointer<libusb_config_descriptor>? = nil
+            if libusb_get_config_descriptor(device, configIndex, &config) < 0 {
+                continue
+            }
+            guard let configDescriptor = config?.pointee else {
+                continue
+            }
+            for interfaceIndex in 0..<Int(configDescriptor.bNumInterfaces) {
+                let interface = configDescriptor.interface[interfaceIndex]
+                for altIndex in 0..<Int(interface.num_altsetting) {
+                    let alt = interface.altsetting[altIndex]
+                    if alt.bInterfaceClass == ClassCode.application.rawValue &&
+                        alt.bInterfaceSubClass == 0x03 &&
+                        (alt.bInterfaceProtocol == 0 || alt.bInterfaceProtocol == 1) {
+                        found.append((Int(alt.bInterfaceNumber), alt.bInterfaceProtocol == 1))
+                        break
+                    }
+                }
+            }
+            libusb_free_config_descriptor(config)
+        }
+        return found
+    }
+
+    /// Open a device just long enough to read its serial number.
+    /// - Returns: The serial number, or an empty string if there is none or the device could not be opened
+    private static func serialNumber(device: OpaquePointer, index: UInt8) -> String {
+        if index == 0 {
+            return ""
+        }
+        var handle: OpaquePointer? = nil
+        if libusb_open(device, &handle) < 0 {
+            return ""
+        }
+        defer {
+            libusb_close(handle)
+        }
+
+        var buffer = [UInt8](repeating: 0, count: 256)
+        let length = libusb_get_string_descriptor_ascii(handle, index, &buffer, Int32(buffer.count))
+        if length <= 0 {
+            return ""
+        }
+        return String(bytes: buffer[..<Int(length)], encoding: .ascii) ?? ""
+    }
+}
+
+extension InstrumentManager {
+    /// The VISA resource strings of every USBTMC instrument connected to the host.
+    ///
+    /// Each string can be passed to ``instrumentAt(visaString:)``. See ``USBTMCInstrument/discoverResources()`` for
+    /// details of the search.
+    /// - Returns: One VISA string for each USBTMC interface found
+    /// - Throws: A ``USBError`` if libUSB could not list the devices
+    public func usbtmcResourceStrings() throws -> [String] {
+        try USBTMCInstrument.discoverResources().map { $0.visaString }
+    }
+}
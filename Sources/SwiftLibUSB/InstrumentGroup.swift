@@ -0,0 +1,95 @@
+//
+//  InstrumentGroup.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// Several instruments that are commanded together.
+///
+/// Operations on a group run on every instrument at the same time, each on its own thread, so the whole operation
+/// takes about as long as the slowest instrument rather than the sum of all of them. A failure on one instrument does
+/// not stop the others; each instrument's outcome is returned in the order of ``instruments``.
+public final class InstrumentGroup {
+    /// The instruments in the group.
+    public let instruments: [USBTMCInstrument]
+
+    /// The queue the operation on each instrument runs on.
+    private let queue = DispatchQueue(label: "SwiftLibUSB.InstrumentGroup", qos: .userInitiated, attributes: .concurrent)
+
+    /// Create a group of instruments.
+    /// - Parameter instruments: The instruments to command together. Each instrument should appear only once.
+    public init(_ instruments: [USBTMCInstrument]) {
+        self.instruments = instruments
+    }
+
+    /// Run an operation on every instrument at the same time.
+    /// - Parameter body: The operation to run. It is called once for each instrument, from several threads at once.
+    /// - Returns: The value returned by, or the error thrown by, `body` for each instrument, in order
+    public func perform<T>(_ body: (USBTMCInstrument) throws -> T) -> [Result<T, Swift.Error>] {
+        perform(count: instruments.count) { index in
+            try body(instruments[index])
+        }
+    }
+
+    /// Write the same command to every instrument.
+    /// - Parameter command: The command, sent with each instrument's write terminator and encoding
+    /// - Returns: The number of bytes written to, or the error from, each instrument
+    public func write(_ command: String) -> [Result<Int, Swift.Error>] {
+        perform { instrument in
+            try instrument.write(command)
+        }
+    }
+
+    /// Write a different command to each instrument.
+    /// - Parameter commands: One command for each instrument, in the order of ``instruments``
+    /// - Returns: The number of bytes written to, or the error from, each instrument
+    public func write(_ commands: [String]) -> [Result<Int, Swift.Error>] {
+        precondition(commands.count == instruments.count, "One command is needed for each instrument")
+        return perform(count: instruments.count) { index in
+            try instruments[index].write(commands[index])
+        }
+    }
+
+    /// Send the same query to every instrument.
+    /// - Parameter command: The query to send
+    /// - Returns: The response from, or the error from, each instrument
+    public func query(_ command: String) -> [Result<String, Swift.Error>] {
+        perform { instrument in
+            try instrument.query(command)
+        }
+    }
+
+    /// Send the same batch of commands to every instrument, as with ``USBTMCInstrument/batch(_:maxMessageLength:)``.
+    /// - Parameter commands: The commands and queries to send
+    /// - Returns: The responses to the queries from, or the error from, each instrument
+    public func batch(_ commands: [String]) -> [Result<[String], Swift.Error>] {
+        perform { instrument in
+            try instrument.batch(commands)
+        }
+    }
+
+    /// Call `body` with every index below `count` at the same time and collect the results.
+    ///
+    /// The calls spend most of their time waiting on devices, so each gets its own thread rather than sharing a
+    /// thread per processor core.
+    private func perform<T>(count: Int, _ body: (Int) throws -> T) -> [Result<T, Swift.Error>] {
+        var results = [Result<T, Swift.Error>?](repeating: nil, count: count)
+        withoutActuallyEscaping(body) { body in
+            results.withUnsafeMutableBufferPointer { buffer in
+                let output = buffer
+                let group = DispatchGroup()
+                for index in 0..<count {
+                    queue.async(group: group) {
+                        // Each call writes only its own element, so no lock is needed
+                        output[index] = Result { try body(index) }
+                    }
+                }
+                group.wait()
+            }
+        }
+        return results.map { $0! }
+    }
+}
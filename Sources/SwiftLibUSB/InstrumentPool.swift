@@ -0,0 +1,155 @@
+//
+//  InstrumentPool.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// Keeps connected instruments alive between uses, keyed by VISA resource string.
+///
+/// Connecting to an instrument lists every device on the bus, opens the device, claims its interface and asks for its
+/// capabilities. A pool does this once per instrument: an instrument checked back in stays claimed and ready, and the
+/// next checkout for the same resource string is handed it after a health check that doesn't talk to the device.
+///
+/// A device can only be claimed by one instrument at a time, so each resource should be checked out by one caller at
+/// a time.
+public final class InstrumentPool {
+    /// A pool shared by the whole process.
+    public static let shared = InstrumentPool()
+
+    /// Connected instruments that are not checked out, by resource string.
+    private var idle: [String: [USBTMCInstrument]] = [:]
+
+    /// The resource string each checked out instrument was created for.
+    private var checkedOut: [ObjectIdentifier: String] = [:]
+
+    private let lock = NSLock()
+
+    /// Connects a new instrument for a resource string.
+    private let makeInstrument: (String) throws -> USBTMCInstrument
+
+    /// Create an empty pool.
+    public convenience init() {
+        self.init { visaString in
+            try USBTMCInstrument(visaString: visaString)
+        }
+    }
+
+    /// Create an empty pool that connects new instruments with `makeInstrument`, such as one that connects to a
+    /// ``USBTMCEmulator``.
+    /// - Parameter makeInstrument: Connects an instrument for a VISA resource string
+    init(makeInstrument: @escaping (String) throws -> USBTMCInstrument) {
+        self.makeInstrument = makeInstrument
+    }
+
+    /// Get a connected instrument, reusing one from the pool if it is still healthy.
+    /// - Parameter visaString: The VISA resource string of the instrument
+    /// - Returns: A connected instrument, which should be returned with ``checkin(_:)`` when it is no longer needed
+    /// - Throws: Any error thrown by ``USBTMCInstrument/init(visaString:)`` if a new connection has to be made
+    public func checkout(visaString: String) throws -> USBTMCInstrument {
+        let key = Self.key(for: visaString)
+        while let instrument = takeIdle(key: key) {
+            if Self.isHealthy(instrument) {
+                markCheckedOut(instrument, key: key)
+                return instrument
+            }
+            // Dropping an unhealthy instrument releases its interface and closes the device
+        }
+
+        let instrument = try makeInstrument(visaString)
+        markCheckedOut(instrument, key: key)
+        return instrument
+    }
+
+    /// Return an instrument to the pool so later checkouts can reuse it.
+    ///
+    /// The device is cleared, discarding any command in progress and any response not yet read, and the instrument
+    /// starts a new conversation with it, forgetting the settings remembered by its state cache. An instrument whose
+    /// device refuses the clear is released instead of being kept. Instruments that did not come from this pool are
+    /// ignored.
+    /// - Parameter instrument: An instrument from ``checkout(visaString:)``
+    public func checkin(_ instrument: USBTMCInstrument) {
+        lock.lock()
+        let checkedOutKey = checkedOut.removeValue(forKey: ObjectIdentifier(instrument))
+        lock.unlock()
+        guard let key = checkedOutKey, (try? instrument.prepareForReuse()) != nil else {
+            return
+        }
+
+        lock.lock()
+        defer { lock.unlock() }
+        idle[key, default: []].append(instrument)
+    }
+
+    /// Stop tracking an instrument that should not be reused, such as one that has stopped responding.
+    ///
+    /// The device is released once the caller's last reference to the instrument is gone.
+    /// - Parameter instrument: An instrument from ``checkout(visaString:)``
+    public func discard(_ instrument: USBTMCInstrument) {
+        lock.lock()
+        defer { lock.unlock() }
+        checkedOut[ObjectIdentifier(instrument)] = nil
+    }
+
+    /// Check out an instrument for the duration of `body`.
+    ///
+    /// The instrument is returned to the pool afterwards, unless `body` throws a ``USBError``, which suggests the
+    /// connection is no longer usable.
+    /// - Parameters:
+    ///   - visaString: The VISA resource string of the instrument
+    ///   - body: The work to do with the instrument
+    /// - Returns: The value returned by `body`
+    /// - Throws: Any error thrown while connecting or by `body`
+    public func withInstrument<T>(visaString: String, _ body: (USBTMCInstrument) throws -> T) throws -> T {
+        let instrument = try checkout(visaString: visaString)
+        do {
+            let result = try body(instrument)
+            checkin(instrument)
+            return result
+        } catch let error as USBError {
+            discard(instrument)
+            throw error
+        } catch {
+            checkin(instrument)
+            throw error
+        }
+    }
+
+    /// Release every idle instrument in the pool. Checked out instruments are not affected.
+    public func removeAll() {
+        lock.lock()
+        defer { lock.unlock() }
+        idle.removeAll()
+    }
+
+    private func takeIdle(key: String) -> USBTMCInstrument? {
+        lock.lock()
+        defer { lock.unlock() }
+        return idle[key]?.popLast()
+    }
+
+    private func markCheckedOut(_ instrument: USBTMCInstrument, key: String) {
+        lock.lock()
+        defer { lock.unlock() }
+        checkedOut[ObjectIdentifier(instrument)] = key
+    }
+
+    /// Check that an idle instrument can still be used, without a transfer to the device.
+    private static func isHealthy(_ instrument: USBTMCInstrument) -> Bool {
+        instrument.withExclusiveAccess { instrument in
+            let device = instrument._session.device
+            return device.isOpen && (try? device.activeConfigurationValue()).map { $0 != 0 } ?? false
+        }
+    }
+
+    /// The form of a resource string used to look it up. Only the vendor ID, product ID, serial number and interface
+    /// number matter.
+    private static func key(for visaString: String) -> String {
+        let sections = visaString.trimmingCharacters(in: .whitespaces).components(separatedBy: "::")
+        // As in ``USBTMCInstrument/init(visaString:)``, the interface number is only present before the resource class
+        let count = sections.count > 5 ? 5 : 4
+        return sections.prefix(count).dropFirst().joined(separator: "::")
+    }
+}
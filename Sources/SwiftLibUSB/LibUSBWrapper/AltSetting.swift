@@ -6,7 +6,6 @@
 //
 
 import Foundation
-import Usb
 
 /// A setting that controls how the endpoints in an ``Interface`` behave.
 ///
@@ -34,7 +33,7 @@ public class AltSetting: Hashable {
     }
     
     public static func == (lhs: AltSetting, rhs: AltSetting) -> Bool {
-        lhs.setting.rawDevice == rhs.setting.rawDevice &&
+        lhs.setting.transport === rhs.setting.transport &&
           lhs.index == rhs.index &&
           lhs.interfaceIndex == rhs.interfaceIndex
     }
@@ -91,21 +90,38 @@ public class AltSetting: Hashable {
     /// * `.noDevice` if the device was disconnected
     /// * `.connectionClosed` if the connection was closed using ``Device/close()``.
     public func setActive() throws {
-        guard let handle = setting.rawHandle else {
-            throw USBError.connectionClosed
+        try setting.transport.setAltSetting(interface: Int(setting.interfaceNumber), altSetting: Int(setting.index))
+    }
+    
+    /// Check whether this is the active setting of its interface.
+    ///
+    /// An interface with only one alternate setting is always in that setting, so no request is made. Otherwise the
+    /// device is asked with a GET_INTERFACE request, which is much cheaper than selecting the setting again.
+    ///
+    /// - returns: True if the interface is using this setting
+    /// - throws: A ``USBError`` if the request fails
+    /// * `.noDevice` if the device was disconnected
+    /// * `.connectionClosed` if the connection was closed using ``Device/close()``.
+    public func isActive() throws -> Bool {
+        if setting.interface.numAltsetting == 1 {
+            return true
         }
-        let error = libusb_set_interface_alt_setting(
-            handle,
-            Int32(setting.interfaceNumber),
-            Int32(setting.index))
-        if error < 0 {
-            throw USBError(rawValue: error) ?? USBError.other
+        var current: UInt8 = 0
+        let setup = USBControlSetup(
+            requestType: 0x81, // Device to host, standard request, recipient interface
+            request: 0x0A, // GET_INTERFACE
+            value: 0,
+            index: UInt16(setting.interfaceNumber),
+            length: 1)
+        let result = try withUnsafeMutableBytes(of: &current) { buffer in
+            try setting.transport.controlTransfer(setup, data: buffer, timeout: 1000)
         }
+        return result == 1 && current == setting.index
     }
     
     /// A hash representation of the altSetting
     public func hash(into hasher: inout Hasher) {
-        setting.rawDevice.hash(into: &hasher)
+        ObjectIdentifier(setting.transport).hash(into: &hasher)
         interfaceIndex.hash(into: &hasher)
         index.hash(into: &hasher)
     }
@@ -116,82 +132,72 @@ public class AltSetting: Hashable {
 /// This exists to make sure the device and context live longer than any Endpoints that are in use.
 internal class AltSettingRef {
     let interface: InterfaceRef
-    let altSetting: UnsafePointer<libusb_interface_descriptor>
+    let altSetting: USBInterfaceDescriptor
     
     init(interface: InterfaceRef, index: Int) {
         self.interface = interface
-        altSetting = interface.altsetting + index
+        altSetting = interface.altSettings[index]
     }
     
     func getStringDescriptor(index: UInt8) -> String? {
         interface.getStringDescriptor(index: index)
     }
     
-    var rawDevice: OpaquePointer {
+    var transport: USBTransport {
         get {
-            interface.rawDevice
-        }
-    }
-    
-    var rawHandle: OpaquePointer? {
-        get {
-            interface.rawHandle
+            interface.transport
         }
     }
     
     var index: UInt8 {
         get {
-            altSetting.pointee.bAlternateSetting
+            altSetting.alternateSetting
         }
     }
     
     var interfaceNumber: UInt8 {
         get {
-            altSetting.pointee.bInterfaceNumber
+            altSetting.interfaceNumber
         }
     }
     
     var interfaceProtocol: UInt8 {
         get {
-            altSetting.pointee.bInterfaceProtocol
+            altSetting.interfaceProtocol
         }
     }
     
     var interfaceSubClass: Int {
         get {
-            Int(altSetting.pointee.bInterfaceSubClass)
+            Int(altSetting.interfaceSubClass)
         }
     }
     
     var interfaceClass: ClassCode {
         get {
-            ClassCode(rawValue: altSetting.pointee.bInterfaceClass) ?? ClassCode.other
+            ClassCode(rawValue: altSetting.interfaceClass) ?? ClassCode.other
         }
     }
     
     var interfaceName: UInt8 {
         get {
-            altSetting.pointee.iInterface
+            altSetting.nameIndex
         }
     }
     
     var bInterfaceProtocol: UInt8 {
         get {
-            altSetting.pointee.bInterfaceProtocol
+            altSetting.interfaceProtocol
         }
     }
     
     var numEndpoints: UInt8 {
         get {
-            altSetting.pointee.bNumEndpoints
+            UInt8(altSetting.endpoints.count)
         }
     }
     
-    func endpoint(index: Int) -> UnsafePointer<libusb_endpoint_descriptor> {
-        altSetting.pointee.endpoint + index
-    }
-    
-    deinit {
-        // AltSettings don't have any data to be released
+    func endpoint(index: Int) -> USBEndpointDescriptor {
+        altSetting.endpoints[index]
     }
 }
@@ -0,0 +1,227 @@
+//
+//  AsyncTransfer.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+import Usb
+
+/// A libUSB transfer that is submitted without waiting for it to finish.
+///
+/// Several transfers can be submitted back to back and then waited on together using ``AsyncTransfer/run(_:)``, so
+/// the device is given all of them without a round trip through the calling thread in between. A transfer can be reused
+/// once it has finished.
+internal class AsyncTransfer {
+    /// The transfer as libUSB understands it
+    private let transfer: UnsafeMutablePointer<libusb_transfer>
+
+    /// The libUSB context whose events complete this transfer
+    private let context: OpaquePointer
+
+    /// Set to a nonzero value when the transfer is not in flight. libUSB's event handling watches this flag.
+    private let completed: UnsafeMutablePointer<Int32>
+
+    /// Called on the event handling thread when the transfer finishes. Returning true means the transfer was submitted
+    /// again, so it is not marked as finished.
+    var onFinished: ((AsyncTransfer) -> Bool)?
+
+    /// Allocate a transfer.
+    /// - Parameters:
+    ///   - context: The libUSB context of the device the transfer will be submitted to
+    ///   - isoPackets: The most packets the transfer will be split into, if it is isochronous
+    /// - Throws: ``USBError/noMemory`` if libUSB could not allocate the transfer
+    init(context: OpaquePointer, isoPackets: Int = 0) throws {
+        guard let transfer = libusb_alloc_transfer(Int32(isoPackets)) else {
+            throw USBError.noMemory
+        }
+        self.transfer = transfer
+        self.context = context
+        completed = UnsafeMutablePointer<Int32>.allocate(capacity: 1)
+        completed.pointee = 1
+    }
+
+    /// Set up the transfer to move the bytes of `buffer` when it is submitted.
+    /// - Parameters:
+    ///   - handle: The open device handle
+    ///   - endpoint: The address of the endpoint
+    ///   - type: The transfer type of the endpoint
+    ///   - buffer: The bytes to send or the memory to receive into. It must stay valid until the transfer finishes.
+    ///   - timeout: The time, in milliseconds, before the transfer times out. 0 waits forever.
+    ///   - isoPackets: For isochronous transfers, the number of equal packets `buffer` is split into. It must not be
+    ///     more than the transfer was allocated with.
+    func prepare(
+        handle: OpaquePointer,
+        endpoint: UInt8,
+        type: TransferType,
+        buffer: UnsafeMutableRawBufferPointer,
+        timeout: Int,
+        isoPackets: Int = 0
+    ) {
+        transfer.pointee.dev_handle = handle
+        transfer.pointee.flags = 0
+        transfer.pointee.endpoint = endpoint
+        transfer.pointee.type = type.rawValue
+        transfer.pointee.timeout = UInt32(timeout)
+        transfer.pointee.buffer = buffer.baseAddress?.assumingMemoryBound(to: UInt8.self)
+        transfer.pointee.length = Int32(buffer.count)
+        transfer.pointee.num_iso_packets = Int32(isoPackets)
+        for index in 0..<isoPackets {
+            swiftlibusb_iso_packet(transfer, Int32(index)).pointee.length = UInt32(buffer.count / isoPackets)
+        }
+        transfer.pointee.callback = asyncTransferFinished
+        transfer.pointee.user_data = Unmanaged.passUnretained(self).toOpaque()
+    }
+
+    /// Hand the transfer to libUSB. It runs in the background until it finishes or is cancelled.
+    /// - Throws: a ``USBError`` if libUSB refuses the transfer
+    func submit() throws {
+        completed.pointee = 0
+        let error = libusb_submit_transfer(transfer)
+        if error < 0 {
+            completed.pointee = 1
+            throw USBError(rawValue: error) ?? USBError.other
+        }
+    }
+
+    /// Ask libUSB to stop the transfer. It still has to be waited on before it can be reused.
+    func cancel() {
+        if !isFinished {
+            _ = libusb_cancel_transfer(transfer)
+        }
+    }
+
+    /// True if the transfer is not in flight.
+    var isFinished: Bool {
+        completed.pointee != 0
+    }
+
+    /// The number of bytes actually sent or received.
+    var actualLength: Int {
+        Int(transfer.pointee.actual_length)
+    }
+
+    /// The bytes received by a finished in transfer.
+    var receivedData: Data {
+        guard let buffer = transfer.pointee.buffer else {
+            return Data()
+        }
+        return Data(bytes: buffer, count: actualLength)
+    }
+
+    /// The error the transfer finished with, or `nil` if it completed successfully.
+    ///
+    /// Isochronous transfers complete even if some of their packets failed. Each packet's own status is given by
+    /// ``isoPacket(_:)``.
+    var error: USBError? {
+        Self.error(for: transfer.pointee.status)
+    }
+
+    /// The number of packets an isochronous transfer was split into.
+    var isoPacketCount: Int {
+        Int(transfer.pointee.num_iso_packets)
+    }
+
+    /// The result of one packet of a finished isochronous transfer.
+    /// - Returns: The error the packet failed with, or `nil`, and the bytes it moved. Packets start at `index` times the
+    ///   packet length into the buffer, however many bytes the packets before them moved.
+    func isoPacket(_ index: Int) -> (error: USBError?, data: UnsafeRawBufferPointer) {
+        let packet = swiftlibusb_iso_packet(transfer, Int32(index)).pointee
+        let start = transfer.pointee.buffer.map { UnsafeRawPointer($0) + index * Int(packet.length) }
+        let count = start == nil ? 0 : Int(packet.actual_length)
+        return (Self.error(for: packet.status), UnsafeRawBufferPointer(start: start, count: count))
+    }
+
+    /// The error a transfer or packet status stands for, or `nil` if it completed.
+    private static func error(for status: libusb_transfer_status) -> USBError? {
+        if status == LIBUSB_TRANSFER_COMPLETED {
+            return nil
+        } else if status == LIBUSB_TRANSFER_TIMED_OUT {
+            return USBError.timeout
+        } else if status == LIBUSB_TRANSFER_STALL {
+            return USBError.pipe
+        } else if status == LIBUSB_TRANSFER_NO_DEVICE {
+            return USBError.noDevice
+        } else if status == LIBUSB_TRANSFER_OVERFLOW {
+            return USBError.overflow
+        } else if status == LIBUSB_TRANSFER_CANCELLED {
+            return USBError.interrupted
+        }
+        return USBError.io
+    }
+
+    /// Handle libUSB events until the transfer finishes.
+    ///
+    /// Other transfers on the same context can finish while waiting, including ones waited on by other threads.
+    func waitUntilFinished() {
+        while !isFinished {
+            var timeout = timeval(tv_sec: 1, tv_usec: 0)
+            let error = libusb_handle_events_timeout_completed(context, &timeout, completed)
+            if error < 0 && error != USBError.interrupted.rawValue {
+                // Event handling itself failed, so stop waiting on the device and only wait for the cancellation
+                cancel()
+            }
+        }
+    }
+
+    /// Submit transfers in order, then wait for all of them to finish.
+    ///
+    /// If any transfer fails, the ones after it are cancelled.
+    /// - Parameter transfers: Prepared transfers. The order of transfers to the same endpoint is kept.
+    /// - Throws: The ``USBError`` of the first transfer that failed
+    static func run(_ transfers: [AsyncTransfer]) throws {
+        var submitted = 0
+        var failure: USBError? = nil
+        for transfer in transfers {
+            do {
+                try transfer.submit()
+                submitted += 1
+            } catch {
+                failure = error as? USBError ?? USBError.other
+                break
+            }
+        }
+
+        for (index, transfer) in transfers[..<submitted].enumerated() {
+            transfer.waitUntilFinished()
+            if failure == nil, let error = transfer.error {
+                failure = error
+                for later in transfers[(index + 1)..<submitted] {
+                    later.cancel()
+                }
+            }
+        }
+
+        if let failure = failure {
+            throw failure
+        }
+    }
+
+    deinit {
+        // libUSB must not finish a transfer after it has been freed
+        cancel()
+        waitUntilFinished()
+        libusb_free_transfer(transfer)
+        completed.deallocate()
+    }
+}
+
+/// Called by libUSB, on whichever thread is handling events, when an ``AsyncTransfer`` finishes.
+private func asyncTransferFinished(_ transfer: UnsafeMutablePointer<libusb_transfer>?) {
+    guard let userData = transfer?.pointee.user_data else {
+        return
+    }
+    let owner = Unmanaged<AsyncTransfer>.fromOpaque(userData).takeUnretainedValue()
+    owner.markFinished()
+}
+
+extension AsyncTransfer {
+    /// Record that libUSB is done with the transfer.
+    fileprivate func markFinished() {
+        if let onFinished = onFinished, onFinished(self) {
+            return
+        }
+        completed.pointee = 1
+    }
+}
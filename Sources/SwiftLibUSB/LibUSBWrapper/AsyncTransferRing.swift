@@ -0,0 +1,189 @@
+//
+//  AsyncTransferRing.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+import Usb
+
+/// Asynchronous transfers to one endpoint that are each submitted again as soon as they finish, so the host controller
+/// always has transfers queued for the device.
+///
+/// A thread handles libUSB events until the ring is stopped or a transfer fails. The ring is kept alive by that thread, so
+/// it runs until then even if nothing else keeps a reference to it.
+internal final class AsyncTransferRing {
+    /// The transport is kept so that the device and context outlive the transfers
+    private let transport: LibUSBTransport
+    private let transfers: [AsyncTransfer]
+    /// The memory each transfer moves data through
+    private let buffers: [UnsafeMutableRawBufferPointer]
+    private let deliver: (AsyncTransfer) -> Void
+    private let fail: (Swift.Error) -> Void
+
+    private let condition = NSCondition()
+    private var isStopping = false
+    private var isRunning = true
+    private var thread: Thread?
+
+    /// Submit the transfers and start handling their events.
+    /// - Parameters:
+    ///   - transport: The transport of the device
+    ///   - handle: The open device handle
+    ///   - endpoint: The address of the endpoint
+    ///   - type: The transfer type of the endpoint
+    ///   - count: The number of transfers kept submitted
+    ///   - length: The size of each transfer's buffer
+    ///   - isoPackets: For isochronous endpoints, the number of packets each transfer is split into
+    ///   - deliver: Called with each transfer that finished successfully, before it is submitted again
+    ///   - fail: Called once with the error that stopped the ring, unless it was stopped with ``stop()``
+    /// - Throws: A ``USBError`` if the transfers can't be allocated or submitted
+    init(
+        transport: LibUSBTransport,
+        handle: OpaquePointer,
+        endpoint: UInt8,
+        type: TransferType,
+        count: Int,
+        length: Int,
+        isoPackets: Int = 0,
+        deliver: @escaping (AsyncTransfer) -> Void,
+        fail: @escaping (Swift.Error) -> Void
+    ) throws {
+        self.transport = transport
+        self.deliver = deliver
+        self.fail = fail
+        transfers = try (0..<count).map { _ in
+            try AsyncTransfer(context: transport.context.context, isoPackets: isoPackets)
+        }
+        buffers = (0..<count).map { _ in
+            UnsafeMutableRawBufferPointer.allocate(byteCount: length, alignment: MemoryLayout<UInt8>.alignment)
+        }
+
+        for (transfer, buffer) in zip(transfers, buffers) {
+            transfer.prepare(
+                handle: handle,
+                endpoint: endpoint,
+                type: type,
+                buffer: buffer,
+                timeout: 0,
+                isoPackets: isoPackets)
+            transfer.onFinished = { [weak self] transfer in
+                self?.finished(transfer) ?? false
+            }
+        }
+        do {
+            for transfer in transfers {
+                try transfer.submit()
+            }
+        } catch {
+            isStopping = true
+            cancelAll()
+            transfers.forEach { $0.waitUntilFinished() }
+            throw error
+        }
+
+        let thread = Thread {
+            self.handleEvents()
+        }
+        thread.name = "SwiftLibUSB.AsyncTransferRing"
+        self.thread = thread
+        thread.start()
+    }
+
+    /// Cancel the transfers and wait until they have finished, unless called from a callback of the ring.
+    ///
+    /// Once this returns, `deliver` and `fail` are not called again.
+    func stop() {
+        condition.lock()
+        isStopping = true
+        condition.unlock()
+        cancelAll()
+
+        condition.lock()
+        defer { condition.unlock() }
+        if Thread.current == thread {
+            return
+        }
+        while isRunning {
+            condition.wait()
+        }
+    }
+
+    /// Handle libUSB events until every transfer has finished.
+    private func handleEvents() {
+        while transfers.contains(where: { !$0.isFinished }) {
+            var timeout = timeval(tv_sec: 0, tv_usec: 100_000)
+            let error = libusb_handle_events_timeout_completed(transport.context.context, &timeout, nil)
+            if error < 0 && error != USBError.interrupted.rawValue {
+                stopAfterFailure(USBError(rawValue: error) ?? USBError.other)
+            }
+        }
+
+        condition.lock()
+        isRunning = false
+        thread = nil
+        condition.broadcast()
+        condition.unlock()
+    }
+
+    /// Deliver a finished transfer and submit it again.
+    /// - Returns: True if the transfer was submitted again
+    private func finished(_ transfer: AsyncTransfer) -> Bool {
+        if let error = transfer.error {
+            stopAfterFailure(error)
+            return false
+        }
+        if shouldContinue {
+            deliver(transfer)
+        }
+
+        // Checking and resubmitting under the lock means stop() either sees the transfer in flight or stops it here
+        condition.lock()
+        var resubmitted = false
+        var failure: Swift.Error? = nil
+        if !isStopping {
+            do {
+                try transfer.submit()
+                resubmitted = true
+            } catch {
+                failure = error
+            }
+        }
+        condition.unlock()
+
+        if let failure = failure {
+            stopAfterFailure(failure)
+        }
+        return resubmitted
+    }
+
+    private var shouldContinue: Bool {
+        condition.lock()
+        defer { condition.unlock() }
+        return !isStopping
+    }
+
+    /// Report the error that stopped the ring, unless it was already stopping, and cancel the other transfers.
+    private func stopAfterFailure(_ error: Swift.Error) {
+        condition.lock()
+        let wasStopping = isStopping
+        isStopping = true
+        condition.unlock()
+        if !wasStopping {
+            cancelAll()
+            fail(error)
+        }
+    }
+
+    private func cancelAll() {
+        transfers.forEach { $0.cancel() }
+    }
+
+    deinit {
+        // The transfers have all finished, as the event thread keeps this alive until they do
+        buffers.forEach { $0.deallocate() }
+    }
+}
+
+extension AsyncTransferRing: USBInterruptPolling {}
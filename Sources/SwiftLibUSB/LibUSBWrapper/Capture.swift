@@ -0,0 +1,412 @@
+//
+//  Capture.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// Opt-in capture of every transfer the library makes to a pcap file that Wireshark opens as Linux usbmon traffic.
+///
+/// This gives the same view as capturing with usbmon, without needing root or a Linux host, and only of the devices
+/// this process talks to:
+///
+/// ```swift
+/// try USBCapture.start(writingTo: URL(fileURLWithPath: "instrument.pcap"))
+/// let response = try instrument.query("*IDN?")
+/// USBCapture.stop()
+/// ```
+///
+/// Each transfer is written as a submission and a completion, as usbmon records them, so Wireshark's USB and USBTMC
+/// dissectors decode the packets and match responses to requests. While capture is off, each transfer costs one check
+/// of a flag. While it is on, packets are copied into a memory buffer that a background queue writes to the file, so
+/// transfers never wait on the disk.
+public enum USBCapture {
+    /// True while transfers are being captured.
+    public private(set) static var isEnabled = false
+
+    /// The time between a packet being captured and the buffer holding it being written to the file, in seconds.
+    public static var flushInterval: TimeInterval = 0.1
+
+    /// The most bytes kept in memory waiting to be written. Packets that don't fit are dropped and counted in
+    /// ``droppedPacketCount``.
+    public static var maxBufferedBytes = 64 << 20
+
+    /// Start capturing to a new file, replacing any file at `url` and ending any capture in progress.
+    /// - Parameters:
+    ///   - url: Where to write the capture
+    ///   - snapshotLength: The most bytes of each transfer's data to keep. Longer transfers are cut short, but their
+    ///     full length is still recorded.
+    /// - Throws: An error if the file can't be created
+    public static func start(writingTo url: URL, snapshotLength: Int = 65_535) throws {
+        stop()
+        let writer = try CaptureWriter(url: url, snapshotLength: snapshotLength)
+        writerLock.lock()
+        currentWriter = writer
+        writerLock.unlock()
+        isEnabled = true
+    }
+
+    /// Stop capturing, writing everything captured so far and closing the file.
+    public static func stop() {
+        isEnabled = false
+        writerLock.lock()
+        let writer = currentWriter
+        currentWriter = nil
+        writerLock.unlock()
+        writer?.close()
+    }
+
+    /// Write everything captured so far to the file without waiting for the next flush.
+    public static func flush() {
+        writerLock.lock()
+        let writer = currentWriter
+        writerLock.unlock()
+        writer?.flushNow()
+    }
+
+    /// The number of packets dropped from the current capture because the file could not be written fast enough.
+    public static var droppedPacketCount: Int {
+        writerLock.lock()
+        defer { writerLock.unlock() }
+        return currentWriter?.droppedPacketCount ?? 0
+    }
+
+    /// The USB transfer types, numbered as usbmon numbers them.
+    enum TransferType: UInt8 {
+        case isochronous = 0
+        case interrupt = 1
+        case control = 2
+        case bulk = 3
+    }
+
+    /// Capture the transfer made by `body` if capture is enabled.
+    /// - Parameters:
+    ///   - type: The type of the transfer
+    ///   - transport: The transport of the device the transfer is made to
+    ///   - endpoint: The endpoint address, including the direction bit
+    ///   - setup: The setup packet, for control transfers
+    ///   - data: The data sent, or the memory received into
+    ///   - body: Makes the transfer and returns the number of bytes moved
+    /// - Returns: The value returned by `body`
+    @inline(__always)
+    static func capture(
+        _ type: TransferType,
+        transport: USBTransport,
+        endpoint: UInt8,
+        setup: USBControlSetup? = nil,
+        data: UnsafeMutableRawBufferPointer,
+        _ body: () throws -> Int
+    ) rethrows -> Int {
+        guard isEnabled, let writer = writer() else {
+            return try body()
+        }
+        let packet = Packet(type: type, transport: transport, endpoint: endpoint, setup: setup, data: data, id: writer.nextID())
+        writer.submit(packet)
+        do {
+            let count = try body()
+            writer.complete(packet, count: count, error: nil)
+            return count
+        } catch {
+            writer.complete(packet, count: 0, error: error)
+            throw error
+        }
+    }
+
+    /// Capture a sequence of bulk transfers made by `body` if capture is enabled.
+    ///
+    /// Every transfer is captured as submitted before any completes. If `body` throws, every transfer is captured as
+    /// having failed with its error.
+    @inline(__always)
+    static func capture(
+        _ transfers: [USBBulkTransferRequest],
+        transport: USBTransport,
+        _ body: () throws -> [Int]
+    ) rethrows -> [Int] {
+        guard isEnabled, let writer = writer() else {
+            return try body()
+        }
+        let packets = transfers.map {
+            Packet(type: .bulk, transport: transport, endpoint: $0.endpoint, setup: nil, data: $0.data, id: writer.nextID())
+        }
+        packets.forEach(writer.submit)
+        do {
+            let counts = try body()
+            for (packet, count) in zip(packets, counts) {
+                writer.complete(packet, count: count, error: nil)
+            }
+            return counts
+        } catch {
+            for packet in packets {
+                writer.complete(packet, count: 0, error: error)
+            }
+            throw error
+        }
+    }
+
+    /// One transfer as usbmon describes it.
+    struct Packet {
+        var type: TransferType
+        var busNumber: UInt16
+        var deviceAddress: UInt8
+        var endpoint: UInt8
+        var setup: USBControlSetup?
+        var data: UnsafeMutableRawBufferPointer
+        /// Matches the completion of a transfer to its submission
+        var id: UInt64
+
+        init(
+            type: TransferType,
+            transport: USBTransport,
+            endpoint: UInt8,
+            setup: USBControlSetup?,
+            data: UnsafeMutableRawBufferPointer,
+            id: UInt64
+        ) {
+            self.type = type
+            busNumber = transport.busNumber
+            deviceAddress = transport.deviceAddress
+            // Control transfers are captured on endpoint 0 in the direction of their data stage
+            self.endpoint = setup.map { $0.isDeviceToHost ? 0x80 : 0 } ?? endpoint
+            self.setup = setup
+            self.data = data
+            self.id = id
+        }
+
+        var isIn: Bool {
+            endpoint & 0x80 != 0
+        }
+    }
+
+    private static var currentWriter: CaptureWriter?
+    private static let writerLock = NSLock()
+
+    private static func writer() -> CaptureWriter? {
+        writerLock.lock()
+        defer { writerLock.unlock() }
+        return currentWriter
+    }
+}
+
+/// Encodes packets into a memory buffer and writes the buffer to a pcap file on a background queue.
+final class CaptureWriter {
+    /// LINKTYPE_USB_LINUX_MMAPPED: a 64 byte usbmon header before each packet's data
+    private static let linkType: UInt32 = 220
+    private static let usbmonHeaderSize = 64
+    private static let recordHeaderSize = 16
+    /// The status usbmon gives submissions, -EINPROGRESS
+    private static let inProgress: Int32 = -115
+
+    private let file: FileHandle
+    private let snapshotLength: Int
+    private let queue = DispatchQueue(label: "SwiftLibUSB.USBCapture", qos: .utility)
+
+    /// Packets waiting to be written, and an empty buffer to swap in when they are, guarded by ``lock``
+    private var pending = Data()
+    private var spare = Data()
+    private var flushScheduled = false
+    /// Set by ``close()``. Transfers that fetched the writer before capture stopped may still complete afterwards, and
+    /// must not touch the closed file.
+    private var isClosed = false
+    private var lastID: UInt64 = 0
+    private(set) var droppedPacketCount = 0
+    /// Room to encode one packet's headers without allocating
+    private var header = [UInt8](repeating: 0, count: CaptureWriter.recordHeaderSize + CaptureWriter.usbmonHeaderSize)
+    private let lock = NSLock()
+
+    /// Create the file and write the pcap file header.
+    init(url: URL, snapshotLength: Int) throws {
+        guard FileManager.default.createFile(atPath: url.path, contents: nil) else {
+            throw CocoaError(.fileWriteUnknown, userInfo: [NSFilePathErrorKey: url.path])
+        }
+        file = try FileHandle(forWritingTo: url)
+        self.snapshotLength = max(0, snapshotLength)
+
+        var fileHeader = [UInt8](repeating: 0, count: 24)
+        fileHeader.withUnsafeMutableBytes { buffer in
+            buffer.storeBytes(of: UInt32(0xA1B2_C3D4).littleEndian, toByteOffset: 0, as: UInt32.self)
+            buffer.storeBytes(of: UInt16(2).littleEndian, toByteOffset: 4, as: UInt16.self)
+            buffer.storeBytes(of: UInt16(4).littleEndian, toByteOffset: 6, as: UInt16.self)
+            // Time zone offset and timestamp accuracy are left 0, as is conventional
+            buffer.storeBytes(of: UInt32(self.snapshotLength + Self.usbmonHeaderSize).littleEndian, toByteOffset: 16, as: UInt32.self)
+            buffer.storeBytes(of: Self.linkType.littleEndian, toByteOffset: 20, as: UInt32.self)
+        }
+        file.write(Data(fileHeader))
+    }
+
+    func nextID() -> UInt64 {
+        lock.lock()
+        defer { lock.unlock() }
+        lastID += 1
+        return lastID
+    }
+
+    /// Capture a transfer being handed to the device. Out transfers carry their data here.
+    func submit(_ packet: USBCapture.Packet) {
+        let length = packet.setup.map { Int($0.length) } ?? packet.data.count
+        let sendsData = !packet.isIn && length > 0
+        append(
+            packet,
+            event: "S",
+            status: Self.inProgress,
+            length: length,
+            data: sendsData ? UnsafeRawBufferPointer(rebasing: packet.data[..<min(length, packet.data.count)]) : nil,
+            noDataFlag: packet.isIn ? "<" : "-")
+    }
+
+    /// Capture a transfer finishing. In transfers carry their data here.
+    func complete(_ packet: USBCapture.Packet, count: Int, error: Swift.Error?) {
+        let receivesData = packet.isIn && count > 0
+        append(
+            packet,
+            event: "C",
+            status: error.map { Self.status(of: $0) } ?? 0,
+            length: count,
+            data: receivesData ? UnsafeRawBufferPointer(rebasing: packet.data[..<min(count, packet.data.count)]) : nil,
+            noDataFlag: packet.isIn ? "<" : ">",
+            includeSetup: false)
+    }
+
+    /// Write everything buffered so far, waiting until it is on its way to the disk.
+    func flushNow() {
+        queue.sync { writePending() }
+    }
+
+    /// Write everything buffered so far and close the file.
+    func close() {
+        queue.sync {
+            lock.lock()
+            if isClosed {
+                lock.unlock()
+                return
+            }
+            isClosed = true
+            let data = pending
+            pending = Data()
+            lock.unlock()
+
+            if !data.isEmpty {
+                file.write(data)
+            }
+            file.closeFile()
+        }
+    }
+
+    /// Encode one usbmon event after a pcap record header.
+    private func append(
+        _ packet: USBCapture.Packet,
+        event: Character,
+        status: Int32,
+        length: Int,
+        data: UnsafeRawBufferPointer?,
+        noDataFlag: Character,
+        includeSetup: Bool = true
+    ) {
+        let captured = min(data?.count ?? 0, snapshotLength)
+        let now = Date().timeIntervalSince1970
+        let seconds = Int64(now)
+        let microseconds = Int32((now - Double(seconds)) * 1_000_000)
+        let setup = includeSetup ? packet.setup : nil
+
+        lock.lock()
+        if isClosed {
+            lock.unlock()
+            return
+        }
+        if pending.count + header.count + captured > USBCapture.maxBufferedBytes {
+            droppedPacketCount += 1
+            lock.unlock()
+            return
+        }
+        header.withUnsafeMutableBytes { buffer in
+            for index in buffer.indices {
+                buffer[index] = 0
+            }
+            // pcap record header
+            buffer.storeBytes(of: UInt32(truncatingIfNeeded: seconds).littleEndian, toByteOffset: 0, as: UInt32.self)
+            buffer.storeBytes(of: UInt32(microseconds).littleEndian, toByteOffset: 4, as: UInt32.self)
+            let recordLength = UInt32(Self.usbmonHeaderSize + captured).littleEndian
+            buffer.storeBytes(of: recordLength, toByteOffset: 8, as: UInt32.self)
+            buffer.storeBytes(of: recordLength, toByteOffset: 12, as: UInt32.self)
+
+            // usbmon header, as struct usbmon_packet in the Linux kernel's Documentation/usb/usbmon.rst
+            let base = Self.recordHeaderSize
+            buffer.storeBytes(of: packet.id.littleEndian, toByteOffset: base, as: UInt64.self)
+            buffer[base + 8] = event.asciiValue ?? 0
+            buffer[base + 9] = packet.type.rawValue
+            buffer[base + 10] = packet.endpoint
+            buffer[base + 11] = packet.deviceAddress
+            buffer.storeBytes(of: packet.busNumber.littleEndian, toByteOffset: base + 12, as: UInt16.self)
+            buffer[base + 14] = setup == nil ? Character("-").asciiValue! : 0
+            buffer[base + 15] = captured > 0 ? 0 : noDataFlag.asciiValue ?? 0
+            buffer.storeBytes(of: seconds.littleEndian, toByteOffset: base + 16, as: Int64.self)
+            buffer.storeBytes(of: microseconds.littleEndian, toByteOffset: base + 24, as: Int32.self)
+            buffer.storeBytes(of: status.littleEndian, toByteOffset: base + 28, as: Int32.self)
+            buffer.storeBytes(of: UInt32(length).littleEndian, toByteOffset: base + 32, as: UInt32.self)
+            buffer.storeBytes(of: UInt32(captured).littleEndian, toByteOffset: base + 36, as: UInt32.self)
+            if let setup = setup {
+                buffer[base + 40] = setup.requestType
+                buffer[base + 41] = setup.request
+                buffer.storeBytes(of: setup.value.littleEndian, toByteOffset: base + 42, as: UInt16.self)
+                buffer.storeBytes(of: setup.index.littleEndian, toByteOffset: base + 44, as: UInt16.self)
+                buffer.storeBytes(of: setup.length.littleEndian, toByteOffset: base + 46, as: UInt16.self)
+            }
+            // Interval, start frame, transfer flags and isochronous descriptor count stay 0
+        }
+        pending.append(contentsOf: header)
+        if let data = data, captured > 0 {
+            pending.append(contentsOf: UnsafeRawBufferPointer(rebasing: data[..<captured]))
+        }
+        let schedule = !flushScheduled
+        flushScheduled = true
+        lock.unlock()
+
+        if schedule {
+            queue.asyncAfter(deadline: .now() + USBCapture.flushInterval) { [weak self] in
+                self?.writePending()
+            }
+        }
+    }
+
+    /// Swap the buffers and write the full one. Only called on ``queue``.
+    private func writePending() {
+        lock.lock()
+        if isClosed {
+            lock.unlock()
+            return
+        }
+        var data = pending
+        pending = spare
+        spare = Data()
+        flushScheduled = false
+        lock.unlock()
+
+        if !data.isEmpty {
+            file.write(data)
+        }
+        data.removeAll(keepingCapacity: true)
+        lock.lock()
+        spare = data
+        lock.unlock()
+    }
+
+    /// The negative errno usbmon would report for a failed transfer.
+    private static func status(of error: Swift.Error) -> Int32 {
+        switch error as? USBError {
+        case .some(.timeout):
+            // Transfers that time out are cancelled, which the kernel reports as -ENOENT
+            return -2
+        case .some(.pipe):
+            return -32 // -EPIPE
+        case .some(.overflow):
+            return -75 // -EOVERFLOW
+        case .some(.noDevice):
+            return -19 // -ENODEV
+        case .some(.interrupted):
+            return -4 // -EINTR
+        default:
+            return -71 // -EPROTO
+        }
+    }
+}
@@ -6,7 +6,6 @@
 //
 
 import Foundation
-import Usb
 
 /// A top-level setting for how a device communicates.
 ///
@@ -17,42 +16,13 @@ public class Configuration: Hashable {
     /// An internal class to manage the lifetime of the configuration
     private var config: ConfigurationRef
     
-    /// Load the configuration with the given index
+    /// Create the configuration described by `descriptor`.
     ///
-    /// - throws: A ``USBError`` if getting the configuration fails
-    /// * `.notFound` if the index is invalid.
-    init(_ device: DeviceRef, index: UInt8) throws {
-        var desc: UnsafeMutablePointer<libusb_config_descriptor>? = nil
-        let error = libusb_get_config_descriptor(device.rawDevice, index, &desc)
-        if error < 0 {
-            throw USBError(rawValue: error) ?? USBError.other
-        }
-        config = ConfigurationRef(device: device, descriptor: desc!)
-        interfaces = []
-        getInterfaces()
-    }
-    
-    /// Get the descriptor of the active configuration.
-    ///
-    /// - throws: A ``USBError`` if getting the configuration fails
-    /// * `.notFound` if the device is not configured
-    init(_ device: DeviceRef) throws {
-        var desc: UnsafeMutablePointer<libusb_config_descriptor>? = nil
-        let error = libusb_get_active_config_descriptor(device.rawDevice, &desc)
-        if error < 0 {
-            throw USBError(rawValue: error) ?? USBError.other
-        }
-        config = ConfigurationRef(device: device, descriptor: desc!)
+    /// This is called internally by the ``Device``.
+    init(transport: USBTransport, descriptor: USBConfigurationDescriptor) {
+        config = ConfigurationRef(transport: transport, descriptor: descriptor)
         interfaces = []
-        getInterfaces()
-    }
-    
-    /// Get the interfces of the configuration.
-    ///
-    /// This exists to reduce code duplication between the two constructors.
-    private func getInterfaces(){
-        let size = Int(config.numInterfaces)
-        for i in 0..<size {
+        for i in 0..<descriptor.interfaces.count {
             interfaces.append(Interface(config: config, index: i))
         }
     }
@@ -80,9 +50,9 @@ public class Configuration: Hashable {
         }
     }
     
-    /// Compare configurations by their internal pointer. Two configuration classes that point to the same `libUSB_config_descriptor` are considered the same
+    /// Compare configurations by their device and value. Two configuration classes that select the same configuration of the same device are considered the same
     public static func == (lhs: Configuration, rhs: Configuration) -> Bool {
-        lhs.config.descriptor == rhs.config.descriptor
+        lhs.config.transport === rhs.config.transport && lhs.value == rhs.value
     }
     
     /// The maximum power draw of the device in this port used with this configuration
@@ -135,80 +105,66 @@ public class Configuration: Hashable {
     /// * `.noDevice` if the device has been unplugged
     /// * `.connectionClosed` if the device was closed using ``Device/close()``
     public func setActive() throws {
-        guard let handle = config.rawHandle else {
-            throw USBError.connectionClosed
-        }
-        libusb_set_configuration(handle, // The handle we are configuring ourselves with
-                                 Int32(value)) // our value
+        try config.transport.setConfiguration(value)
+    }
+    
+    /// Check whether this is the device's active configuration.
+    ///
+    /// The operating system usually answers without a request to the device. Setting a configuration that is already
+    /// active makes many devices reset themselves, so check this before calling ``setActive()``.
+    ///
+    /// - returns: True if the device is in this configuration
+    /// - throws: A ``USBError`` if the active configuration can't be read
+    /// * `.noDevice` if the device has been unplugged
+    /// * `.connectionClosed` if the device was closed using ``Device/close()``
+    public func isActive() throws -> Bool {
+        try config.transport.activeConfiguration() == value
     }
     
     /// A hash representation of the configuration
     public func hash(into hasher: inout Hasher) {
-        config.descriptor.hash(into: &hasher)
+        ObjectIdentifier(config.transport).hash(into: &hasher)
+        value.hash(into: &hasher)
     }
 }
 
 /// An internal class for managing lifetimes
 ///
-/// This exists to ensure the libUSB device and context outlive any child objects.
+/// This exists to ensure the device's transport outlives any child objects.
 internal class ConfigurationRef {
-    var device: DeviceRef
-    var descriptor: UnsafeMutablePointer<libusb_config_descriptor>
+    let transport: USBTransport
+    let descriptor: USBConfigurationDescriptor
     
-    init(device: DeviceRef, descriptor: UnsafeMutablePointer<libusb_config_descriptor>) {
-        self.device = device
+    init(transport: USBTransport, descriptor: USBConfigurationDescriptor) {
+        self.transport = transport
         self.descriptor = descriptor
     }
     
     func getStringDescriptor(index: UInt8) -> String? {
-        device.getStringDescriptor(index: index)
-    }
-    
-    var rawHandle: OpaquePointer? {
-        get {
-            device.rawHandle
-        }
-    }
-    
-    var rawDevice: OpaquePointer {
-        get {
-            device.rawDevice
-        }
-    }
-    
-    var numInterfaces: UInt8 {
-        get {
-            descriptor.pointee.bNumInterfaces
-        }
+        transport.stringDescriptor(index: index)
     }
     
     var value: UInt8 {
         get {
-            descriptor.pointee.bConfigurationValue
+            descriptor.value
         }
     }
     
     var index: UInt8 {
         get {
-            descriptor.pointee.iConfiguration
+            descriptor.nameIndex
         }
     }
     
     var maxPower: Int {
         get {
-            Int(descriptor.pointee.MaxPower)
+            Int(descriptor.maxPower)
         }
     }
     
     var bmAttributes: Int {
         get {
-            Int(descriptor.pointee.bmAttributes)
+            Int(descriptor.attributes)
         }
     }
-    
-    
-    
-    deinit {
-        libusb_free_config_descriptor(descriptor)
-    }
 }
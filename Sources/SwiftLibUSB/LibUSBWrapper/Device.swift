@@ -6,16 +6,15 @@
 //
 
 import Foundation
-import Usb
 
 /// Class representing an available USB device.
 ///
 /// Communicating with the device requires configuring a ``Configuration``, ``Interface``, and ``AltSetting``.
 public class Device: Hashable {
-    /// The device as libUSB understands it. It is managed as a pointer
-    private var device: DeviceRef
-    /// A C struct containing information about the device
-    private var descriptor: libusb_device_descriptor
+    /// The connection to the device. For devices found through a ``Context`` this is libUSB.
+    let transport: USBTransport
+    /// The device descriptor, which holds information about the device
+    private var descriptor: USBDeviceDescriptor
     /// Each device has "configurations" which manage their operation.
     public var configurations: [Configuration]
     
@@ -27,26 +26,28 @@ public class Device: Hashable {
     ///   - context: The associated context class
     ///   - pointer: The pointer to the device
     /// - Throws:  ``USBError`` if libUSB returns an error
-    init(context: ContextRef, pointer: OpaquePointer) throws {
-        try device = DeviceRef(context: context, device: pointer)
-        
-        descriptor = libusb_device_descriptor()
-        let error = libusb_get_device_descriptor(device.rawDevice, &descriptor)
-        if error < 0 {
-            throw USBError(rawValue: error) ?? USBError.other
-        }
-
+    convenience init(context: ContextRef, pointer: OpaquePointer) throws {
+        self.init(transport: try LibUSBTransport(context: context, device: pointer))
+    }
+    
+    /// Construct a device that communicates through the given transport.
+    ///
+    /// Devices found through a ``Context`` use libUSB. Other transports, such as ``InMemoryTransport``, can be used to
+    /// run code written against ``Device`` without hardware.
+    ///
+    /// - Parameter transport: The connection to the device, which should already be open
+    public init(transport: USBTransport) {
+        self.transport = transport
+        descriptor = transport.deviceDescriptor
         configurations = []
-        for i in 0..<descriptor.bNumConfigurations {
-            do {
-                try configurations.append(Configuration(device, index: i))
-            } catch {} // Ignore configurations with errors
+        for config in transport.configurationDescriptors {
+            configurations.append(Configuration(transport: transport, descriptor: config))
         }
     }
     
-    /// Compare devices by their internal pointer. Two device classes that point to the same libUSB device are considered the same
+    /// Compare devices by their transport. Two device classes that use the same connection are considered the same
     public static func == (lhs: Device, rhs: Device) -> Bool {
-        lhs.device.rawDevice == rhs.device.rawDevice
+        lhs.transport === rhs.transport
     }
     
     /// The product ID of the device.
@@ -54,7 +55,7 @@ public class Device: Hashable {
     /// This, along with the vendor ID and serial number, uniquely identify a device.
     public var productId: Int {
         get {
-            Int(descriptor.idProduct)
+            Int(descriptor.productID)
         }
     }
     
@@ -63,7 +64,7 @@ public class Device: Hashable {
     /// This, along with the product ID and serial number, uniquely identify a device.
     public var vendorId: Int {
         get {
-            Int(descriptor.idVendor)
+            Int(descriptor.vendorID)
         }
     }
 
@@ -73,12 +74,12 @@ public class Device: Hashable {
     /// multiple connected devices of the same model, which have the same vendor and product IDs but different
     /// serial numbers.
     public var serialNumber: String {
-        device.getStringDescriptor(index: descriptor.iSerialNumber) ?? ""
+        transport.stringDescriptor(index: descriptor.serialNumberIndex) ?? ""
     }
     
     /// The name of the device, or its vendor and product IDs if the device does not give a name.
     public var displayName: String {
-        device.getStringDescriptor(index: descriptor.iProduct) ?? "Vendor: \(vendorId) Product: \(productId)"
+        transport.stringDescriptor(index: descriptor.productIndex) ?? "Vendor: \(vendorId) Product: \(productId)"
     }
     
     /// Name of the manufacturer of the device
@@ -86,7 +87,7 @@ public class Device: Hashable {
     /// Retrieved from the iManufacturer index
     public var manufacturerName: String {
         get {
-            device.getStringDescriptor(index: descriptor.iManufacturer) ?? ""
+            transport.stringDescriptor(index: descriptor.manufacturerIndex) ?? ""
         }
     }
     
@@ -94,7 +95,7 @@ public class Device: Hashable {
     /// If this description was not provided by the device, this string is empty
     public var productName: String {
         get {
-            device.getStringDescriptor(index: descriptor.iProduct) ?? ""
+            transport.stringDescriptor(index: descriptor.productIndex) ?? ""
         }
     }
     
@@ -103,7 +104,7 @@ public class Device: Hashable {
     /// This is derived from the bDeviceClass value
     public var deviceClass: ClassCode {
         get {
-            return ClassCode(rawValue: descriptor.bDeviceClass) ?? ClassCode.other
+            return ClassCode(rawValue: descriptor.deviceClass) ?? ClassCode.other
         }
     }
     
@@ -112,7 +113,7 @@ public class Device: Hashable {
     /// This is derived from the bDeviceSubClass value
     public var deviceSubclass: Int {
         get {
-            Int(descriptor.bDeviceClass)
+            Int(descriptor.deviceClass)
         }
     }
     
@@ -120,7 +121,7 @@ public class Device: Hashable {
     /// The protocol is specific to the subclass of the device.
     public var deviceProtocol: Int {
         get {
-            Int(descriptor.bDeviceProtocol)
+            Int(descriptor.deviceProtocol)
         }
     }
     
@@ -156,7 +157,7 @@ public class Device: Hashable {
     /// This is measured in bytes.
     public var packetSizeEndpoint0: Int {
         get {
-            Int(descriptor.bMaxPacketSize0)
+            Int(descriptor.maxPacketSize0)
         }
     }
     
@@ -165,7 +166,28 @@ public class Device: Hashable {
     /// No communication can be done with the device while it is closed. It can be reopened by calling
     /// ``reopen()``. This does nothing if the device is already closed.
     public func close() {
-        device.close()
+        transport.close()
+    }
+    
+    /// True if the connection to the device is open.
+    ///
+    /// This only reflects calls to ``close()`` and ``reopen()``; it does not check that the device is still connected.
+    public var isOpen: Bool {
+        get {
+            transport.isOpen
+        }
+    }
+    
+    /// Get the value of the active configuration.
+    ///
+    /// The operating system usually answers from its own records without a request to the device, so this is a cheap
+    /// way to check that the device is still connected.
+    /// - Returns: The ``Configuration/value`` of the active configuration, or 0 if the device is not configured
+    /// - Throws: a ``USBError``
+    ///    * ``USBError/noDevice`` if the device was disconnected
+    ///    * ``USBError/connectionClosed`` if the device was closed using ``close()``
+    public func activeConfigurationValue() throws -> Int {
+        try transport.activeConfiguration()
     }
     
     /// Reopen the connection to the device
@@ -176,7 +198,19 @@ public class Device: Hashable {
     ///    * ``USBError/access`` if the user has insufficient permissions
     ///    * ``USBError/noDevice`` if the device was disconnected
     public func reopen() throws {
-        try device.reopen()
+        try transport.reopen()
+    }
+    
+    /// Reset the device, as if it had been unplugged and plugged back in.
+    ///
+    /// libUSB restores the active configuration and any claimed interfaces afterwards, so the device can be used again
+    /// straight away. If the device describes itself differently after the reset, it has to be found again.
+    /// - Throws: a ``USBError``
+    ///    * ``USBError/notFound`` if the device must be found again, in which case this ``Device`` can't be used
+    ///    * ``USBError/noDevice`` if the device was disconnected
+    ///    * ``USBError/connectionClosed`` if the device was closed using ``close()``
+    public func reset() throws {
+        try transport.reset()
     }
     
     /// Send a control transfer to a device.
@@ -200,17 +234,16 @@ public class Device: Hashable {
         timeout: UInt32
     ) throws -> Data {
         var charArrayData = [UInt8](data)
-        let returnVal = libusb_control_transfer(
-            device.rawHandle,
-            requestType,
-            request,
-            value,
-            index,
-            &charArrayData,
-            length,
-            timeout)
-        if returnVal < 0 {
-            throw USBError(rawValue: returnVal) ?? USBError.other
+        if charArrayData.count < Int(length) {
+            charArrayData += [UInt8](repeating: 0, count: Int(length) - charArrayData.count)
+        }
+        let setup = USBControlSetup(requestType: requestType, request: request, value: value, index: index, length: length)
+        _ = try charArrayData.withUnsafeMutableBytes { buffer in
+            try USBTrace.trace("control transfer", category: "usb", endpoint: 0, size: { $0 }) {
+                try USBCapture.capture(.control, transport: transport, endpoint: 0, setup: setup, data: buffer) {
+                    try transport.controlTransfer(setup, data: buffer, timeout: Int(timeout))
+                }
+            }
         }
         return Data(charArrayData)
     }
@@ -257,74 +290,6 @@ public class Device: Hashable {
     
     /// A hash representation of the device
     public func hash(into hasher: inout Hasher) {
-        device.rawDevice.hash(into: &hasher)
+        ObjectIdentifier(transport).hash(into: &hasher)
     }
 }
-
-/// Internal class for managing lifetimes
-///
-/// This ensures the libUSB context is not freed until all the devices have been closed.
-internal class DeviceRef {
-    let context: ContextRef
-    let rawDevice: OpaquePointer
-    var rawHandle: OpaquePointer?
-    var open: Bool
-    
-    init(context: ContextRef, device: OpaquePointer) throws {
-        self.context = context
-        rawDevice = device
-        rawHandle = nil
-        let error = libusb_open(device, &rawHandle)
-        if error < 0 {
-            throw USBError(rawValue: error) ?? USBError.other
-        }
-        open = rawHandle != nil
-    }
-    
-    func close() {
-        if open {
-            libusb_close(rawHandle)
-            open = false
-        }
-    }
-    
-    func reopen() throws {
-        if !open {
-            let error = libusb_open(rawDevice, &rawHandle)
-            if error < 0 {
-                throw USBError(rawValue: error) ?? USBError.other
-            }
-            open = rawHandle != nil
-        }
-    }
-    
-    func getStringDescriptor(index: UInt8) -> String? {
-        if index == 0 {
-            return nil
-        }
-        
-        let size = 256;
-        var buffer: [UInt8] = Array(repeating: 0, count: size)
-        let returnValue = libusb_get_string_descriptor_ascii(
-            rawHandle,
-            index,
-            &buffer,
-            Int32(size))
-        
-        // If the return value is negative, there was an error. If positive, it's the number
-        // of bytes in the string.
-        if returnValue <= 0 {
-            return nil
-        }
-        
-        return String(bytes: buffer[..<Int(returnValue)], encoding: .ascii)
-    }
-    
-    deinit {
-        if open {
-            libusb_close(rawHandle)
-        }
-    }
-}
-
-
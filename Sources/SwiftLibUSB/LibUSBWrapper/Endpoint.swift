@@ -6,7 +6,6 @@
 //
 
 import Foundation
-import Usb
 
 /// A communication channel with the device.
 ///
@@ -18,12 +17,16 @@ import Usb
 /// it must be activated. This is done by calling `config.setActive()`, `interface.claim()`, and
 /// `setting.setActive()`
 public class Endpoint {
-    /// The descriptor of the endpoint is pointed to by this pointer. This is the raw descriptor as given by libUSB, which is hard to use. Getter methods should be used instead of referencing this directly. [It is documented here](https://libusb.sourceforge.io/api-1.0/structlibusb__endpoint__descriptor.html)
-    private var descriptor: UnsafePointer<libusb_endpoint_descriptor>
+    /// The descriptor of the endpoint. Getter methods should be used instead of referencing this directly. [The libUSB version is documented here](https://libusb.sourceforge.io/api-1.0/structlibusb__endpoint__descriptor.html)
+    private var descriptor: USBEndpointDescriptor
     
     /// Because all endpoints belong to an altsetting, the altsetting the endpoint belongs to is stored by the endpoint
     private var altSetting: AltSettingRef
     
+    /// Counts of the transfers made so far, guarded by ``statisticsLock`` as endpoints may be shared between threads
+    private var _statistics = EndpointStatistics()
+    private let statisticsLock = NSLock()
+    
     /// Creates the endpoint itself. This is generally done automatically.
     /// - Parameters:
     ///   - altSetting: the atlernative setting this endpoint refers to
@@ -38,7 +41,7 @@ public class Endpoint {
     /// It corresponds to the value bEndpointAddress as defined by libUSB
     public var address: Int {
         get {
-            Int(descriptor.pointee.bEndpointAddress)
+            Int(descriptor.address)
         }
     }
     
@@ -55,7 +58,7 @@ public class Endpoint {
     /// - Bits 6:7 are reserved.
     public var attributes: Int {
         get {
-            Int(descriptor.pointee.bmAttributes)
+            Int(descriptor.attributes)
         }
     }
     
@@ -63,7 +66,7 @@ public class Endpoint {
     ///  Each sent packet must not exceed this size
     public var maxPacketSize: Int {
         get{
-            Int(descriptor.pointee.wMaxPacketSize)
+            Int(descriptor.maxPacketSize)
         }
     }
     
@@ -73,7 +76,7 @@ public class Endpoint {
     ///  Isochronous endpoints will always have an interval of 1 frame
     public var interval: Int {
         get{
-            Int(descriptor.pointee.bInterval)
+            Int(descriptor.interval)
         }
     }
     
@@ -82,7 +85,7 @@ public class Endpoint {
     /// The rate at which synchronization feedback is provided.
     public var audioRefresh: Int {
         get{
-            Int(descriptor.pointee.bRefresh)
+            Int(descriptor.refresh)
         }
     }
     
@@ -91,7 +94,7 @@ public class Endpoint {
     /// The address to which synchronozation is provided
     public var audioSynchAddress: Int {
         get{
-            Int(descriptor.pointee.bSynchAddress)
+            Int(descriptor.synchAddress)
         }
     }
 
@@ -104,7 +107,7 @@ public class Endpoint {
     public var direction: Direction {
         get {
             // Shifting a UInt8 by seven bits can only leave 1 or 0, so we can force unwrap.
-            Direction(rawValue: descriptor.pointee.bEndpointAddress >> 7)!
+            Direction(rawValue: descriptor.address >> 7)!
         }
     }
     
@@ -117,7 +120,7 @@ public class Endpoint {
         get {
             // Bitwise ANDing with 3 always results in a number 0-3, all of which are
             // defined TransferTypes, so we can force unwrap.
-            TransferType(rawValue: descriptor.pointee.bmAttributes & 3)!
+            TransferType(rawValue: descriptor.attributes & 3)!
         }
     }
     
@@ -129,12 +132,9 @@ public class Endpoint {
     /// * ``USBError/connectionClosed`` if the device was closed using ``Device/close()``
     /// * ``USBError/noDevice`` if the device was disconnected
     public func clearHalt() throws {
-        guard let handle = altSetting.rawHandle else {
-            throw USBError.connectionClosed
-        }
-        let error = libusb_clear_halt(handle, descriptor.pointee.bEndpointAddress)
-        if error < 0 {
-            throw USBError(rawValue: error) ?? USBError.other
+        updateStatistics { $0.clearHalts += 1 }
+        try USBTrace.trace("clear halt", category: "usb", endpoint: descriptor.address) {
+            try transport.clearHalt(endpoint: descriptor.address)
         }
     }
     
@@ -159,34 +159,33 @@ public class Endpoint {
             throw USBError.notSupported
         }
 
-        // Make sure the device is open
-        guard let handle = altSetting.rawHandle else {
-            throw USBError.connectionClosed
-        }
-
-        // Define the parameters, these will be passed by reference to libUSB
-        var sent: Int32 = 0;
+        // Copy the data, as the transport is given mutable memory
         var data = [UInt8](data)
         
-        // the length of the data we are sending
-        let length: Int32 = Int32(data.count)
-        
-        // Attempt to perform a bulk out transfer
-        let error = libusb_bulk_transfer(
-            handle,
-            descriptor.pointee.bEndpointAddress,
-            &data,
-            length,
-            &sent,
-            UInt32(timeout))
-        
-        // Throw if the transfer had any errors. Errors are given by sending back a negative value
-        if error < 0 {
-            throw USBError(rawValue: error) ?? USBError.other
+        // Attempt to perform a bulk out transfer, returning the number of bytes sent
+        return try data.withUnsafeMutableBytes { buffer in
+            try transfer(.bulk, "bulk out", data: buffer, timeout: timeout)
+        }
+    }
+    
+    /// Send a message to a bulk out endpoint directly from memory owned by the caller.
+    ///
+    /// This behaves like ``sendBulkTransfer(data:timeout:)``, but the bytes are not copied before being sent.
+    /// - important: This will only work properly if this endpoint is bulk out (`direction == .out` and `.transferType == .bulk`)
+    ///
+    /// - returns: the number of bytes sent
+    /// - throws: a ``USBError`` if the transfer fails, as for ``sendBulkTransfer(data:timeout:)``
+    /// - Parameters:
+    ///   - bytes: the raw bytes to send unaltered to the device through this endpoint
+    ///   - timeout: The time, in millisecounds, to wait before timeout. This is by default one second
+    public func sendBulkTransfer(bytes: UnsafeRawBufferPointer, timeout: Int = 1000) throws -> Int {
+        // Only work if we are the right kind of endpoint
+        if transferType != .bulk || direction != .out {
+            throw USBError.notSupported
         }
         
-        // Return the number of bytes send
-        return Int(sent)
+        // Transports do not modify the buffer of an out transfer, so it is safe to pass it as mutable
+        return try transfer(.bulk, "bulk out", data: UnsafeMutableRawBufferPointer(mutating: bytes), timeout: timeout)
     }
     
     /// Receive a message from a bulk in endpoint. This will cutoff any extra bytes sent back by the device, only including up to the length the device intended to send. This does not do any output operations, only recieving data.
@@ -211,30 +210,238 @@ public class Endpoint {
             throw USBError.notSupported
         }
         
-        // Make sure the device is open
-        guard let handle = altSetting.rawHandle else {
-            throw USBError.connectionClosed
-        }
-        
-        // Create the buffer and an integer that will be set to the length of the data recieved
-        var sent: Int32 = 0;
+        // Create the buffer that will hold the data recieved
         var innerData = [UInt8](repeating: 0, count: Int(length))
         
         // Attempt to perform a bulk in transfer
-        let error = libusb_bulk_transfer(
-            handle,
-            descriptor.pointee.bEndpointAddress,
-            &innerData,
-            Int32(length),
-            &sent,
-            UInt32(timeout))
-        
-        // Throw if the transfer had any errors
-        if error < 0 {
-            throw USBError(rawValue: error) ?? USBError.other
+        let sent = try innerData.withUnsafeMutableBytes { buffer in
+            try transfer(.bulk, "bulk in", data: buffer, timeout: timeout)
         }
         
         // Turn the returned array into type Data, then return it.
-        return Data(innerData[..<Int(sent)]) // We cutoff extra data larger than the amount recieved
+        return Data(innerData[..<sent]) // We cutoff extra data larger than the amount recieved
+    }
+    
+    /// Receive a message from a bulk in endpoint directly into memory owned by the caller.
+    ///
+    /// This behaves like ``receiveBulkTransfer(length:timeout:)``, but no buffer is allocated for the transfer, which
+    /// matters when receiving many chunks of a large message.
+    /// - important: This will only work properly if this endpoint is bulk in (`direction == .in` and `.transferType == .bulk`)
+    ///
+    /// - returns: the number of bytes received, which are at the start of `buffer`
+    /// - throws: a ``USBError`` if the transfer fails, as for ``receiveBulkTransfer(length:timeout:)``
+    /// - Parameters:
+    ///   - buffer: The memory to receive into. At most `buffer.count` bytes are requested from the device.
+    ///   - timeout: The amount of time, in milliseconds to wait before timing out of the message. The default is 1000(1 second)
+    public func receiveBulkTransfer(into buffer: UnsafeMutableRawBufferPointer, timeout: Int = 1000) throws -> Int {
+        // Throw an error if this is the wrong kind of endpoint
+        if transferType != .bulk || direction != .in {
+            throw USBError.notSupported
+        }
+        
+        // Attempt to perform a bulk in transfer straight into the given memory
+        return try transfer(.bulk, "bulk in", data: buffer, timeout: timeout)
+    }
+
+    /// Send a message to an interrupt out endpoint. Like ``sendBulkTransfer(data:timeout:)``, the data is sent as it was given.
+    ///
+    /// - important: This will only work properly if this endpoint is interrupt out (`direction == .out` and `.transferType == .interrupt`)
+    ///
+    /// - returns: the number of bytes sent
+    /// - throws: a ``USBError`` if the transfer fails, as for ``sendBulkTransfer(data:timeout:)``
+    /// * ``USBError/notSupported`` if this is not an interrupt out endpoint
+    /// - Parameters:
+    ///   - data: the raw bytes to send unaltered to the device through this endpoint. This should be no longer than ``maxPacketSize``
+    ///   - timeout: The time, in millisecounds, to wait before timeout. This is by default one second
+    public func sendInterruptTransfer(data: Data, timeout: Int = 1000) throws -> Int {
+        // Only work if we are the right kind of endpoint
+        if transferType != .interrupt || direction != .out {
+            throw USBError.notSupported
+        }
+
+        var data = [UInt8](data)
+        return try data.withUnsafeMutableBytes { buffer in
+            try transfer(.interrupt, "interrupt out", data: buffer, timeout: timeout)
+        }
+    }
+
+    /// Receive one report from an interrupt in endpoint.
+    ///
+    /// Reports the device sends while no transfer is waiting may be lost. To receive every report, use ``startPolling(length:handler:)``.
+    /// - important: This will only work properly if this endpoint is interrupt in (`direction == .in` and `.transferType == .interrupt`)
+    ///
+    /// - returns: the bytes received
+    /// - throws: a ``USBError`` if the transfer fails, as for ``receiveBulkTransfer(length:timeout:)``
+    /// * ``USBError/timeout`` if the device had nothing to report in time
+    /// * ``USBError/notSupported`` if this is not an interrupt in endpoint
+    /// - Parameters:
+    ///   - length: The most bytes to receive. By default this is ``maxPacketSize``
+    ///   - timeout: The amount of time, in milliseconds to wait before timing out of the message. The default is 1000(1 second)
+    public func receiveInterruptTransfer(length: Int? = nil, timeout: Int = 1000) throws -> Data {
+        // Throw an error if this is the wrong kind of endpoint
+        if transferType != .interrupt || direction != .in {
+            throw USBError.notSupported
+        }
+
+        var innerData = [UInt8](repeating: 0, count: length ?? maxPacketSize)
+        let received = try innerData.withUnsafeMutableBytes { buffer in
+            try transfer(.interrupt, "interrupt in", data: buffer, timeout: timeout)
+        }
+        return Data(innerData[..<received])
+    }
+
+    /// Keep a transfer submitted to this interrupt in endpoint, calling `handler` with every report the device sends.
+    ///
+    /// For libUSB devices, more than one transfer is kept queued, so the host asks the device for its next report while
+    /// the previous one is being handled. This is how HID reports and USB488 service requests should be received.
+    /// Reports are counted in ``statistics`` and captured by ``USBCapture`` as they arrive.
+    ///
+    /// Stop polling before closing the device.
+    ///
+    /// ```swift
+    /// let polling = try endpoint.startPolling { result in
+    ///     if case .success(let report) = result {
+    ///         print("status byte", report[1])
+    ///     }
+    /// }
+    /// // ...
+    /// polling.stop()
+    /// ```
+    /// - important: This will only work properly if this endpoint is interrupt in (`direction == .in` and `.transferType == .interrupt`)
+    ///
+    /// - returns: The polling, which continues until ``USBInterruptPolling/stop()`` is called or a transfer fails
+    /// - throws:
+    /// * ``USBError/notSupported`` if this is not an interrupt in endpoint
+    /// * ``USBError/connectionClosed`` if the device was closed using ``Device/close()``
+    /// * another ``USBError`` if the transfers can't be submitted
+    /// - Parameters:
+    ///   - length: The most bytes of each report. By default this is ``maxPacketSize``
+    ///   - handler: Called on a background thread with each report, in order, or once with the error that ended polling.
+    ///     It must not block for long, as the next report is handled on the same thread.
+    public func startPolling(
+        length: Int? = nil,
+        handler: @escaping (Result<Data, Swift.Error>) -> Void
+    ) throws -> USBInterruptPolling {
+        if transferType != .interrupt || direction != .in {
+            throw USBError.notSupported
+        }
+
+        let length = length ?? maxPacketSize
+        let transport = self.transport
+        let address = descriptor.address
+        // bInterval is in frames of 1ms at full speed; faster devices poll at least this often, which is enough for
+        // transports that have to wait between transfers
+        let period = Double(max(interval, 1)) / 1000
+        return try transport.startInterruptPolling(endpoint: address, length: length, interval: period) { [weak self] result in
+            switch result {
+            case .success(var report):
+                self?.recordTransfer(bytes: report.count)
+                report.withUnsafeMutableBytes { data in
+                    _ = USBCapture.capture(.interrupt, transport: transport, endpoint: address, data: data) { data.count }
+                }
+            case .failure(let error):
+                self?.recordTransfer(error: error)
+            }
+            handler(result)
+        }
+    }
+
+    /// Start streaming from this isochronous in endpoint.
+    ///
+    /// Packets are sized with `libusb_get_max_iso_packet_size`, which accounts for high bandwidth endpoints that move
+    /// several packets per microframe. `transfers` transfers of `packetsPerTransfer` packets each are kept submitted, so
+    /// the device always has somewhere to send to, and every packet's status and data is copied into a ring buffer that
+    /// is read with ``IsochronousStream/read(maxPackets:_:)``. At high speed a packet is sent every 125µs, so the defaults
+    /// keep 32ms of transfers queued and buffer about one second of packets.
+    ///
+    /// The alternate setting containing the endpoint must be active. Stop the stream before closing the device.
+    /// - important: This will only work properly if this endpoint is isochronous in (`direction == .in` and `.transferType == .isochronous`)
+    ///
+    /// - returns: The stream, which runs until ``IsochronousStream/stop()`` is called, it is released, or the device fails
+    /// - throws:
+    /// * ``USBError/notSupported`` if this is not an isochronous in endpoint, or the device is not a libUSB device
+    /// * ``USBError/invalidParam`` if `transfers` or `packetsPerTransfer` is less than 1
+    /// * ``USBError/notFound`` if the endpoint is not in the active alternate setting
+    /// * ``USBError/connectionClosed`` if the device was closed using ``Device/close()``
+    /// * another ``USBError`` if the transfers can't be submitted
+    /// - Parameters:
+    ///   - transfers: The number of transfers kept submitted
+    ///   - packetsPerTransfer: The number of packets in each transfer. Fewer means packets are delivered sooner; more means
+    ///     fewer completions to handle.
+    ///   - bufferedPackets: The fewest packets that can wait to be read before new ones are dropped
+    public func startIsochronousStream(
+        transfers: Int = 8,
+        packetsPerTransfer: Int = 32,
+        bufferedPackets: Int = 8192
+    ) throws -> IsochronousStream {
+        if transferType != .isochronous || direction != .in {
+            throw USBError.notSupported
+        }
+        if transfers < 1 || packetsPerTransfer < 1 {
+            throw USBError.invalidParam
+        }
+
+        return try transport.startIsochronousStream(
+            endpoint: descriptor.address,
+            transferCount: transfers,
+            packetsPerTransfer: packetsPerTransfer,
+            bufferedPackets: max(bufferedPackets, transfers * packetsPerTransfer))
+    }
+
+    /// Counts of the transfers made through this endpoint and the errors they ended with.
+    ///
+    /// Counting is always on. Transfers made by the instrument classes outside of this class's methods, such as
+    /// pipelined queries, are counted too.
+    public var statistics: EndpointStatistics {
+        statisticsLock.lock()
+        defer { statisticsLock.unlock() }
+        return _statistics
+    }
+    
+    /// Make a bulk or interrupt transfer through the transport, counting, tracing and capturing it.
+    private func transfer(
+        _ type: USBCapture.TransferType,
+        _ name: StaticString,
+        data: UnsafeMutableRawBufferPointer,
+        timeout: Int
+    ) throws -> Int {
+        do {
+            let count = try USBTrace.trace(name, category: "usb", endpoint: descriptor.address, size: { $0 }) {
+                try USBCapture.capture(type, transport: transport, endpoint: descriptor.address, data: data) {
+                    if type == .interrupt {
+                        return try transport.interruptTransfer(endpoint: descriptor.address, data: data, timeout: timeout)
+                    }
+                    return try transport.bulkTransfer(endpoint: descriptor.address, data: data, timeout: timeout)
+                }
+            }
+            updateStatistics { $0.record(bytes: count) }
+            return count
+        } catch {
+            updateStatistics { $0.record(error) }
+            throw error
+        }
+    }
+    
+    /// Count a transfer through this endpoint that was made without calling its methods.
+    func recordTransfer(bytes count: Int) {
+        updateStatistics { $0.record(bytes: count) }
+    }
+    
+    /// Count a failed transfer through this endpoint that was made without calling its methods.
+    func recordTransfer(error: Swift.Error) {
+        updateStatistics { $0.record(error) }
+    }
+    
+    private func updateStatistics(_ update: (inout EndpointStatistics) -> Void) {
+        statisticsLock.lock()
+        defer { statisticsLock.unlock() }
+        update(&_statistics)
+    }
+    
+    /// The transport of the device this endpoint belongs to.
+    var transport: USBTransport {
+        get {
+            altSetting.transport
+        }
     }
 }
@@ -0,0 +1,72 @@
+//
+//  EndpointStatistics.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// Counts of the transfers made through an ``Endpoint``, read with ``Endpoint/statistics``.
+public struct EndpointStatistics: Hashable {
+    /// Transfers that completed
+    public var transfers = 0
+    /// Bytes sent or received by completed transfers
+    public var bytes = 0
+    /// Transfers that failed with ``USBError/timeout``
+    public var timeouts = 0
+    /// Transfers that failed with ``USBError/pipe`` because the endpoint halted
+    public var pipeErrors = 0
+    /// Transfers that failed with ``USBError/overflow`` because the device sent more than was asked for
+    public var overflows = 0
+    /// Transfers that failed with any other error
+    public var otherErrors = 0
+    /// Calls to ``Endpoint/clearHalt()``
+    public var clearHalts = 0
+    /// Failed transfers by the ``USBError`` they failed with. Errors of other types are only counted in ``otherErrors``.
+    public var errorCounts: [USBError: Int] = [:]
+
+    public init() {}
+
+    /// Transfers that failed for any reason.
+    public var errors: Int {
+        timeouts + pipeErrors + overflows + otherErrors
+    }
+
+    /// Count a completed transfer.
+    mutating func record(bytes count: Int) {
+        transfers += 1
+        bytes += count
+    }
+
+    /// Count a failed transfer.
+    mutating func record(_ error: Swift.Error) {
+        if let error = error as? USBError {
+            errorCounts[error, default: 0] += 1
+        }
+        switch error as? USBError {
+        case .some(.timeout):
+            timeouts += 1
+        case .some(.pipe):
+            pipeErrors += 1
+        case .some(.overflow):
+            overflows += 1
+        default:
+            otherErrors += 1
+        }
+    }
+
+    /// The sum of two sets of counts, such as those of an endpoint before and after a reconnect.
+    public static func + (lhs: EndpointStatistics, rhs: EndpointStatistics) -> EndpointStatistics {
+        var sum = lhs
+        sum.transfers += rhs.transfers
+        sum.bytes += rhs.bytes
+        sum.timeouts += rhs.timeouts
+        sum.pipeErrors += rhs.pipeErrors
+        sum.overflows += rhs.overflows
+        sum.otherErrors += rhs.otherErrors
+        sum.clearHalts += rhs.clearHalts
+        sum.errorCounts.merge(rhs.errorCounts, uniquingKeysWith: +)
+        return sum
+    }
+}
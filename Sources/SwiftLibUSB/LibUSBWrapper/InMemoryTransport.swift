@@ -0,0 +1,316 @@
+//
+//  InMemoryTransport.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// A ``USBTransport`` for a device that exists only in memory.
+///
+/// The device is described by its descriptors, and its behavior is given by handlers called for each transfer. Without
+/// handlers, data sent to an out endpoint is kept until ``takeSent(endpoint:)`` is called, and an in endpoint returns
+/// the data given to ``enqueue(_:endpoint:)`` in order, timing out when there is none.
+///
+/// Standard requests for the configuration and alternate setting are answered from the state set through the transport,
+/// and requests the control handler does not answer stall, as a real device would.
+///
+/// ```swift
+/// let transport = InMemoryTransport(deviceDescriptor: descriptor, configurationDescriptors: [configuration])
+/// let device = Device(transport: transport)
+/// ```
+public final class InMemoryTransport: USBTransport {
+    public let deviceDescriptor: USBDeviceDescriptor
+    public let configurationDescriptors: [USBConfigurationDescriptor]
+
+    /// The string descriptors of the device, by index.
+    public var strings: [UInt8: String] {
+        get { locked { _strings } }
+        set { locked { _strings = newValue } }
+    }
+
+    /// Called with the endpoint address and data of each bulk or interrupt out transfer.
+    ///
+    /// If this is nil, the data is kept for ``takeSent(endpoint:)``.
+    public var outHandler: ((UInt8, Data) throws -> Void)? {
+        get { locked { _outHandler } }
+        set { locked { _outHandler = newValue } }
+    }
+
+    /// Called with the endpoint address and the most bytes wanted for each bulk or interrupt in transfer.
+    ///
+    /// Returning nil falls back to data given to ``enqueue(_:endpoint:)``. Data longer than the transfer is cut short.
+    public var inHandler: ((UInt8, Int) throws -> Data?)? {
+        get { locked { _inHandler } }
+        set { locked { _inHandler = newValue } }
+    }
+
+    /// Called with the setup packet and, for host to device requests, the data stage of each control transfer.
+    ///
+    /// For device to host requests, the returned data is the data stage. Returning nil handles the request as if
+    /// there were no handler.
+    public var controlHandler: ((USBControlSetup, Data) throws -> Data?)? {
+        get { locked { _controlHandler } }
+        set { locked { _controlHandler = newValue } }
+    }
+
+    /// Called when the device is reset, after data waiting to be read is discarded.
+    public var resetHandler: (() -> Void)? {
+        get { locked { _resetHandler } }
+        set { locked { _resetHandler = newValue } }
+    }
+
+    public var isOpen: Bool {
+        locked { _isOpen }
+    }
+
+    /// The value of the active configuration, or 0 if the device is not configured.
+    public var configurationValue: Int {
+        locked { _configurationValue }
+    }
+
+    /// The numbers of the claimed interfaces.
+    public var claimedInterfaces: Set<Int> {
+        locked { _claimedInterfaces }
+    }
+
+    /// The selected alternate setting of each interface that has changed from setting 0.
+    public var altSettings: [Int: Int] {
+        locked { _altSettings }
+    }
+
+    private var _strings: [UInt8: String]
+    private var _outHandler: ((UInt8, Data) throws -> Void)?
+    private var _inHandler: ((UInt8, Int) throws -> Data?)?
+    private var _controlHandler: ((USBControlSetup, Data) throws -> Data?)?
+    private var _resetHandler: (() -> Void)?
+    private var _isOpen = true
+    private var _configurationValue = 0
+    private var _claimedInterfaces: Set<Int> = []
+    private var _altSettings: [Int: Int] = [:]
+    /// Data waiting to be read from each in endpoint
+    private var pending: [UInt8: [Data]] = [:]
+    /// Data written to each out endpoint without an ``outHandler``
+    private var sent: [UInt8: [Data]] = [:]
+    /// Endpoints that are halted until ``clearHalt(endpoint:)``
+    private var halted: Set<UInt8> = []
+
+    /// Handlers are called without holding the lock, so they may use the transport themselves.
+    private let lock = NSLock()
+
+    /// Create an open, unconfigured device.
+    /// - Parameters:
+    ///   - deviceDescriptor: The descriptor of the device
+    ///   - configurationDescriptors: The configurations of the device
+    ///   - strings: The string descriptors of the device, by index
+    public init(
+        deviceDescriptor: USBDeviceDescriptor,
+        configurationDescriptors: [USBConfigurationDescriptor],
+        strings: [UInt8: String] = [:]
+    ) {
+        self.deviceDescriptor = deviceDescriptor
+        self.configurationDescriptors = configurationDescriptors
+        _strings = strings
+    }
+
+    /// Add data for a later transfer from an in endpoint to return.
+    /// - Parameters:
+    ///   - data: The data of one transfer
+    ///   - endpoint: The address of the in endpoint, including the direction bit
+    public func enqueue(_ data: Data, endpoint: UInt8) {
+        locked { pending[endpoint, default: []].append(data) }
+    }
+
+    /// Remove and return the data written to an out endpoint that had no ``outHandler``.
+    /// - Parameter endpoint: The address of the out endpoint
+    /// - Returns: The data of each transfer, oldest first
+    public func takeSent(endpoint: UInt8) -> [Data] {
+        locked { sent.removeValue(forKey: endpoint) ?? [] }
+    }
+
+    /// Halt an endpoint, so transfers on it fail with ``USBError/pipe`` until the halt is cleared.
+    public func halt(endpoint: UInt8) {
+        _ = locked { halted.insert(endpoint) }
+    }
+
+    public func stringDescriptor(index: UInt8) -> String? {
+        locked { _isOpen && index != 0 ? _strings[index] : nil }
+    }
+
+    public func close() {
+        locked {
+            _isOpen = false
+            _claimedInterfaces = []
+        }
+    }
+
+    public func reopen() throws {
+        locked { _isOpen = true }
+    }
+
+    public func reset() throws {
+        let handler = try locked { () -> (() -> Void)? in
+            try checkOpen()
+            // Like libUSB, the configuration and claimed interfaces are restored after the reset
+            pending = [:]
+            halted = []
+            return _resetHandler
+        }
+        handler?()
+    }
+
+    public func activeConfiguration() throws -> Int {
+        try locked {
+            try checkOpen()
+            return _configurationValue
+        }
+    }
+
+    public func setConfiguration(_ value: Int) throws {
+        try locked {
+            try checkOpen()
+            if value != 0 && !configurationDescriptors.contains(where: { Int($0.value) == value }) {
+                throw USBError.notFound
+            }
+            if !_claimedInterfaces.isEmpty {
+                throw USBError.busy
+            }
+            _configurationValue = value
+            _altSettings = [:]
+        }
+    }
+
+    public func claimInterface(_ number: Int) throws {
+        try locked {
+            try checkOpen()
+            guard activeInterfaces()?.indices.contains(number) ?? false else {
+                throw USBError.notFound
+            }
+            _claimedInterfaces.insert(number)
+        }
+    }
+
+    public func releaseInterface(_ number: Int) {
+        _ = locked { _claimedInterfaces.remove(number) }
+    }
+
+    public func setAltSetting(interface: Int, altSetting: Int) throws {
+        try locked {
+            try checkOpen()
+            guard _claimedInterfaces.contains(interface),
+                  let settings = activeInterfaces()?[interface],
+                  settings.contains(where: { Int($0.alternateSetting) == altSetting }) else {
+                throw USBError.notFound
+            }
+            _altSettings[interface] = altSetting == 0 ? nil : altSetting
+        }
+    }
+
+    public func clearHalt(endpoint: UInt8) throws {
+        try locked {
+            try checkOpen()
+            halted.remove(endpoint)
+        }
+    }
+
+    public func controlTransfer(_ setup: USBControlSetup, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int {
+        let length = min(Int(setup.length), data.count)
+        let handler = try locked { () -> ((USBControlSetup, Data) throws -> Data?)? in
+            try checkOpen()
+            return _controlHandler
+        }
+        let outData = setup.isDeviceToHost ? Data() : Data(UnsafeRawBufferPointer(rebasing: data[..<length]))
+        guard let response = try handler?(setup, outData) ?? standardResponse(to: setup) else {
+            throw USBError.pipe
+        }
+        if !setup.isDeviceToHost {
+            return length
+        }
+        let count = min(response.count, length)
+        response.prefix(count).withUnsafeBytes { bytes in
+            UnsafeMutableRawBufferPointer(rebasing: data[..<count]).copyMemory(from: bytes)
+        }
+        return count
+    }
+
+    public func bulkTransfer(endpoint: UInt8, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int {
+        try transfer(endpoint: endpoint, data: data)
+    }
+
+    public func interruptTransfer(endpoint: UInt8, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int {
+        try transfer(endpoint: endpoint, data: data)
+    }
+
+    /// Move data through an endpoint using the handlers or the queues.
+    private func transfer(endpoint: UInt8, data: UnsafeMutableRawBufferPointer) throws -> Int {
+        try locked {
+            try checkOpen()
+            if halted.contains(endpoint) {
+                throw USBError.pipe
+            }
+        }
+
+        if endpoint & 0x80 == 0 {
+            let bytes = Data(UnsafeRawBufferPointer(data))
+            if let handler = outHandler {
+                try handler(endpoint, bytes)
+            } else {
+                locked { sent[endpoint, default: []].append(bytes) }
+            }
+            return data.count
+        }
+
+        var response = try inHandler?(endpoint, data.count)
+        if response == nil {
+            response = locked { () -> Data? in
+                guard var queue = pending[endpoint], !queue.isEmpty else {
+                    return nil
+                }
+                let first = queue.removeFirst()
+                pending[endpoint] = queue
+                return first
+            }
+        }
+        guard let bytes = response else {
+            throw USBError.timeout
+        }
+        let count = min(bytes.count, data.count)
+        bytes.prefix(count).withUnsafeBytes { source in
+            UnsafeMutableRawBufferPointer(rebasing: data[..<count]).copyMemory(from: source)
+        }
+        return count
+    }
+
+    /// Answer GET_CONFIGURATION and GET_INTERFACE from the transport's state.
+    /// - Returns: The data stage of the response, or nil if the request is not supported
+    private func standardResponse(to setup: USBControlSetup) -> Data? {
+        locked {
+            switch (setup.requestType, setup.request) {
+            case (0x80, 0x08):
+                return Data([UInt8(_configurationValue)])
+            case (0x81, 0x0A):
+                return Data([UInt8(_altSettings[Int(setup.index)] ?? 0)])
+            default:
+                return nil
+            }
+        }
+    }
+
+    /// The interfaces of the active configuration, or nil if the device is not configured.
+    private func activeInterfaces() -> [[USBInterfaceDescriptor]]? {
+        configurationDescriptors.first(where: { Int($0.value) == _configurationValue })?.interfaces
+    }
+
+    private func checkOpen() throws {
+        if !_isOpen {
+            throw USBError.connectionClosed
+        }
+    }
+
+    private func locked<T>(_ body: () throws -> T) rethrows -> T {
+        lock.lock()
+        defer { lock.unlock() }
+        return try body()
+    }
+}
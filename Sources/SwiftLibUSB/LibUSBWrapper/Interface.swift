@@ -6,7 +6,6 @@
 //
 
 import Foundation
-import Usb
 
 /// A group of endpoints intended to be used together. An ``AltSetting`` determines what functions these endpoints have.
 ///
@@ -14,7 +13,7 @@ import Usb
 /// multiple `Interface`s can be claimed simultaneously.
 public class Interface: Hashable {
     public static func == (lhs: Interface, rhs: Interface) -> Bool {
-        return lhs.interface.rawDevice == rhs.interface.rawDevice && lhs.interface.index == rhs.interface.index
+        return lhs.interface.transport === rhs.interface.transport && lhs.interface.index == rhs.interface.index
     }
     
     /// The alternate settings offered for how to use these endpoints.
@@ -24,7 +23,7 @@ public class Interface: Hashable {
     init(config: ConfigurationRef, index: Int) {
         interface = InterfaceRef(config: config, index: Int32(index))
         altSettings = []
-        for i in 0..<Int(interface.numAltsetting) {
+        for i in 0..<interface.altSettings.count {
             altSettings.append(AltSetting(interface: interface, index: i))
         }
     }
@@ -50,59 +49,46 @@ public class Interface: Hashable {
     
     /// A hash representation of the interface
     public func hash(into hasher: inout Hasher) {
-        interface.rawDevice.hash(into: &hasher)
+        ObjectIdentifier(interface.transport).hash(into: &hasher)
         interface.index.hash(into: &hasher)
     }
 }
 
 /// An internal class for managing lifetimes.
 ///
-/// This exists to make sure the libUSB device and context outlive any interfaces even if the Device and Context are freed.
+/// This exists to make sure the device's transport outlives any interfaces even if the Device and Context are freed.
 internal class InterfaceRef {
     let config: ConfigurationRef
-    let descriptor: UnsafePointer<libusb_interface>
     let index: Int32
     var claimed: Bool
     
-    var numAltsetting: Int32 {
-        get {
-            descriptor.pointee.num_altsetting
-        }
-    }
-    
-    var altsetting: UnsafePointer<libusb_interface_descriptor> {
+    /// The descriptors of the interface's alternate settings
+    var altSettings: [USBInterfaceDescriptor] {
         get {
-            descriptor.pointee.altsetting
+            config.descriptor.interfaces[Int(index)]
         }
     }
     
-    var rawDevice: OpaquePointer {
+    var numAltsetting: Int32 {
         get {
-            config.rawDevice
+            Int32(altSettings.count)
         }
     }
     
-    var rawHandle: OpaquePointer? {
+    var transport: USBTransport {
         get {
-            config.rawHandle
+            config.transport
         }
     }
     
     init(config: ConfigurationRef, index: Int32) {
         self.config = config
         self.index = index
-        descriptor = config.descriptor.pointee.interface + Int(index)
         claimed = false
     }
     
     func claim() throws {
-        guard let handle = config.rawHandle else {
-            throw USBError.connectionClosed
-        }
-        let error = libusb_claim_interface(handle, Int32(index))
-        if error < 0 {
-            throw USBError(rawValue: error) ?? USBError.other
-        }
+        try transport.claimInterface(Int(index))
         claimed = true
     }
     
@@ -111,8 +97,8 @@ internal class InterfaceRef {
     }
     
     deinit {
-        if claimed && config.rawHandle != nil {
-            libusb_release_interface(config.rawHandle, index)
+        if claimed && transport.isOpen {
+            transport.releaseInterface(Int(index))
         }
     }
 }
@@ -0,0 +1,102 @@
+//
+//  InterruptPolling.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// Interrupt in transfers kept submitted by ``Endpoint/startPolling(length:handler:)``.
+///
+/// Polling continues until ``stop()`` is called or a transfer fails, even if nothing else keeps a reference to this
+/// object.
+public protocol USBInterruptPolling: AnyObject {
+    /// Stop polling and cancel the transfers in flight.
+    ///
+    /// Once this returns, the handler is not called again. Calling it from the handler stops polling without waiting.
+    func stop()
+}
+
+/// Polling for transports without asynchronous transfers: a thread that makes one interrupt transfer after another.
+internal final class ThreadInterruptPolling: USBInterruptPolling {
+    /// How long each transfer waits, in milliseconds, so that ``stop()`` is noticed
+    private static let transferTimeout = 100
+
+    private let condition = NSCondition()
+    private var isStopping = false
+    private var isRunning = true
+    private var thread: Thread?
+
+    /// Start polling.
+    /// - Parameters:
+    ///   - transport: The transport to make the transfers through
+    ///   - endpoint: The address of the interrupt in endpoint
+    ///   - length: The most bytes of each report
+    ///   - interval: The time, in seconds, to wait before polling again when the device had nothing to send
+    ///   - handler: Called on the polling thread with each report, or with the error that ended polling
+    init(
+        transport: USBTransport,
+        endpoint: UInt8,
+        length: Int,
+        interval: TimeInterval,
+        handler: @escaping (Result<Data, Swift.Error>) -> Void
+    ) {
+        let thread = Thread {
+            self.poll(transport: transport, endpoint: endpoint, length: length, interval: interval, handler: handler)
+        }
+        thread.name = "SwiftLibUSB.InterruptPolling"
+        self.thread = thread
+        thread.start()
+    }
+
+    func stop() {
+        condition.lock()
+        defer { condition.unlock() }
+        isStopping = true
+        if Thread.current == thread {
+            return
+        }
+        while isRunning {
+            condition.wait()
+        }
+    }
+
+    private var shouldContinue: Bool {
+        condition.lock()
+        defer { condition.unlock() }
+        return !isStopping
+    }
+
+    private func poll(
+        transport: USBTransport,
+        endpoint: UInt8,
+        length: Int,
+        interval: TimeInterval,
+        handler: (Result<Data, Swift.Error>) -> Void
+    ) {
+        var buffer = [UInt8](repeating: 0, count: length)
+        while shouldContinue {
+            do {
+                let count = try buffer.withUnsafeMutableBytes { data in
+                    try transport.interruptTransfer(endpoint: endpoint, data: data, timeout: Self.transferTimeout)
+                }
+                handler(.success(Data(buffer[..<count])))
+            } catch USBError.timeout {
+                // The device had nothing to report
+                Thread.sleep(forTimeInterval: interval)
+            } catch {
+                if shouldContinue {
+                    handler(.failure(error))
+                }
+                break
+            }
+        }
+
+        condition.lock()
+        isRunning = false
+        thread = nil
+        condition.broadcast()
+        condition.unlock()
+    }
+}
@@ -0,0 +1,257 @@
+//
+//  IsochronousStream.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+import Usb
+
+/// A continuous stream of packets from an isochronous in endpoint, started with
+/// ``Endpoint/startIsochronousStream(transfers:packetsPerTransfer:bufferedPackets:)``.
+///
+/// A ring of transfers, each split into many packets, is kept submitted to the device. As each transfer finishes, the
+/// status and data of every packet are copied into a ring buffer and the transfer is submitted again. Packets are read
+/// out of the buffer with ``read(maxPackets:_:)``, which never takes a lock or waits for the transfers, so a reader
+/// that keeps up never causes a dropout.
+///
+/// If the reader falls behind and the buffer fills, new packets are dropped and counted in ``droppedPacketCount``.
+/// Only one thread may read at a time.
+///
+/// ```swift
+/// let stream = try endpoint.startIsochronousStream()
+/// while stream.wait(timeout: 1) {
+///     stream.read { packet in
+///         if packet.error == nil {
+///             samples.append(contentsOf: packet.data)
+///         }
+///     }
+/// }
+/// ```
+public final class IsochronousStream {
+    /// One packet received from the device.
+    public struct Packet {
+        /// The error the packet failed with, or `nil` if it was received. Isochronous packets are not retried, so a
+        /// failed packet is a gap in the stream.
+        public var error: USBError?
+        /// The bytes received, which are only valid until the closure given to ``IsochronousStream/read(maxPackets:_:)``
+        /// returns
+        public var data: UnsafeRawBufferPointer
+    }
+
+    let ring: IsochronousPacketRing
+
+    /// Stops the transfers feeding the ring
+    var stopTransfers: (() -> Void)?
+
+    /// Create the buffer a transport streams into.
+    /// - Parameters:
+    ///   - packetSize: The most bytes in one packet
+    ///   - bufferedPackets: The fewest packets the buffer should hold
+    init(packetSize: Int, bufferedPackets: Int) {
+        ring = IsochronousPacketRing(packetSize: packetSize, minimumCapacity: bufferedPackets)
+    }
+
+    /// The most bytes in one packet, as given by `libusb_get_max_iso_packet_size` for the endpoint.
+    public var packetSize: Int {
+        ring.packetSize
+    }
+
+    /// The most packets that can wait to be read before new ones are dropped.
+    public var capacity: Int {
+        ring.capacity
+    }
+
+    /// The number of packets waiting to be read.
+    public var bufferedPacketCount: Int {
+        ring.count
+    }
+
+    /// The number of packets dropped because the buffer was full.
+    public var droppedPacketCount: Int {
+        ring.droppedCount
+    }
+
+    /// The error that ended the stream, such as ``USBError/noDevice``, or `nil` if it is running or was stopped.
+    public var error: Swift.Error? {
+        ring.failure
+    }
+
+    /// Call `body` with each packet waiting in the buffer, oldest first, removing them from it.
+    /// - Parameters:
+    ///   - maxPackets: The most packets to read
+    ///   - body: Handles one packet. If it throws, the packets before it are removed from the buffer.
+    /// - Returns: The number of packets read
+    @discardableResult
+    public func read(maxPackets: Int = Int.max, _ body: (Packet) throws -> Void) rethrows -> Int {
+        try ring.read(maxPackets: maxPackets, body)
+    }
+
+    /// Wait until packets can be read or the stream ends.
+    /// - Parameter timeout: The most time to wait, in seconds
+    /// - Returns: True if there are packets to read
+    public func wait(timeout: TimeInterval) -> Bool {
+        ring.wait(until: DispatchTime.now() + timeout)
+    }
+
+    /// Cancel the transfers and wait for them to finish. Packets already in the buffer can still be read.
+    public func stop() {
+        stopTransfers?()
+        stopTransfers = nil
+        ring.finish(with: nil)
+    }
+
+    deinit {
+        stopTransfers?()
+    }
+}
+
+/// The buffer between the libUSB event thread writing packets and the thread reading them.
+///
+/// The writer only ever moves ``head`` and the reader only ever moves ``tail``, each publishing its move with a release
+/// store that the other side reads with an acquire load, so neither side waits on the other.
+internal final class IsochronousPacketRing {
+    let packetSize: Int
+    /// A power of two, so positions can be masked into slots
+    let capacity: Int
+    private let mask: Int
+
+    /// The data of each slot, `packetSize` bytes apart
+    private let storage: UnsafeMutableRawPointer
+    private let lengths: UnsafeMutablePointer<Int>
+    private let statuses: UnsafeMutablePointer<Int32>
+
+    /// Positions that only grow. Packets from `tail` up to `head` are waiting to be read. `tail` is on its own cache
+    /// line, so the reader and writer don't slow each other down.
+    private let positions: UnsafeMutableRawPointer
+    private let head: UnsafeMutablePointer<Int>
+    private let tail: UnsafeMutablePointer<Int>
+    /// Written only by the writer
+    private let dropped: UnsafeMutablePointer<Int>
+
+    /// Signalled by the writer after each batch of packets, for readers that want to sleep
+    private let available = DispatchSemaphore(value: 0)
+
+    private let failureLock = NSLock()
+    private var _failure: Swift.Error?
+    private var _isFinished = false
+
+    init(packetSize: Int, minimumCapacity: Int) {
+        var capacity = 1
+        while capacity < minimumCapacity {
+            capacity <<= 1
+        }
+        self.packetSize = packetSize
+        self.capacity = capacity
+        mask = capacity - 1
+
+        storage = UnsafeMutableRawPointer.allocate(byteCount: capacity * packetSize, alignment: 16)
+        lengths = UnsafeMutablePointer<Int>.allocate(capacity: capacity)
+        lengths.initialize(repeating: 0, count: capacity)
+        statuses = UnsafeMutablePointer<Int32>.allocate(capacity: capacity)
+        statuses.initialize(repeating: 0, count: capacity)
+        positions = UnsafeMutableRawPointer.allocate(byteCount: 128, alignment: 64)
+        head = positions.initializeMemory(as: Int.self, repeating: 0, count: 128 / MemoryLayout<Int>.stride)
+        dropped = head + 1
+        tail = (positions + 64).assumingMemoryBound(to: Int.self)
+    }
+
+    /// The number of packets waiting to be read.
+    var count: Int {
+        let end = swiftlibusb_load_acquire(head)
+        return end - swiftlibusb_load_acquire(tail)
+    }
+
+    var droppedCount: Int {
+        swiftlibusb_load_acquire(dropped)
+    }
+
+    var failure: Swift.Error? {
+        failureLock.lock()
+        defer { failureLock.unlock() }
+        return _failure
+    }
+
+    /// True once no more packets will be written.
+    var isFinished: Bool {
+        failureLock.lock()
+        defer { failureLock.unlock() }
+        return _isFinished
+    }
+
+    /// Copy packets in and publish them together. Only called by the writer.
+    /// - Parameters:
+    ///   - count: The number of packets
+    ///   - packet: Gives the error and data of the packet at an index
+    func append(count: Int, _ packet: (Int) -> (error: USBError?, data: UnsafeRawBufferPointer)) {
+        var next = head.pointee
+        let end = swiftlibusb_load_acquire(tail) + capacity
+        var written = 0
+        while written < count && next < end {
+            let (error, data) = packet(written)
+            let slot = next & mask
+            let length = min(data.count, packetSize)
+            if let source = data.baseAddress, length > 0 {
+                (storage + slot * packetSize).copyMemory(from: source, byteCount: length)
+            }
+            lengths[slot] = length
+            statuses[slot] = error?.rawValue ?? 0
+            next += 1
+            written += 1
+        }
+        swiftlibusb_store_release(head, next)
+        if written < count {
+            swiftlibusb_store_release(dropped, dropped.pointee + count - written)
+        }
+        available.signal()
+    }
+
+    /// Hand each waiting packet to `body` and free its slot. Only called by the reader.
+    func read(maxPackets: Int, _ body: (IsochronousStream.Packet) throws -> Void) rethrows -> Int {
+        let start = tail.pointee
+        let count = min(swiftlibusb_load_acquire(head) - start, maxPackets)
+        var done = 0
+        defer {
+            swiftlibusb_store_release(tail, start + done)
+        }
+        while done < count {
+            let slot = (start + done) & mask
+            let status = statuses[slot]
+            let error: USBError? = status == 0 ? nil : USBError(rawValue: status) ?? USBError.other
+            try body(IsochronousStream.Packet(
+                error: error,
+                data: UnsafeRawBufferPointer(start: storage + slot * packetSize, count: lengths[slot])))
+            done += 1
+        }
+        return done
+    }
+
+    /// Sleep until packets are written, the stream ends or `deadline` passes.
+    /// - Returns: True if there are packets to read
+    func wait(until deadline: DispatchTime) -> Bool {
+        while count == 0 && !isFinished {
+            if available.wait(timeout: deadline) == .timedOut {
+                break
+            }
+        }
+        return count > 0
+    }
+
+    /// Record that no more packets will be written, and the error that ended the stream if it failed, and wake the
+    /// reader.
+    func finish(with error: Swift.Error?) {
+        failureLock.lock()
+        _failure = _failure ?? error
+        _isFinished = true
+        failureLock.unlock()
+        available.signal()
+    }
+
+    deinit {
+        storage.deallocate()
+        lengths.deallocate()
+        statuses.deallocate()
+        positions.deallocate()
+    }
+}
@@ -0,0 +1,320 @@
+//
+//  LibUSBTransport.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+import Usb
+
+/// The default ``USBTransport``, which talks to a real device through libUSB.
+///
+/// This keeps the libUSB context alive until every device created from it has been freed.
+internal final class LibUSBTransport: USBTransport {
+    let context: ContextRef
+    let rawDevice: OpaquePointer
+    private(set) var rawHandle: OpaquePointer?
+    private(set) var isOpen: Bool
+    let deviceDescriptor: USBDeviceDescriptor
+    let configurationDescriptors: [USBConfigurationDescriptor]
+
+    /// Transfers reused by ``bulkTransfers(_:timeout:)``, so pipelining does not allocate.
+    private var asyncTransfers: [AsyncTransfer] = []
+
+    /// Open a device and read its descriptors.
+    /// - Parameters:
+    ///   - context: The context the device was listed in
+    ///   - device: The device as libUSB understands it
+    /// - Throws: A ``USBError`` if the device can't be opened or its device descriptor can't be read
+    init(context: ContextRef, device: OpaquePointer) throws {
+        self.context = context
+        rawDevice = device
+
+        var descriptor = libusb_device_descriptor()
+        let error = libusb_get_device_descriptor(device, &descriptor)
+        if error < 0 {
+            throw USBError(rawValue: error) ?? USBError.other
+        }
+        deviceDescriptor = USBDeviceDescriptor(
+            bcdUSB: descriptor.bcdUSB,
+            deviceClass: descriptor.bDeviceClass,
+            deviceSubClass: descriptor.bDeviceSubClass,
+            deviceProtocol: descriptor.bDeviceProtocol,
+            maxPacketSize0: descriptor.bMaxPacketSize0,
+            vendorID: descriptor.idVendor,
+            productID: descriptor.idProduct,
+            bcdDevice: descriptor.bcdDevice,
+            manufacturerIndex: descriptor.iManufacturer,
+            productIndex: descriptor.iProduct,
+            serialNumberIndex: descriptor.iSerialNumber)
+
+        var configurations: [USBConfigurationDescriptor] = []
+        for index in 0..<descriptor.bNumConfigurations {
+            var config: UnsafeMutablePointer<libusb_config_descriptor>? = nil
+            if libusb_get_config_descriptor(device, index, &config) < 0 {
+                continue // Ignore configurations with errors
+            }
+            if let config = config {
+                configurations.append(Self.copy(config.pointee))
+            }
+            libusb_free_config_descriptor(config)
+        }
+        configurationDescriptors = configurations
+
+        rawHandle = nil
+        let openError = libusb_open(device, &rawHandle)
+        if openError < 0 {
+            throw USBError(rawValue: openError) ?? USBError.other
+        }
+        isOpen = rawHandle != nil
+    }
+
+    /// Copy a configuration descriptor out of libUSB's memory.
+    private static func copy(_ config: libusb_config_descriptor) -> USBConfigurationDescriptor {
+        var interfaces: [[USBInterfaceDescriptor]] = []
+        for interfaceIndex in 0..<Int(config.bNumInterfaces) {
+            let interface = config.interface[interfaceIndex]
+            var altSettings: [USBInterfaceDescriptor] = []
+            for altIndex in 0..<Int(interface.num_altsetting) {
+                let alt = interface.altsetting[altIndex]
+                var endpoints: [USBEndpointDescriptor] = []
+                for endpointIndex in 0..<Int(alt.bNumEndpoints) {
+                    let endpoint = alt.endpoint[endpointIndex]
+                    endpoints.append(USBEndpointDescriptor(
+                        address: endpoint.bEndpointAddress,
+                        attributes: endpoint.bmAttributes,
+                        maxPacketSize: endpoint.wMaxPacketSize,
+                        interval: endpoint.bInterval,
+                        refresh: endpoint.bRefresh,
+                        synchAddress: endpoint.bSynchAddress))
+                }
+                altSettings.append(USBInterfaceDescriptor(
+                    interfaceNumber: alt.bInterfaceNumber,
+                    alternateSetting: alt.bAlternateSetting,
+                    interfaceClass: alt.bInterfaceClass,
+                    interfaceSubClass: alt.bInterfaceSubClass,
+                    interfaceProtocol: alt.bInterfaceProtocol,
+                    nameIndex: alt.iInterface,
+                    endpoints: endpoints))
+            }
+            interfaces.append(altSettings)
+        }
+        return USBConfigurationDescriptor(
+            value: config.bConfigurationValue,
+            nameIndex: config.iConfiguration,
+            attributes: config.bmAttributes,
+            maxPower: config.MaxPower,
+            interfaces: interfaces)
+    }
+
+    /// The open handle, or ``USBError/connectionClosed`` if the device was closed.
+    private func handle() throws -> OpaquePointer {
+        guard isOpen, let handle = rawHandle else {
+            throw USBError.connectionClosed
+        }
+        return handle
+    }
+
+    /// Throw the ``USBError`` for a negative libUSB return code.
+    private static func check(_ error: Int32) throws {
+        if error < 0 {
+            throw USBError(rawValue: error) ?? USBError.other
+        }
+    }
+
+    var busNumber: UInt16 {
+        UInt16(libusb_get_bus_number(rawDevice))
+    }
+
+    var deviceAddress: UInt8 {
+        libusb_get_device_address(rawDevice)
+    }
+
+    func stringDescriptor(index: UInt8) -> String? {
+        if index == 0 {
+            return nil
+        }
+        guard let handle = try? handle() else {
+            return nil
+        }
+
+        let size = 256
+        var buffer: [UInt8] = Array(repeating: 0, count: size)
+        let returnValue = libusb_get_string_descriptor_ascii(handle, index, &buffer, Int32(size))
+
+        // If the return value is negative, there was an error. If positive, it's the number of bytes in the string.
+        if returnValue <= 0 {
+            return nil
+        }
+        return String(bytes: buffer[..<Int(returnValue)], encoding: .ascii)
+    }
+
+    func close() {
+        if isOpen {
+            asyncTransfers = []
+            libusb_close(rawHandle)
+            // Interfaces check the handle before releasing themselves, so don't leave a freed one behind
+            rawHandle = nil
+            isOpen = false
+        }
+    }
+
+    func reopen() throws {
+        if !isOpen {
+            try Self.check(libusb_open(rawDevice, &rawHandle))
+            isOpen = rawHandle != nil
+        }
+    }
+
+    func reset() throws {
+        try Self.check(libusb_reset_device(try handle()))
+    }
+
+    func activeConfiguration() throws -> Int {
+        var value: Int32 = 0
+        try Self.check(libusb_get_configuration(try handle(), &value))
+        return Int(value)
+    }
+
+    func setConfiguration(_ value: Int) throws {
+        try Self.check(libusb_set_configuration(try handle(), Int32(value)))
+    }
+
+    func claimInterface(_ number: Int) throws {
+        try Self.check(libusb_claim_interface(try handle(), Int32(number)))
+    }
+
+    func releaseInterface(_ number: Int) {
+        if let handle = try? handle() {
+            libusb_release_interface(handle, Int32(number))
+        }
+    }
+
+    func setAltSetting(interface: Int, altSetting: Int) throws {
+        try Self.check(libusb_set_interface_alt_setting(try handle(), Int32(interface), Int32(altSetting)))
+    }
+
+    func clearHalt(endpoint: UInt8) throws {
+        try Self.check(libusb_clear_halt(try handle(), endpoint))
+    }
+
+    func controlTransfer(_ setup: USBControlSetup, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int {
+        let result = libusb_control_transfer(
+            try handle(),
+            setup.requestType,
+            setup.request,
+            setup.value,
+            setup.index,
+            data.baseAddress?.assumingMemoryBound(to: UInt8.self),
+            setup.length,
+            UInt32(timeout))
+        try Self.check(result)
+        return Int(result)
+    }
+
+    func bulkTransfer(endpoint: UInt8, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int {
+        let handle = try self.handle()
+        guard let base = data.baseAddress else {
+            return 0
+        }
+        var transferred: Int32 = 0
+        try Self.check(libusb_bulk_transfer(
+            handle,
+            endpoint,
+            base.assumingMemoryBound(to: UInt8.self),
+            Int32(data.count),
+            &transferred,
+            UInt32(timeout)))
+        return Int(transferred)
+    }
+
+    func interruptTransfer(endpoint: UInt8, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int {
+        let handle = try self.handle()
+        guard let base = data.baseAddress else {
+            return 0
+        }
+        var transferred: Int32 = 0
+        try Self.check(libusb_interrupt_transfer(
+            handle,
+            endpoint,
+            base.assumingMemoryBound(to: UInt8.self),
+            Int32(data.count),
+            &transferred,
+            UInt32(timeout)))
+        return Int(transferred)
+    }
+
+    /// Submit every transfer before waiting on any of them, using libUSB's asynchronous interface.
+    func bulkTransfers(_ transfers: [USBBulkTransferRequest], timeout: Int) throws -> [Int] {
+        let handle = try self.handle()
+        while asyncTransfers.count < transfers.count {
+            asyncTransfers.append(try AsyncTransfer(context: context.context))
+        }
+        let used = Array(asyncTransfers[..<transfers.count])
+        for (asyncTransfer, request) in zip(used, transfers) {
+            asyncTransfer.prepare(
+                handle: handle,
+                endpoint: request.endpoint,
+                type: .bulk,
+                buffer: request.data,
+                timeout: timeout)
+        }
+        try AsyncTransfer.run(used)
+        return used.map { $0.actualLength }
+    }
+
+    /// Keep asynchronous transfers queued on the endpoint, resubmitting each one as soon as it finishes.
+    func startInterruptPolling(
+        endpoint: UInt8,
+        length: Int,
+        interval: TimeInterval,
+        handler: @escaping (Result<Data, Swift.Error>) -> Void
+    ) throws -> USBInterruptPolling {
+        try AsyncTransferRing(
+            transport: self,
+            handle: try handle(),
+            endpoint: endpoint,
+            type: .interrupt,
+            count: 2,
+            length: length,
+            deliver: { transfer in handler(.success(transfer.receivedData)) },
+            fail: { error in handler(.failure(error)) })
+    }
+
+    /// Keep a ring of isochronous transfers queued on the endpoint, each split into packets of the size libUSB gives for
+    /// the endpoint in the active alternate setting.
+    func startIsochronousStream(
+        endpoint: UInt8,
+        transferCount: Int,
+        packetsPerTransfer: Int,
+        bufferedPackets: Int
+    ) throws -> IsochronousStream {
+        let handle = try self.handle()
+        let packetSize = libusb_get_max_iso_packet_size(rawDevice, endpoint)
+        try Self.check(packetSize)
+
+        let stream = IsochronousStream(packetSize: Int(packetSize), bufferedPackets: bufferedPackets)
+        let ring = stream.ring
+        let transfers = try AsyncTransferRing(
+            transport: self,
+            handle: handle,
+            endpoint: endpoint,
+            type: .isochronous,
+            count: transferCount,
+            length: Int(packetSize) * packetsPerTransfer,
+            isoPackets: packetsPerTransfer,
+            deliver: { transfer in ring.append(count: transfer.isoPacketCount, transfer.isoPacket) },
+            fail: { error in ring.finish(with: error) })
+        stream.stopTransfers = transfers.stop
+        return stream
+    }
+
+    deinit {
+        // Free the transfers while the context is certainly still alive
+        asyncTransfers = []
+        if isOpen {
+            libusb_close(rawHandle)
+        }
+    }
+}
@@ -0,0 +1,361 @@
+//
+//  Trace.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+import Usb
+
+/// Opt-in timing of every transfer and instrument operation, exportable as a Chrome trace for Perfetto.
+///
+/// While tracing is off, each traced call costs one check of a flag. While it is on, each event is appended to a
+/// buffer owned by the calling thread without taking a lock, so threads never wait on each other or on an export to
+/// record.
+///
+/// ```swift
+/// USBTrace.start()
+/// let response = try instrument.query("MEAS:VOLT?")
+/// USBTrace.stop()
+/// try USBTrace.writeChromeTrace(to: URL(fileURLWithPath: "trace.json"))
+/// ```
+///
+/// Open the file at [ui.perfetto.dev](https://ui.perfetto.dev) or `chrome://tracing`. Operations such as a query
+/// contain the USBTMC messages they send, which contain the USB transfers, so time spent in `clearHalt`, waiting on
+/// the device or decoding strings is visible as the gaps between them.
+public enum USBTrace {
+    /// True while events are being recorded.
+    public private(set) static var isEnabled = false
+
+    /// The most events kept for each thread. Later events are dropped and counted in ``droppedEventCount``.
+    ///
+    /// Changes apply from the next ``start()`` or ``reset()``.
+    public static var maxEventsPerThread = 1_000_000
+
+    /// Clear any recorded events and start recording.
+    public static func start() {
+        reset()
+        isEnabled = true
+    }
+
+    /// Stop recording. Recorded events are kept until the next ``start()`` or ``reset()``.
+    public static func stop() {
+        isEnabled = false
+    }
+
+    /// Discard every recorded event.
+    ///
+    /// Every buffer is released once its thread lets go of it, including those of threads that have exited. Threads
+    /// that are still recording start a new buffer with their next event.
+    public static func reset() {
+        registryLock.lock()
+        defer { registryLock.unlock() }
+        buffers.removeAll()
+        swiftlibusb_store_release(generation, generation.pointee + 1)
+    }
+
+    /// The number of events that did not fit in their thread's buffer.
+    public static var droppedEventCount: Int {
+        registryLock.lock()
+        defer { registryLock.unlock() }
+        return buffers.reduce(0) { $0 + $1.droppedCount }
+    }
+
+    /// Every recorded event, ordered by start time.
+    public static var events: [USBTraceEvent] {
+        registryLock.lock()
+        let threads = buffers
+        registryLock.unlock()
+
+        var events: [USBTraceEvent] = []
+        for buffer in threads {
+            events += buffer.snapshot().events.map { USBTraceEvent($0, threadID: buffer.threadID) }
+        }
+        return events.sorted { $0.start < $1.start }
+    }
+
+    /// The recorded events in the Chrome trace event format, which Perfetto and `chrome://tracing` open.
+    public static func chromeTrace() throws -> Data {
+        registryLock.lock()
+        let threads = buffers
+        registryLock.unlock()
+
+        var traceEvents: [[String: Any]] = []
+        for buffer in threads {
+            traceEvents.append([
+                "name": "thread_name",
+                "ph": "M",
+                "pid": 1,
+                "tid": buffer.threadID,
+                "args": ["name": buffer.threadName]
+            ])
+        }
+        for event in events {
+            var args: [String: Any] = ["status": event.status]
+            if let endpoint = event.endpoint {
+                args["endpoint"] = String(format: "0x%02X", endpoint)
+            }
+            if let size = event.size {
+                args["size"] = size
+            }
+            if let tag = event.tag {
+                args["bTag"] = tag
+            }
+            traceEvents.append([
+                "name": event.name,
+                "cat": event.category,
+                "ph": "X",
+                "ts": Double(event.start) / 1000,
+                "dur": Double(event.end - event.start) / 1000,
+                "pid": 1,
+                "tid": event.threadID,
+                "args": args
+            ])
+        }
+        return try JSONSerialization.data(withJSONObject: ["traceEvents": traceEvents, "displayTimeUnit": "ns"])
+    }
+
+    /// Write ``chromeTrace()`` to a file.
+    public static func writeChromeTrace(to url: URL) throws {
+        try chromeTrace().write(to: url)
+    }
+
+    /// Time `body` as one event if tracing is enabled.
+    /// - Parameters:
+    ///   - name: What is being timed
+    ///   - category: The layer doing the work, such as `usb` or `usbtmc`
+    ///   - endpoint: The endpoint address, if the event is a transfer
+    ///   - tag: The USBTMC bTag, if the event is a USBTMC message
+    ///   - size: Gives the number of bytes moved from the value returned by `body`
+    ///   - body: The work to time
+    /// - Returns: The value returned by `body`
+    @inline(__always)
+    static func trace<T>(
+        _ name: StaticString,
+        category: StaticString,
+        endpoint: UInt8? = nil,
+        tag: UInt8? = nil,
+        size: (T) -> Int? = { _ in nil },
+        _ body: () throws -> T
+    ) rethrows -> T {
+        if !isEnabled {
+            return try body()
+        }
+        let start = DispatchTime.now().uptimeNanoseconds
+        do {
+            let result = try body()
+            record(RawEvent(
+                name: name,
+                category: category,
+                start: start,
+                end: DispatchTime.now().uptimeNanoseconds,
+                endpoint: endpoint,
+                size: size(result),
+                tag: tag,
+                error: nil))
+            return result
+        } catch {
+            record(RawEvent(
+                name: name,
+                category: category,
+                start: start,
+                end: DispatchTime.now().uptimeNanoseconds,
+                endpoint: endpoint,
+                size: nil,
+                tag: tag,
+                error: error))
+            throw error
+        }
+    }
+
+    /// An event as recorded, before anything is converted to a string.
+    struct RawEvent {
+        var name: StaticString
+        var category: StaticString
+        var start: UInt64
+        var end: UInt64
+        var endpoint: UInt8?
+        var size: Int?
+        var tag: UInt8?
+        var error: Swift.Error?
+    }
+
+    /// The events of one thread.
+    ///
+    /// Only the owning thread appends, so no lock is needed: events are written into chunks that never move, and the
+    /// count is published afterwards with a release store. Any thread can read the events counted by an acquire load.
+    final class ThreadBuffer {
+        let threadID: Int
+        let threadName: String
+        /// The ``USBTrace/reset()`` this buffer was created after.
+        let generation: Int
+        private let capacity: Int
+        /// Pointers to chunks of `chunkSize` events, allocated by the writer as they are needed
+        private let chunks: UnsafeMutablePointer<UnsafeMutablePointer<RawEvent>?>
+        private let chunkCount: Int
+        /// The number of events written and the number dropped, each only written by the owning thread
+        private let count: UnsafeMutablePointer<Int>
+        private let dropped: UnsafeMutablePointer<Int>
+
+        private static let chunkSize = 1024
+
+        init(threadID: Int, threadName: String, generation: Int, capacity: Int) {
+            self.threadID = threadID
+            self.threadName = threadName
+            self.generation = generation
+            self.capacity = max(capacity, 0)
+            chunkCount = (self.capacity + Self.chunkSize - 1) / Self.chunkSize
+            chunks = UnsafeMutablePointer.allocate(capacity: max(chunkCount, 1))
+            chunks.initialize(repeating: nil, count: max(chunkCount, 1))
+            count = UnsafeMutablePointer.allocate(capacity: 2)
+            count.initialize(repeating: 0, count: 2)
+            dropped = count + 1
+        }
+
+        deinit {
+            let written = count.pointee
+            for chunk in 0..<chunkCount {
+                guard let events = chunks[chunk] else {
+                    break
+                }
+                events.deinitialize(count: min(written - chunk * Self.chunkSize, Self.chunkSize))
+                events.deallocate()
+            }
+            chunks.deallocate()
+            count.deallocate()
+        }
+
+        /// Add an event. Only called by the owning thread.
+        func append(_ event: RawEvent) {
+            let index = count.pointee
+            if index >= capacity {
+                swiftlibusb_store_release(dropped, dropped.pointee + 1)
+                return
+            }
+            let chunk = index / Self.chunkSize
+            if index % Self.chunkSize == 0 {
+                chunks[chunk] = UnsafeMutablePointer.allocate(capacity: Self.chunkSize)
+            }
+            (chunks[chunk]! + index % Self.chunkSize).initialize(to: event)
+            swiftlibusb_store_release(count, index + 1)
+        }
+
+        var droppedCount: Int {
+            swiftlibusb_load_acquire(dropped)
+        }
+
+        /// Copy the events published so far. Called from any thread.
+        func snapshot() -> (events: [RawEvent], dropped: Int) {
+            let written = swiftlibusb_load_acquire(count)
+            var events: [RawEvent] = []
+            events.reserveCapacity(written)
+            var chunk = 0
+            while chunk * Self.chunkSize < written {
+                let start = chunk * Self.chunkSize
+                let buffer = UnsafeBufferPointer(start: chunks[chunk], count: min(written - start, Self.chunkSize))
+                events.append(contentsOf: buffer)
+                chunk += 1
+            }
+            return (events, droppedCount)
+        }
+    }
+
+    /// Every thread's buffer since the last reset, so events outlive the threads that recorded them.
+    private static var buffers: [ThreadBuffer] = []
+    /// The ID given to the next thread to record its first event.
+    private static var nextThreadID = 1
+    private static let registryLock = NSLock()
+
+    /// The number of resets so far, which tells threads whether their buffer is still registered. Only changed
+    /// while holding ``registryLock``.
+    private static let generation: UnsafeMutablePointer<Int> = {
+        let generation = UnsafeMutablePointer<Int>.allocate(capacity: 1)
+        generation.initialize(to: 0)
+        return generation
+    }()
+
+    /// Finds the calling thread's buffer without a lock. The thread holds a reference to it, released when the
+    /// thread exits.
+    private static let bufferKey: pthread_key_t = {
+        var key = pthread_key_t()
+        pthread_key_create(&key) { pointer in
+            let buffer: UnsafeMutableRawPointer? = pointer
+            if let buffer = buffer {
+                Unmanaged<ThreadBuffer>.fromOpaque(buffer).release()
+            }
+        }
+        return key
+    }()
+
+    private static func record(_ event: RawEvent) {
+        let current = swiftlibusb_load_acquire(generation)
+        var previous: ThreadBuffer?
+        if let pointer = pthread_getspecific(bufferKey) {
+            let buffer = Unmanaged<ThreadBuffer>.fromOpaque(pointer).takeUnretainedValue()
+            if buffer.generation == current {
+                buffer.append(event)
+                return
+            }
+            // The buffer was dropped by a reset, and is replaced by a new one for the same thread
+            previous = buffer
+        }
+
+        registryLock.lock()
+        let threadID = previous?.threadID ?? nextThreadID
+        if previous == nil {
+            nextThreadID += 1
+        }
+        let name = Thread.isMainThread ? "main" : (Thread.current.name.flatMap { $0.isEmpty ? nil : $0 } ?? "thread")
+        let buffer = ThreadBuffer(
+            threadID: threadID,
+            threadName: name,
+            generation: generation.pointee,
+            capacity: maxEventsPerThread)
+        buffers.append(buffer)
+        registryLock.unlock()
+
+        pthread_setspecific(bufferKey, Unmanaged.passRetained(buffer).toOpaque())
+        if let previous = previous {
+            Unmanaged.passUnretained(previous).release()
+        }
+        buffer.append(event)
+    }
+}
+
+/// One timed operation recorded by ``USBTrace``.
+public struct USBTraceEvent {
+    /// What was timed, such as `bulk out` or `query`
+    public let name: String
+    /// The layer that did the work: `usb` for transfers and `usbtmc` for instrument operations and messages
+    public let category: String
+    /// When the operation started and ended, in nanoseconds since an arbitrary point
+    public let start: UInt64
+    public let end: UInt64
+    /// The endpoint address of a transfer, with 0 for control transfers
+    public let endpoint: UInt8?
+    /// The number of bytes moved, if known
+    public let size: Int?
+    /// The USBTMC bTag of a message
+    public let tag: UInt8?
+    /// `ok`, or a description of the error that ended the operation
+    public let status: String
+    /// Identifies the thread the operation ran on, in the order threads first recorded an event
+    public let threadID: Int
+
+    init(_ event: USBTrace.RawEvent, threadID: Int) {
+        name = event.name.description
+        category = event.category.description
+        start = event.start
+        end = event.end
+        endpoint = event.endpoint
+        size = event.size
+        tag = event.tag
+        if let error = event.error {
+            status = (error as? USBError).map { "\($0)" } ?? "\(error)"
+        } else {
+            status = "ok"
+        }
+        self.threadID = threadID
+    }
+}
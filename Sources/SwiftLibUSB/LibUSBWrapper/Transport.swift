@@ -0,0 +1,318 @@
+//
+//  Transport.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// The operations a ``Device`` needs from the USB stack underneath it.
+///
+/// Devices found through a ``Context`` use libUSB. Other transports, such as ``InMemoryTransport``, let the classes
+/// above ``Device`` run without real hardware, for example to test or benchmark instrument code.
+///
+/// Endpoint addresses include the direction bit, so `0x81` is endpoint 1 in. Timeouts are in milliseconds, and 0 waits
+/// forever. Failures are reported by throwing a ``USBError``.
+public protocol USBTransport: AnyObject {
+    /// The descriptor of the device.
+    var deviceDescriptor: USBDeviceDescriptor { get }
+
+    /// The descriptors of every configuration of the device.
+    var configurationDescriptors: [USBConfigurationDescriptor] { get }
+
+    /// Read a string descriptor, or return `nil` if the device does not provide it.
+    func stringDescriptor(index: UInt8) -> String?
+
+    /// True if the connection to the device is open.
+    var isOpen: Bool { get }
+
+    /// The number of the bus the device is connected to, as usbmon and `lsusb` number it.
+    var busNumber: UInt16 { get }
+
+    /// The address of the device on its bus.
+    var deviceAddress: UInt8 { get }
+
+    /// Close the connection to the device. This does nothing if it is already closed.
+    func close()
+
+    /// Open the connection to the device again. This does nothing if it is already open.
+    func reopen() throws
+
+    /// Reset the device, restoring its configuration and claimed interfaces afterwards.
+    func reset() throws
+
+    /// The value of the active configuration, or 0 if the device is not configured.
+    func activeConfiguration() throws -> Int
+
+    /// Select a configuration by its value.
+    func setConfiguration(_ value: Int) throws
+
+    /// Claim an interface by its number.
+    func claimInterface(_ number: Int) throws
+
+    /// Release an interface claimed with ``claimInterface(_:)``.
+    func releaseInterface(_ number: Int)
+
+    /// Select an alternate setting of a claimed interface.
+    func setAltSetting(interface: Int, altSetting: Int) throws
+
+    /// Clear a halt on an endpoint.
+    func clearHalt(endpoint: UInt8) throws
+
+    /// Send a control transfer.
+    /// - Parameters:
+    ///   - setup: The setup packet. `setup.length` bytes of `data` are sent or received.
+    ///   - data: The data stage, sent from or received into
+    ///   - timeout: The time, in milliseconds, to wait
+    /// - Returns: The number of bytes sent or received in the data stage
+    func controlTransfer(_ setup: USBControlSetup, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int
+
+    /// Send or receive a bulk transfer, depending on the direction of `endpoint`.
+    /// - Returns: The number of bytes sent or received, which are at the start of `data`
+    func bulkTransfer(endpoint: UInt8, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int
+
+    /// Send or receive an interrupt transfer, depending on the direction of `endpoint`.
+    /// - Returns: The number of bytes sent or received, which are at the start of `data`
+    func interruptTransfer(endpoint: UInt8, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int
+
+    /// Run several bulk transfers in order, letting the device see later transfers before earlier ones finish where the
+    /// transport can.
+    /// - Returns: The number of bytes sent or received by each transfer
+    func bulkTransfers(_ transfers: [USBBulkTransferRequest], timeout: Int) throws -> [Int]
+
+    /// Keep interrupt in transfers submitted on `endpoint` until polling is stopped, so no report the device sends is
+    /// missed between transfers.
+    /// - Parameters:
+    ///   - endpoint: The address of an interrupt in endpoint
+    ///   - length: The most bytes of each report
+    ///   - interval: The time, in seconds, the endpoint asks to be polled at
+    ///   - handler: Called on a background thread with each report in the order they were sent, or once with the
+    ///     error that ended polling
+    /// - Returns: The polling, to be stopped with ``USBInterruptPolling/stop()``
+    func startInterruptPolling(
+        endpoint: UInt8,
+        length: Int,
+        interval: TimeInterval,
+        handler: @escaping (Result<Data, Swift.Error>) -> Void
+    ) throws -> USBInterruptPolling
+
+    /// Keep isochronous in transfers submitted on `endpoint`, copying every packet into the returned stream's buffer
+    /// until it is stopped.
+    /// - Parameters:
+    ///   - endpoint: The address of an isochronous in endpoint of the active alternate setting
+    ///   - transferCount: The number of transfers kept submitted
+    ///   - packetsPerTransfer: The number of packets each transfer is split into
+    ///   - bufferedPackets: The fewest packets the stream's buffer should hold
+    func startIsochronousStream(
+        endpoint: UInt8,
+        transferCount: Int,
+        packetsPerTransfer: Int,
+        bufferedPackets: Int
+    ) throws -> IsochronousStream
+}
+
+extension USBTransport {
+    /// Transports for devices that are not on a real bus report bus 0.
+    public var busNumber: UInt16 {
+        0
+    }
+
+    /// Transports for devices that are not on a real bus report address 0.
+    public var deviceAddress: UInt8 {
+        0
+    }
+
+    /// Run the transfers one after another.
+    public func bulkTransfers(_ transfers: [USBBulkTransferRequest], timeout: Int) throws -> [Int] {
+        try transfers.map { transfer in
+            try bulkTransfer(endpoint: transfer.endpoint, data: transfer.data, timeout: timeout)
+        }
+    }
+
+    /// Make one interrupt transfer after another on a background thread, waiting `interval` whenever the device has
+    /// nothing to send.
+    public func startInterruptPolling(
+        endpoint: UInt8,
+        length: Int,
+        interval: TimeInterval,
+        handler: @escaping (Result<Data, Swift.Error>) -> Void
+    ) throws -> USBInterruptPolling {
+        ThreadInterruptPolling(transport: self, endpoint: endpoint, length: length, interval: interval, handler: handler)
+    }
+
+    /// Isochronous transfers need libUSB, so other transports throw ``USBError/notSupported``.
+    public func startIsochronousStream(
+        endpoint: UInt8,
+        transferCount: Int,
+        packetsPerTransfer: Int,
+        bufferedPackets: Int
+    ) throws -> IsochronousStream {
+        throw USBError.notSupported
+    }
+}
+
+/// One transfer of a sequence given to ``USBTransport/bulkTransfers(_:timeout:)``.
+public struct USBBulkTransferRequest {
+    /// The endpoint address, including the direction bit
+    public var endpoint: UInt8
+    /// The bytes to send, or the memory to receive into
+    public var data: UnsafeMutableRawBufferPointer
+
+    public init(endpoint: UInt8, data: UnsafeMutableRawBufferPointer) {
+        self.endpoint = endpoint
+        self.data = data
+    }
+}
+
+/// The setup packet of a control transfer, as defined in section 9.3 of the USB specification.
+public struct USBControlSetup: Hashable {
+    /// The direction, type and recipient of the request
+    public var requestType: UInt8
+    public var request: UInt8
+    public var value: UInt16
+    public var index: UInt16
+    /// The number of bytes in the data stage
+    public var length: UInt16
+
+    public init(requestType: UInt8, request: UInt8, value: UInt16, index: UInt16, length: UInt16) {
+        self.requestType = requestType
+        self.request = request
+        self.value = value
+        self.index = index
+        self.length = length
+    }
+
+    /// True if the data stage goes from the device to the host.
+    public var isDeviceToHost: Bool {
+        requestType & 0x80 != 0
+    }
+}
+
+/// A device descriptor, as defined in section 9.6.1 of the USB specification.
+public struct USBDeviceDescriptor: Hashable {
+    public var bcdUSB: UInt16
+    public var deviceClass: UInt8
+    public var deviceSubClass: UInt8
+    public var deviceProtocol: UInt8
+    public var maxPacketSize0: UInt8
+    public var vendorID: UInt16
+    public var productID: UInt16
+    public var bcdDevice: UInt16
+    /// String descriptor indexes, or 0 if the device does not provide the string
+    public var manufacturerIndex: UInt8
+    public var productIndex: UInt8
+    public var serialNumberIndex: UInt8
+
+    public init(
+        bcdUSB: UInt16 = 0x0200,
+        deviceClass: UInt8 = 0,
+        deviceSubClass: UInt8 = 0,
+        deviceProtocol: UInt8 = 0,
+        maxPacketSize0: UInt8 = 64,
+        vendorID: UInt16,
+        productID: UInt16,
+        bcdDevice: UInt16 = 0x0100,
+        manufacturerIndex: UInt8 = 0,
+        productIndex: UInt8 = 0,
+        serialNumberIndex: UInt8 = 0
+    ) {
+        self.bcdUSB = bcdUSB
+        self.deviceClass = deviceClass
+        self.deviceSubClass = deviceSubClass
+        self.deviceProtocol = deviceProtocol
+        self.maxPacketSize0 = maxPacketSize0
+        self.vendorID = vendorID
+        self.productID = productID
+        self.bcdDevice = bcdDevice
+        self.manufacturerIndex = manufacturerIndex
+        self.productIndex = productIndex
+        self.serialNumberIndex = serialNumberIndex
+    }
+}
+
+/// A configuration descriptor and everything under it, as defined in section 9.6.3 of the USB specification.
+public struct USBConfigurationDescriptor: Hashable {
+    /// The value used to select this configuration
+    public var value: UInt8
+    /// The string descriptor index of the configuration's name
+    public var nameIndex: UInt8
+    public var attributes: UInt8
+    /// The maximum power draw, in units of 2mA or 8mA depending on the device's speed
+    public var maxPower: UInt8
+    /// The interfaces of the configuration. Each interface is listed as its alternate settings.
+    public var interfaces: [[USBInterfaceDescriptor]]
+
+    public init(
+        value: UInt8 = 1,
+        nameIndex: UInt8 = 0,
+        attributes: UInt8 = 0x80,
+        maxPower: UInt8 = 50,
+        interfaces: [[USBInterfaceDescriptor]]
+    ) {
+        self.value = value
+        self.nameIndex = nameIndex
+        self.attributes = attributes
+        self.maxPower = maxPower
+        self.interfaces = interfaces
+    }
+}
+
+/// An interface descriptor for one alternate setting, as defined in section 9.6.5 of the USB specification.
+public struct USBInterfaceDescriptor: Hashable {
+    public var interfaceNumber: UInt8
+    public var alternateSetting: UInt8
+    public var interfaceClass: UInt8
+    public var interfaceSubClass: UInt8
+    public var interfaceProtocol: UInt8
+    /// The string descriptor index of the setting's name
+    public var nameIndex: UInt8
+    public var endpoints: [USBEndpointDescriptor]
+
+    public init(
+        interfaceNumber: UInt8,
+        alternateSetting: UInt8 = 0,
+        interfaceClass: UInt8,
+        interfaceSubClass: UInt8,
+        interfaceProtocol: UInt8,
+        nameIndex: UInt8 = 0,
+        endpoints: [USBEndpointDescriptor]
+    ) {
+        self.interfaceNumber = interfaceNumber
+        self.alternateSetting = alternateSetting
+        self.interfaceClass = interfaceClass
+        self.interfaceSubClass = interfaceSubClass
+        self.interfaceProtocol = interfaceProtocol
+        self.nameIndex = nameIndex
+        self.endpoints = endpoints
+    }
+}
+
+/// An endpoint descriptor, as defined in section 9.6.6 of the USB specification.
+public struct USBEndpointDescriptor: Hashable {
+    /// The endpoint number, with the direction in the top bit
+    public var address: UInt8
+    /// The transfer type in bits 0 and 1, and isochronous details above them
+    public var attributes: UInt8
+    public var maxPacketSize: UInt16
+    public var interval: UInt8
+    /// Audio class extensions, 0 for other endpoints
+    public var refresh: UInt8
+    public var synchAddress: UInt8
+
+    public init(
+        address: UInt8,
+        attributes: UInt8,
+        maxPacketSize: UInt16 = 512,
+        interval: UInt8 = 0,
+        refresh: UInt8 = 0,
+        synchAddress: UInt8 = 0
+    ) {
+        self.address = address
+        self.attributes = attributes
+        self.maxPacketSize = maxPacketSize
+        self.interval = interval
+        self.refresh = refresh
+        self.synchAddress = synchAddress
+    }
+}
@@ -0,0 +1,401 @@
+//
+//  MetricsExporter.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+#if canImport(Glibc)
+import Glibc
+#elseif canImport(Darwin)
+import Darwin
+#endif
+
+/// Publishes the health of instruments in the Prometheus text exposition format, for scraping into dashboards.
+///
+/// Register each instrument to watch, then either write the metrics to a file periodically, for the node exporter's
+/// textfile collector, or serve them over HTTP on the loopback interface for Prometheus to scrape directly:
+///
+/// ```swift
+/// let exporter = MetricsExporter()
+/// exporter.register(instrument)
+/// try exporter.serve(port: 9464)
+/// ```
+///
+/// Every metric is labelled with the instrument's name. Counters only ever increase, so rates such as queries per
+/// second come from Prometheus, for example `rate(swiftlibusb_queries_total[1m])`. Instruments are held weakly and
+/// disappear from the metrics when they are freed.
+public final class MetricsExporter {
+    private struct Entry {
+        weak var instrument: USBTMCInstrument?
+        let name: String
+    }
+
+    private var entries: [Entry] = []
+    private var timer: DispatchSourceTimer?
+    private var server: MetricsServer?
+    private let queue = DispatchQueue(label: "SwiftLibUSB.MetricsExporter", qos: .utility)
+    private let lock = NSLock()
+
+    public init() {}
+
+    deinit {
+        stop()
+    }
+
+    /// Start publishing an instrument's metrics.
+    /// - Parameters:
+    ///   - instrument: The instrument to watch
+    ///   - name: The value of the `instrument` label. Defaults to the instrument's VISA resource string, as
+    ///     ``USBTMCInstrument/discoverResources()`` lists it.
+    public func register(_ instrument: USBTMCInstrument, name: String? = nil) {
+        let resource = instrument.resource.visaString
+        locked {
+            entries.removeAll { $0.instrument == nil || $0.instrument === instrument }
+            entries.append(Entry(instrument: instrument, name: name ?? resource))
+        }
+    }
+
+    /// Stop publishing an instrument's metrics.
+    public func unregister(_ instrument: USBTMCInstrument) {
+        locked {
+            entries.removeAll { $0.instrument == nil || $0.instrument === instrument }
+        }
+    }
+
+    /// The metrics of every registered instrument, in the Prometheus text format.
+    public func exposition() -> String {
+        let instruments = locked { entries.compactMap { entry in entry.instrument.map { (entry.name, $0) } } }
+        var output = MetricsText()
+
+        // Only the statistics snapshot is read, as the session belongs to the thread using the instrument
+        let samples = instruments.map { entry in
+            (name: entry.0, statistics: entry.1.statistics)
+        }
+        let openCount = samples.filter { $0.statistics.isSessionOpen }.count
+
+        output.family("swiftlibusb_open_handles", type: "gauge", help: "Registered instruments with an open connection")
+        output.sample("swiftlibusb_open_handles", value: openCount)
+
+        output.family("swiftlibusb_session_open", type: "gauge", help: "1 if the instrument's connection is open")
+        for sample in samples {
+            output.sample("swiftlibusb_session_open", ["instrument": sample.name], value: sample.statistics.isSessionOpen ? 1 : 0)
+        }
+
+        output.family("swiftlibusb_reconnects_total", type: "counter", help: "Times the session reconnected")
+        for sample in samples {
+            output.sample("swiftlibusb_reconnects_total", ["instrument": sample.name], value: sample.statistics.reconnects)
+        }
+
+        let operations: [(String, KeyPath<InstrumentStatistics, LatencyHistogram>)] = [
+            ("query", \.query),
+            ("write", \.write),
+            ("read", \.read)
+        ]
+        for (operation, histogram) in operations {
+            let name = "swiftlibusb_\(operation)_duration_seconds"
+            output.family(name, type: "summary", help: "Time taken by each \(operation)")
+            for sample in samples {
+                let latency = sample.statistics[keyPath: histogram]
+                for quantile in [0.5, 0.9, 0.99] {
+                    output.sample(name, ["instrument": sample.name, "quantile": "\(quantile)"],
+                                  value: latency.percentile(quantile * 100))
+                }
+                output.sample(name + "_sum", ["instrument": sample.name], value: Double(latency.totalNanoseconds) / 1e9)
+                output.sample(name + "_count", ["instrument": sample.name], value: latency.count)
+            }
+        }
+
+        output.family("swiftlibusb_queries_total", type: "counter", help: "Queries sent to the device, leaving out answers from the query cache")
+        for sample in samples {
+            output.sample("swiftlibusb_queries_total", ["instrument": sample.name], value: sample.statistics.query.count)
+        }
+
+        let directions: [(String, KeyPath<InstrumentStatistics, EndpointStatistics>)] = [
+            ("in", \.bulkIn),
+            ("out", \.bulkOut)
+        ]
+        output.family("swiftlibusb_transfers_total", type: "counter", help: "Bulk transfers that completed")
+        for sample in samples {
+            for (direction, endpoint) in directions {
+                output.sample("swiftlibusb_transfers_total", ["instrument": sample.name, "direction": direction],
+                              value: sample.statistics[keyPath: endpoint].transfers)
+            }
+        }
+        output.family("swiftlibusb_transfer_bytes_total", type: "counter", help: "Bytes moved by bulk transfers")
+        for sample in samples {
+            for (direction, endpoint) in directions {
+                output.sample("swiftlibusb_transfer_bytes_total", ["instrument": sample.name, "direction": direction],
+                              value: sample.statistics[keyPath: endpoint].bytes)
+            }
+        }
+        output.family("swiftlibusb_transfer_errors_total", type: "counter", help: "Bulk transfers that failed, by USBError case")
+        for sample in samples {
+            for (direction, endpoint) in directions {
+                let statistics = sample.statistics[keyPath: endpoint]
+                for (error, count) in statistics.errorCounts.sorted(by: { "\($0.key)" < "\($1.key)" }) {
+                    output.sample("swiftlibusb_transfer_errors_total",
+                                  ["instrument": sample.name, "direction": direction, "error": "\(error)"],
+                                  value: count)
+                }
+                let untyped = statistics.errors - statistics.errorCounts.values.reduce(0, +)
+                if untyped > 0 {
+                    output.sample("swiftlibusb_transfer_errors_total",
+                                  ["instrument": sample.name, "direction": direction, "error": "unknown"],
+                                  value: untyped)
+                }
+            }
+        }
+        output.family("swiftlibusb_clear_halts_total", type: "counter", help: "Halts cleared on the bulk endpoints")
+        for sample in samples {
+            for (direction, endpoint) in directions {
+                output.sample("swiftlibusb_clear_halts_total", ["instrument": sample.name, "direction": direction],
+                              value: sample.statistics[keyPath: endpoint].clearHalts)
+            }
+        }
+
+        output.family("swiftlibusb_clears_total", type: "counter", help: "USBTMC clears requested")
+        for sample in samples {
+            output.sample("swiftlibusb_clears_total", ["instrument": sample.name], value: sample.statistics.clears)
+        }
+        output.family("swiftlibusb_recoveries_total", type: "counter", help: "Recoveries, by the step that succeeded")
+        let levels: [(String, USBTMCInstrument.RecoveryLevel)] = [
+            ("cleared", .cleared),
+            ("halts_cleared", .haltsCleared),
+            ("reset", .reset),
+            ("reconnected", .reconnected)
+        ]
+        for sample in samples {
+            for (label, level) in levels {
+                output.sample("swiftlibusb_recoveries_total", ["instrument": sample.name, "level": label],
+                              value: sample.statistics.recoveries[level] ?? 0)
+            }
+            output.sample("swiftlibusb_recoveries_total", ["instrument": sample.name, "level": "failed"],
+                          value: sample.statistics.failedRecoveries)
+        }
+        return output.text
+    }
+
+    /// Write the metrics to a file, replacing it atomically so a collector never reads half of it.
+    public func write(to url: URL) throws {
+        try Data(exposition().utf8).write(to: url, options: .atomic)
+    }
+
+    /// Write the metrics to a file now and then every `interval` seconds, until ``stop()``.
+    ///
+    /// Errors writing the file are ignored, so a full disk doesn't stop the instruments. Use ``write(to:)`` to see them.
+    public func startWriting(to url: URL, interval: TimeInterval = 15) {
+        let timer = DispatchSource.makeTimerSource(queue: queue)
+        timer.schedule(deadline: .now(), repeating: interval)
+        timer.setEventHandler { [weak self] in
+            try? self?.write(to: url)
+        }
+        locked {
+            self.timer?.cancel()
+            self.timer = timer
+        }
+        timer.resume()
+    }
+
+    /// Serve the metrics over HTTP on the loopback interface, until ``stop()``.
+    ///
+    /// Any path is answered with the metrics, so Prometheus can scrape the default `/metrics`.
+    /// - Parameter port: The TCP port to listen on, or 0 to pick a free one
+    /// - Returns: The port being listened on
+    /// - Throws: ``MetricsExporter/Error/cannotListen`` if the port can't be listened on
+    @discardableResult
+    public func serve(port: UInt16) throws -> UInt16 {
+        let server = try MetricsServer(port: port) { [weak self] in
+            self?.exposition() ?? ""
+        }
+        locked {
+            self.server?.stop()
+            self.server = server
+        }
+        return server.port
+    }
+
+    /// Stop writing the file and serving HTTP.
+    public func stop() {
+        let (timer, server) = locked { () -> (DispatchSourceTimer?, MetricsServer?) in
+            defer {
+                self.timer = nil
+                self.server = nil
+            }
+            return (self.timer, self.server)
+        }
+        timer?.cancel()
+        server?.stop()
+    }
+
+    private func locked<T>(_ body: () throws -> T) rethrows -> T {
+        lock.lock()
+        defer { lock.unlock() }
+        return try body()
+    }
+}
+
+extension MetricsExporter {
+    /// A problem publishing metrics.
+    public enum Error: Swift.Error {
+        /// The HTTP server could not listen on the requested port, usually because another program is using it.
+        case cannotListen
+    }
+}
+
+extension MetricsExporter.Error {
+    public var localizedDescription: String {
+        switch self {
+        case .cannotListen:
+            return "Could not listen for connections on the requested port"
+        }
+    }
+}
+
+/// Builds the Prometheus text exposition format, version 0.0.4.
+private struct MetricsText {
+    var text = ""
+
+    mutating func family(_ name: String, type: String, help: String) {
+        text += "# HELP \(name) \(help)\n# TYPE \(name) \(type)\n"
+    }
+
+    mutating func sample(_ name: String, _ labels: [String: String] = [:], value: Int) {
+        sample(name, labels, formatted: String(value))
+    }
+
+    mutating func sample(_ name: String, _ labels: [String: String] = [:], value: Double) {
+        sample(name, labels, formatted: value.isFinite ? "\(value)" : (value.isNaN ? "NaN" : value < 0 ? "-Inf" : "+Inf"))
+    }
+
+    private mutating func sample(_ name: String, _ labels: [String: String], formatted value: String) {
+        text += name
+        if !labels.isEmpty {
+            let pairs = labels.sorted { $0.key < $1.key }.map { "\($0.key)=\"\(Self.escape($0.value))\"" }
+            text += "{" + pairs.joined(separator: ",") + "}"
+        }
+        text += " \(value)\n"
+    }
+
+    /// Escape a label value, as the format requires of backslashes, quotes and line feeds.
+    private static func escape(_ value: String) -> String {
+        value
+            .replacingOccurrences(of: "\\", with: "\\\\")
+            .replacingOccurrences(of: "\"", with: "\\\"")
+            .replacingOccurrences(of: "\n", with: "\\n")
+    }
+}
+
+/// A minimal HTTP server on the loopback interface that answers every request with the metrics.
+private final class MetricsServer {
+    let port: UInt16
+    private let listener: Int32
+    private var isStopped = false
+    private let lock = NSLock()
+
+    /// The most time, in seconds, a client may take to send its request or receive the response. Connections are
+    /// answered one at a time, so a client that stalls must not hold up the scrapes after it.
+    private static let connectionTimeout = 2
+
+    init(port requestedPort: UInt16, body: @escaping () -> String) throws {
+        #if os(Linux)
+        let descriptor = socket(AF_INET, Int32(SOCK_STREAM.rawValue), 0)
+        #else
+        let descriptor = socket(AF_INET, SOCK_STREAM, 0)
+        #endif
+        guard descriptor >= 0 else {
+            throw MetricsExporter.Error.cannotListen
+        }
+        var enable: Int32 = 1
+        setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &enable, socklen_t(MemoryLayout<Int32>.size))
+        #if !os(Linux)
+        setsockopt(descriptor, SOL_SOCKET, SO_NOSIGPIPE, &enable, socklen_t(MemoryLayout<Int32>.size))
+        #endif
+
+        var address = sockaddr_in()
+        #if !os(Linux)
+        address.sin_len = UInt8(MemoryLayout<sockaddr_in>.size)
+        #endif
+        address.sin_family = sa_family_t(AF_INET)
+        address.sin_port = requestedPort.bigEndian
+        address.sin_addr.s_addr = UInt32(0x7F00_0001).bigEndian
+        var length = socklen_t(MemoryLayout<sockaddr_in>.size)
+        let isListening = withUnsafeMutablePointer(to: &address) { pointer in
+            pointer.withMemoryRebound(to: sockaddr.self, capacity: 1) { address in
+                bind(descriptor, address, length) == 0
+                    && listen(descriptor, 16) == 0
+                    && getsockname(descriptor, address, &length) == 0
+            }
+        }
+        guard isListening else {
+            close(descriptor)
+            throw MetricsExporter.Error.cannotListen
+        }
+        listener = descriptor
+        port = UInt16(bigEndian: address.sin_port)
+
+        let thread = Thread {
+            MetricsServer.acceptConnections(on: descriptor, body: body)
+        }
+        thread.name = "SwiftLibUSB.MetricsServer"
+        thread.start()
+    }
+
+    /// Stop listening. The accepting thread ends once the socket is shut down.
+    func stop() {
+        lock.lock()
+        defer { lock.unlock() }
+        if !isStopped {
+            isStopped = true
+            shutdown(listener, Int32(SHUT_RDWR))
+            close(listener)
+        }
+    }
+
+    private static func acceptConnections(on listener: Int32, body: () -> String) {
+        while true {
+            let connection = accept(listener, nil, nil)
+            if connection < 0 {
+                if errno == EINTR {
+                    continue
+                }
+                return
+            }
+            var timeout = timeval(tv_sec: connectionTimeout, tv_usec: 0)
+            let timeoutSize = socklen_t(MemoryLayout<timeval>.size)
+            setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, timeoutSize)
+            setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, timeoutSize)
+            respond(on: connection, body: body())
+            close(connection)
+        }
+    }
+
+    /// Read the request, whatever it is, and send the metrics.
+    private static func respond(on connection: Int32, body: String) {
+        var request = [UInt8](repeating: 0, count: 4096)
+        _ = recv(connection, &request, request.count, 0)
+
+        let content = [UInt8](body.utf8)
+        let header = "HTTP/1.1 200 OK\r\n"
+            + "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+            + "Content-Length: \(content.count)\r\n"
+            + "Connection: close\r\n\r\n"
+        let response = [UInt8](header.utf8) + content
+        #if os(Linux)
+        let flags = Int32(MSG_NOSIGNAL)
+        #else
+        let flags: Int32 = 0
+        #endif
+        var sent = 0
+        while sent < response.count {
+            let count = response[sent...].withUnsafeBytes { bytes in
+                send(connection, bytes.baseAddress, bytes.count, flags)
+            }
+            if count <= 0 {
+                return
+            }
+            sent += count
+        }
+    }
+}
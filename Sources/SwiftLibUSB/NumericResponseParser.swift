@@ -0,0 +1,320 @@
+//
+//  NumericResponseParser.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// Parses ASCII numbers, as sent in SCPI responses, straight from the received bytes.
+///
+/// Most responses are NR1, NR2 or NR3 numbers such as `+1.000000E+00`, which have few enough digits to be converted
+/// exactly with one floating point multiplication or division (Clinger's fast path). Anything else falls back to the
+/// standard library's correctly rounded conversion.
+internal enum NumericResponseParser {
+    /// Responses at least this long are split between processor cores.
+    static let parallelThreshold = 256 * 1024
+
+    /// Powers of ten that are exactly representable as a `Double`.
+    private static let exactPowersOfTen: [Double] = [
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    ]
+
+    /// Parse a response holding a single number, ignoring surrounding whitespace and terminators.
+    /// - Throws: ``USBTMCInstrument/Error/invalidNumber`` if the response is not a number
+    static func parseDouble(_ bytes: UnsafeRawBufferPointer) throws -> Double {
+        let field = trimmed(bytes)
+        guard let value = parseField(bytes, from: field.lowerBound, to: field.upperBound) else {
+            throw USBTMCInstrument.Error.invalidNumber
+        }
+        return value
+    }
+
+    /// Parse a response holding a list of numbers, ignoring surrounding whitespace and terminators.
+    /// - Parameters:
+    ///   - bytes: The response
+    ///   - separator: The byte between numbers
+    /// - Returns: The numbers in the response, or an empty array if the response is empty
+    /// - Throws: ``USBTMCInstrument/Error/invalidNumber`` if any field is not a number
+    static func parseDoubles(_ bytes: UnsafeRawBufferPointer, separator: UInt8) throws -> [Double] {
+        let whole = trimmed(bytes)
+        if whole.isEmpty {
+            return []
+        }
+        if whole.count < parallelThreshold {
+            let count = countFields(bytes, in: whole, separator: separator)
+            var values = [Double](repeating: 0, count: count)
+            try values.withUnsafeMutableBufferPointer { output in
+                try parseFields(bytes, in: whole, separator: separator, into: output.baseAddress!)
+            }
+            return values
+        }
+        return try parseDoublesConcurrently(bytes, in: whole, separator: separator)
+    }
+
+    /// Parse a long list by splitting it into pieces at separators and parsing the pieces on all cores.
+    private static func parseDoublesConcurrently(
+        _ bytes: UnsafeRawBufferPointer,
+        in whole: Range<Int>,
+        separator: UInt8
+    ) throws -> [Double] {
+        let pieceCount = max(1, ProcessInfo.processInfo.activeProcessorCount * 4)
+
+        // Each piece after the first starts just after a separator, so no field is split between pieces
+        var boundaries = [whole.lowerBound]
+        for piece in 1..<pieceCount {
+            let guess = max(boundaries[piece - 1], whole.lowerBound + whole.count * piece / pieceCount)
+            boundaries.append(nextFieldStart(bytes, from: guess, to: whole.upperBound, separator: separator))
+        }
+        boundaries.append(whole.upperBound)
+
+        // Count the fields in each piece, then parse each piece into its place in the result
+        var offsets = [Int](repeating: 0, count: pieceCount + 1)
+        offsets.withUnsafeMutableBufferPointer { counts in
+            DispatchQueue.concurrentPerform(iterations: pieceCount) { piece in
+                let range = boundaries[piece]..<boundaries[piece + 1]
+                counts[piece + 1] = range.isEmpty ? 0 : countFields(bytes, in: range, separator: separator)
+            }
+        }
+        for piece in 0..<pieceCount {
+            offsets[piece + 1] += offsets[piece]
+        }
+
+        var values = [Double](repeating: 0, count: offsets[pieceCount])
+        var failed = false
+        let failureLock = NSLock()
+        values.withUnsafeMutableBufferPointer { output in
+            DispatchQueue.concurrentPerform(iterations: pieceCount) { piece in
+                let range = boundaries[piece]..<boundaries[piece + 1]
+                if range.isEmpty {
+                    return
+                }
+                do {
+                    try parseFields(bytes, in: range, separator: separator, into: output.baseAddress! + offsets[piece])
+                } catch {
+                    failureLock.lock()
+                    failed = true
+                    failureLock.unlock()
+                }
+            }
+        }
+        if failed {
+            throw USBTMCInstrument.Error.invalidNumber
+        }
+        return values
+    }
+
+    /// The range of `bytes` without leading and trailing whitespace, which includes line terminators.
+    private static func trimmed(_ bytes: UnsafeRawBufferPointer) -> Range<Int> {
+        var lower = 0
+        var upper = bytes.count
+        while lower < upper && isWhitespace(bytes[lower]) {
+            lower += 1
+        }
+        while upper > lower && isWhitespace(bytes[upper - 1]) {
+            upper -= 1
+        }
+        return lower..<upper
+    }
+
+    private static func isWhitespace(_ byte: UInt8) -> Bool {
+        byte == UInt8(ascii: " ") || byte == UInt8(ascii: "\n") || byte == UInt8(ascii: "\r") || byte == UInt8(ascii: "\t")
+    }
+
+    /// The position just after the next separator at or after `position`, or `end` if there is none.
+    private static func nextFieldStart(_ bytes: UnsafeRawBufferPointer, from position: Int, to end: Int, separator: UInt8) -> Int {
+        guard position < end,
+              let found = memchr(bytes.baseAddress! + position, Int32(separator), end - position) else {
+            return end
+        }
+        return bytes.baseAddress!.distance(to: UnsafeRawPointer(found)) + 1
+    }
+
+    /// The number of fields in `range`. A range ending just after a separator has no empty field at its end.
+    private static func countFields(_ bytes: UnsafeRawBufferPointer, in range: Range<Int>, separator: UInt8) -> Int {
+        var count = 0
+        var position = range.lowerBound
+        while position < range.upperBound {
+            position = nextFieldStart(bytes, from: position, to: range.upperBound, separator: separator)
+            count += 1
+        }
+        return count
+    }
+
+    /// Parse every field in `range` into consecutive elements of `output`.
+    private static func parseFields(
+        _ bytes: UnsafeRawBufferPointer,
+        in range: Range<Int>,
+        separator: UInt8,
+        into output: UnsafeMutablePointer<Double>
+    ) throws {
+        var position = range.lowerBound
+        var index = 0
+        while position < range.upperBound {
+            let next = nextFieldStart(bytes, from: position, to: range.upperBound, separator: separator)
+            let fieldEnd = next < range.upperBound || bytes[next - 1] == separator ? next - 1 : next
+            guard let value = parseField(bytes, from: position, to: fieldEnd) else {
+                throw USBTMCInstrument.Error.invalidNumber
+            }
+            output[index] = value
+            index += 1
+            position = next
+        }
+    }
+
+    /// Parse one number in `bytes[start..<end]`, allowing whitespace around it.
+    private static func parseField(_ bytes: UnsafeRawBufferPointer, from start: Int, to end: Int) -> Double? {
+        var position = start
+        var end = end
+        while position < end && isWhitespace(bytes[position]) {
+            position += 1
+        }
+        while end > position && isWhitespace(bytes[end - 1]) {
+            end -= 1
+        }
+        let fieldStart = position
+
+        var negative = false
+        if position < end && (bytes[position] == UInt8(ascii: "+") || bytes[position] == UInt8(ascii: "-")) {
+            negative = bytes[position] == UInt8(ascii: "-")
+            position += 1
+        }
+
+        // Collect up to 19 significant digits, which always fit in a UInt64
+        var mantissa: UInt64 = 0
+        var digits = 0
+        var exponent = 0
+        var truncated = false
+        var sawDigit = false
+        while position < end, let digit = digitValue(bytes[position]) {
+            sawDigit = true
+            if digits < 19 {
+                mantissa = mantissa * 10 + digit
+                if mantissa != 0 {
+                    digits += 1
+                }
+            } else {
+                exponent += 1
+                truncated = truncated || digit != 0
+            }
+            position += 1
+        }
+        if position < end && bytes[position] == UInt8(ascii: ".") {
+            position += 1
+            while position < end, let digit = digitValue(bytes[position]) {
+                sawDigit = true
+                if digits < 19 {
+                    mantissa = mantissa * 10 + digit
+                    exponent -= 1
+                    if mantissa != 0 {
+                        digits += 1
+                    }
+                } else {
+                    truncated = truncated || digit != 0
+                }
+                position += 1
+            }
+        }
+        if sawDigit && position < end && (bytes[position] == UInt8(ascii: "e") || bytes[position] == UInt8(ascii: "E")) {
+            position += 1
+            var exponentNegative = false
+            if position < end && (bytes[position] == UInt8(ascii: "+") || bytes[position] == UInt8(ascii: "-")) {
+                exponentNegative = bytes[position] == UInt8(ascii: "-")
+                position += 1
+            }
+            var written = 0
+            var sawExponentDigit = false
+            while position < end, let digit = digitValue(bytes[position]) {
+                sawExponentDigit = true
+                if written < 100_000 {
+                    written = written * 10 + Int(digit)
+                }
+                position += 1
+            }
+            if !sawExponentDigit {
+                return nil
+            }
+            exponent += exponentNegative ? -written : written
+        }
+
+        if sawDigit && position == end && !truncated && mantissa <= 1 << 53 &&
+            exponent >= -22 && exponent <= 22 {
+            var value = Double(mantissa)
+            if exponent < 0 {
+                value /= exactPowersOfTen[-exponent]
+            } else {
+                value *= exactPowersOfTen[exponent]
+            }
+            return negative ? -value : value
+        }
+
+        // Long mantissas, large exponents and special values such as INF are rare, so use the slower general conversion
+        if fieldStart == end {
+            return nil
+        }
+        return Double(String(decoding: UnsafeRawBufferPointer(rebasing: bytes[fieldStart..<end]), as: UTF8.self))
+    }
+
+    private static func digitValue(_ byte: UInt8) -> UInt64? {
+        if byte >= UInt8(ascii: "0") && byte <= UInt8(ascii: "9") {
+            return UInt64(byte - UInt8(ascii: "0"))
+        }
+        return nil
+    }
+}
+
+extension USBTMCInstrument {
+    /// Send a query and parse the response as a single number.
+    ///
+    /// The number is parsed directly from the received bytes without building a `String`.
+    /// - Parameters:
+    ///   - string: The query to send, such as `"MEAS:VOLT?"`
+    ///   - chunkSize: The number of bytes to read at a time. Defaults to `attributes.chunkSize`.
+    /// - Returns: The number in the response
+    /// - Throws: ``USBTMCInstrument/Error/invalidNumber`` if the response is not a number, or any error thrown while writing or reading
+    public func queryDouble(_ string: String, chunkSize: Int? = nil) throws -> Double {
+        let response = try queryResponseBytes(string, chunkSize: chunkSize)
+        return try response.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+            try NumericResponseParser.parseDouble(bytes)
+        }
+    }
+
+    /// Send a query and parse the response as a list of numbers.
+    ///
+    /// The numbers are parsed directly from the received bytes without building a `String` for the response or any
+    /// field. Long responses, such as ASCII waveforms, are parsed on all processor cores.
+    /// - Parameters:
+    ///   - string: The query to send, such as `"CURV?"`
+    ///   - separator: The character between numbers. This must be an ASCII character.
+    ///   - chunkSize: The number of bytes to read at a time. Defaults to `attributes.chunkSize`.
+    /// - Returns: The numbers in the response
+    /// - Throws: ``USBTMCInstrument/Error/invalidNumber`` if any field is not a number, or any error thrown while writing or reading
+    public func queryDoubles(_ string: String, separator: Character = ",", chunkSize: Int? = nil) throws -> [Double] {
+        guard let separatorByte = separator.asciiValue else {
+            throw Error.invalidTerminator
+        }
+        let response = try queryResponseBytes(string, chunkSize: chunkSize)
+        return try response.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+            try NumericResponseParser.parseDoubles(bytes, separator: separatorByte)
+        }
+    }
+
+    /// Send a query and read the raw response, without the read terminator.
+    private func queryResponseBytes(_ string: String, chunkSize: Int?) throws -> Data {
+        lock.lock()
+        defer { lock.unlock() }
+
+        guard let terminator = attributes.readTerminator.data(using: attributes.encoding) else {
+            throw Error.invalidTerminator
+        }
+        return try queryBytes(
+            string,
+            appending: attributes.writeTerminator,
+            encoding: attributes.encoding,
+            until: terminator,
+            strippingTerminator: true,
+            chunkSize: chunkSize ?? attributes.chunkSize)
+    }
+}
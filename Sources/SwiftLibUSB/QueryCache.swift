@@ -0,0 +1,140 @@
+//
+//  QueryCache.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// Remembers the responses to queries whose answers don't change while a device stays connected.
+///
+/// Only declared queries are cached. By default these are `*IDN?`, `*OPT?` and `:SYST:VERS?`. Queries are matched
+/// ignoring case, surrounding whitespace and a leading colon, so `SYST:VERS?` and `:syst:vers?` share an entry.
+///
+/// Each ``USBSession`` owns a cache, which is emptied when the session is closed or reconnected.
+public final class QueryCache {
+    /// The queries declared when a cache is created.
+    private static let defaultLifetimes: [String: TimeInterval?] = [
+        "*IDN?": nil,
+        "*OPT?": nil,
+        "SYST:VERS?": nil,
+    ]
+
+    /// The declared queries, and how long each response stays valid. `nil` keeps the response until the cache is emptied.
+    private var lifetimes = QueryCache.defaultLifetimes
+
+    /// The cached responses, and when each one expires.
+    private var entries: [String: (response: Data, expiry: Date?)] = [:]
+
+    private let lock = NSLock()
+
+    init() {}
+
+    /// Allow the response to a query to be cached.
+    /// - Parameters:
+    ///   - query: The query, such as `":SYST:VERS?"`. It must not change the device's state.
+    ///   - timeToLive: The number of seconds a response stays valid, or `nil` to keep it until the session is closed or reconnected
+    public func declare(_ query: String, timeToLive: TimeInterval? = nil) {
+        let key = Self.key(for: query)
+        lock.lock()
+        defer { lock.unlock() }
+        lifetimes[key] = .some(timeToLive)
+        entries[key] = nil
+    }
+
+    /// Stop caching the response to a query.
+    /// - Parameter query: A query previously declared with ``declare(_:timeToLive:)``, or one of the defaults
+    public func undeclare(_ query: String) {
+        let key = Self.key(for: query)
+        lock.lock()
+        defer { lock.unlock() }
+        lifetimes[key] = nil
+        entries[key] = nil
+    }
+
+    /// Forget every cached response. Declared queries stay declared.
+    public func removeAll() {
+        lock.lock()
+        defer { lock.unlock() }
+        entries.removeAll()
+    }
+
+    /// Forget every cached response and go back to declaring only the default queries.
+    func reset() {
+        lock.lock()
+        defer { lock.unlock() }
+        lifetimes = Self.defaultLifetimes
+        entries.removeAll()
+    }
+
+    /// The cached response to `query`, if it is declared and its response has not expired.
+    func response(for query: String) -> Data? {
+        lock.lock()
+        defer { lock.unlock() }
+        guard let key = declaredKey(matching: query), let entry = entries[key] else {
+            return nil
+        }
+        if let expiry = entry.expiry, expiry <= Date() {
+            entries[key] = nil
+            return nil
+        }
+        return entry.response
+    }
+
+    /// Remember the response to `query`, if it is declared.
+    func store(_ response: Data, for query: String) {
+        lock.lock()
+        defer { lock.unlock() }
+        guard let key = declaredKey(matching: query), let lifetime = lifetimes[key] else {
+            return
+        }
+        entries[key] = (response, lifetime.map { Date(timeIntervalSinceNow: $0) })
+    }
+
+    /// The declared key that `query` matches, or nil if it matches none. This must be called holding ``lock``.
+    ///
+    /// Most queries are not declared, so they are compared byte by byte against each key, ignoring ASCII case,
+    /// instead of building their key.
+    private func declaredKey(matching query: String) -> String? {
+        if lifetimes.isEmpty {
+            return nil
+        }
+        var bytes = query.utf8[...]
+        while let first = bytes.first, Self.isWhitespace(first) {
+            bytes = bytes.dropFirst()
+        }
+        while let last = bytes.last, Self.isWhitespace(last) {
+            bytes = bytes.dropLast()
+        }
+        if bytes.first == UInt8(ascii: ":") {
+            bytes = bytes.dropFirst()
+        }
+        let count = bytes.count
+        for key in lifetimes.keys where key.utf8.count == count {
+            let matches = bytes.elementsEqual(key.utf8) { byte, keyByte in
+                // Keys are upper case, so only lower case ASCII letters need to change
+                let upper = byte >= UInt8(ascii: "a") && byte <= UInt8(ascii: "z") ? byte - 0x20 : byte
+                return upper == keyByte
+            }
+            if matches {
+                return key
+            }
+        }
+        return nil
+    }
+
+    /// True for the ASCII whitespace and newline characters trimmed from queries.
+    private static func isWhitespace(_ byte: UInt8) -> Bool {
+        byte == UInt8(ascii: " ") || (byte >= 0x09 && byte <= 0x0D)
+    }
+
+    /// The form of a query used to look it up.
+    private static func key(for query: String) -> String {
+        var key = query.trimmingCharacters(in: .whitespacesAndNewlines).uppercased()
+        if key.hasPrefix(":") {
+            key.removeFirst()
+        }
+        return key
+    }
+}
@@ -0,0 +1,108 @@
+//
+//  ReadAheadBuffer.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// Bytes received from a device that have not yet been returned to the caller.
+///
+/// Devices that don't support a terminator character send whole messages at once, which can hold several terminated
+/// responses. The extra responses are kept here so later reads can be served without another transfer.
+internal struct ReadAheadBuffer {
+    /// The stored bytes. Only the bytes from ``start`` onward are unread.
+    private var bytes: [UInt8] = []
+
+    /// The index of the first unread byte in ``bytes``.
+    private var start = 0
+
+    /// The number of unread bytes.
+    var count: Int {
+        bytes.count - start
+    }
+
+    /// True if there are no unread bytes.
+    var isEmpty: Bool {
+        count == 0
+    }
+
+    /// Add received bytes to the end of the buffer.
+    mutating func append(_ data: Data) {
+        compact()
+        bytes.append(contentsOf: data)
+    }
+
+    /// Add received bytes to the end of the buffer.
+    mutating func append(_ buffer: UnsafeRawBufferPointer) {
+        compact()
+        bytes.append(contentsOf: buffer)
+    }
+
+    /// Remove and return up to `length` unread bytes.
+    mutating func take(_ length: Int) -> Data {
+        let end = start + min(length, count)
+        let taken = Data(bytes[start..<end])
+        start = end
+        if start == bytes.count {
+            removeAll()
+        }
+        return taken
+    }
+
+    /// Remove and return all unread bytes.
+    mutating func takeAll() -> Data {
+        take(count)
+    }
+
+    /// Discard all unread bytes.
+    mutating func removeAll() {
+        bytes.removeAll(keepingCapacity: true)
+        start = 0
+    }
+
+    /// Find the first occurrence of `terminator` in the unread bytes.
+    ///
+    /// Candidate positions are found with `memchr`, which the C library vectorizes, so only positions that start with
+    /// the first byte of the terminator are compared in full.
+    /// - Parameter terminator: The byte sequence to look for. Must not be empty.
+    /// - Returns: The offset of the byte just past the terminator, counted from the first unread byte, or `nil` if the
+    ///   terminator was not found.
+    func endOfFirst(_ terminator: [UInt8]) -> Int? {
+        guard let first = terminator.first else {
+            return nil
+        }
+        return bytes.withUnsafeBufferPointer { buffer -> Int? in
+            guard let base = buffer.baseAddress else {
+                return nil
+            }
+            return terminator.withUnsafeBufferPointer { pattern -> Int? in
+                var position = start
+                while buffer.count - position >= pattern.count {
+                    guard let found = memchr(base + position, Int32(first), buffer.count - position) else {
+                        return nil
+                    }
+                    let index = base.distance(to: found.assumingMemoryBound(to: UInt8.self))
+                    if index + pattern.count > buffer.count {
+                        return nil
+                    }
+                    if pattern.count == 1 ||
+                        memcmp(base + index + 1, pattern.baseAddress! + 1, pattern.count - 1) == 0 {
+                        return index + pattern.count - start
+                    }
+                    position = index + 1
+                }
+                return nil
+            }
+        }
+    }
+
+    /// Drop bytes that have already been read once they make up most of the storage.
+    private mutating func compact() {
+        if start > 0 && start >= bytes.count / 2 {
+            bytes.removeSubrange(0..<start)
+            start = 0
+        }
+    }
+}
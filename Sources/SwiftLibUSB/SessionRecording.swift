@@ -0,0 +1,860 @@
+//
+//  SessionRecording.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// Records every transfer made to a device, with its payload and timing, to a compact binary log that
+/// ``SessionReplay`` can play back without the device.
+///
+/// The recorder wraps a device that has already been found. Connect the instrument to ``device`` instead of the
+/// original, and close the recorder when done:
+///
+/// ```swift
+/// let session = try USBSession(vendorID: 0x2A8D, productID: 0x1602, serialNumber: nil)
+/// let recorder = try SessionRecorder(recording: session.device, to: URL(fileURLWithPath: "dmm.usbrec"))
+/// let instrument = try USBTMCInstrument(device: recorder.device)
+/// // ... run the workload ...
+/// try recorder.close()
+/// ```
+///
+/// The log starts with the device's descriptors and string descriptors, so the replayed device enumerates like the
+/// original. Each transfer is logged with its type, endpoint, setup packet, status, the bytes sent or received, how
+/// long it took and the time since the previous transfer ended.
+public final class SessionRecorder {
+    /// The recorded device. Transfers made through it go to the original device and are logged.
+    public let device: Device
+
+    /// The number of transfers logged so far.
+    public var transferCount: Int {
+        locked { _transferCount }
+    }
+
+    private let file: FileHandle
+    private var encoder = RecordingEncoder()
+    private var _transferCount = 0
+    private var lastEnd: UInt64
+    private var isClosed = false
+    private let queue = DispatchQueue(label: "SwiftLibUSB.SessionRecorder", qos: .utility)
+    private let lock = NSLock()
+
+    /// Logged bytes are handed to the background queue once this many are waiting.
+    private static let writeThreshold = 1 << 20
+
+    /// Start recording transfers made to a device.
+    /// - Parameters:
+    ///   - device: The device to record, which should be open
+    ///   - url: Where to write the log. Any file already there is replaced.
+    /// - Throws: An error if the file can't be created
+    public init(recording device: Device, to url: URL) throws {
+        guard FileManager.default.createFile(atPath: url.path, contents: nil) else {
+            throw CocoaError(.fileWriteUnknown, userInfo: [NSFilePathErrorKey: url.path])
+        }
+        file = try FileHandle(forWritingTo: url)
+        lastEnd = DispatchTime.now().uptimeNanoseconds
+
+        let transport = device.transport
+        var header = RecordingEncoder()
+        header.bytes(SessionReplay.magic)
+        header.u8(SessionReplay.version)
+        header.device(transport.deviceDescriptor)
+        var indexes: Set<UInt8> = [
+            transport.deviceDescriptor.manufacturerIndex,
+            transport.deviceDescriptor.productIndex,
+            transport.deviceDescriptor.serialNumberIndex
+        ]
+        for configuration in transport.configurationDescriptors {
+            indexes.insert(configuration.nameIndex)
+            indexes.formUnion(configuration.interfaces.joined().map { $0.nameIndex })
+        }
+        let strings = indexes.sorted().compactMap { index in
+            transport.stringDescriptor(index: index).map { (index, $0) }
+        }
+        header.varint(UInt64(strings.count))
+        for (index, string) in strings {
+            header.u8(index)
+            header.data(Data(string.utf8))
+        }
+        header.varint(UInt64(transport.configurationDescriptors.count))
+        for configuration in transport.configurationDescriptors {
+            header.configuration(configuration)
+        }
+        encoder = header
+
+        let recordingTransport = RecordingTransport(wrapping: transport)
+        self.device = Device(transport: recordingTransport)
+        recordingTransport.recorder = self
+    }
+
+    /// Write everything logged and close the file. Transfers made after this are not logged.
+    public func close() throws {
+        let remaining = locked { () -> Data? in
+            if isClosed {
+                return nil
+            }
+            isClosed = true
+            return encoder.take()
+        }
+        guard let data = remaining else {
+            return
+        }
+        queue.sync {
+            file.write(data)
+            file.closeFile()
+        }
+    }
+
+    deinit {
+        try? close()
+    }
+
+    /// Log one transfer.
+    /// - Parameters:
+    ///   - type: The transfer type
+    ///   - endpoint: The endpoint address, or 0 for control transfers
+    ///   - setup: The setup packet of a control transfer
+    ///   - requested: The number of bytes the host asked to send or receive
+    ///   - payload: The bytes sent, or the bytes received
+    ///   - error: The error the transfer failed with
+    ///   - start: When the transfer started, from `DispatchTime`
+    ///   - end: When the transfer finished
+    func log(
+        _ type: USBCapture.TransferType,
+        endpoint: UInt8,
+        setup: USBControlSetup?,
+        requested: Int,
+        payload: UnsafeRawBufferPointer,
+        error: Swift.Error?,
+        start: UInt64,
+        end: UInt64
+    ) {
+        let full = locked { () -> Data? in
+            if isClosed {
+                return nil
+            }
+            // Transfers on other threads can overlap, which counts as no gap
+            let gap = start > lastEnd ? start - lastEnd : 0
+            lastEnd = max(lastEnd, end)
+            encoder.u8(type.rawValue)
+            encoder.u8(endpoint)
+            encoder.varint(gap)
+            encoder.varint(end > start ? end - start : 0)
+            encoder.signedVarint(Int64((error as? USBError)?.rawValue ?? (error == nil ? 0 : USBError.other.rawValue)))
+            if let setup = setup {
+                encoder.setup(setup)
+            }
+            encoder.varint(UInt64(requested))
+            encoder.varint(UInt64(payload.count))
+            encoder.bytes(payload)
+            _transferCount += 1
+            return encoder.count >= Self.writeThreshold ? encoder.take() : nil
+        }
+        if let data = full {
+            queue.async { [file] in
+                file.write(data)
+            }
+        }
+    }
+
+    private func locked<T>(_ body: () throws -> T) rethrows -> T {
+        lock.lock()
+        defer { lock.unlock() }
+        return try body()
+    }
+}
+
+/// A ``USBTransport`` that passes everything to another transport and logs each transfer to a ``SessionRecorder``.
+final class RecordingTransport: USBTransport {
+    let base: USBTransport
+    /// The recorder owns this transport's device, so it is held weakly
+    weak var recorder: SessionRecorder?
+
+    init(wrapping base: USBTransport) {
+        self.base = base
+    }
+
+    var deviceDescriptor: USBDeviceDescriptor { base.deviceDescriptor }
+    var configurationDescriptors: [USBConfigurationDescriptor] { base.configurationDescriptors }
+    var isOpen: Bool { base.isOpen }
+    var busNumber: UInt16 { base.busNumber }
+    var deviceAddress: UInt8 { base.deviceAddress }
+
+    func stringDescriptor(index: UInt8) -> String? { base.stringDescriptor(index: index) }
+    func close() { base.close() }
+    func reopen() throws { try base.reopen() }
+    func reset() throws { try base.reset() }
+    func activeConfiguration() throws -> Int { try base.activeConfiguration() }
+    func setConfiguration(_ value: Int) throws { try base.setConfiguration(value) }
+    func claimInterface(_ number: Int) throws { try base.claimInterface(number) }
+    func releaseInterface(_ number: Int) { base.releaseInterface(number) }
+    func setAltSetting(interface: Int, altSetting: Int) throws {
+        try base.setAltSetting(interface: interface, altSetting: altSetting)
+    }
+    func clearHalt(endpoint: UInt8) throws { try base.clearHalt(endpoint: endpoint) }
+
+    func controlTransfer(_ setup: USBControlSetup, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int {
+        let length = min(Int(setup.length), data.count)
+        return try logged(.control, endpoint: 0, setup: setup, data: data, isIn: setup.isDeviceToHost, requested: length) {
+            try base.controlTransfer(setup, data: data, timeout: timeout)
+        }
+    }
+
+    func bulkTransfer(endpoint: UInt8, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int {
+        try logged(.bulk, endpoint: endpoint, setup: nil, data: data, isIn: endpoint & 0x80 != 0, requested: data.count) {
+            try base.bulkTransfer(endpoint: endpoint, data: data, timeout: timeout)
+        }
+    }
+
+    func interruptTransfer(endpoint: UInt8, data: UnsafeMutableRawBufferPointer, timeout: Int) throws -> Int {
+        try logged(.interrupt, endpoint: endpoint, setup: nil, data: data, isIn: endpoint & 0x80 != 0, requested: data.count) {
+            try base.interruptTransfer(endpoint: endpoint, data: data, timeout: timeout)
+        }
+    }
+
+    /// Pass polling on, logging each report as a transfer that started when the previous one ended.
+    func startInterruptPolling(
+        endpoint: UInt8,
+        length: Int,
+        interval: TimeInterval,
+        handler: @escaping (Result<Data, Swift.Error>) -> Void
+    ) throws -> USBInterruptPolling {
+        var start = DispatchTime.now().uptimeNanoseconds
+        return try base.startInterruptPolling(endpoint: endpoint, length: length, interval: interval) { [weak self] result in
+            let end = DispatchTime.now().uptimeNanoseconds
+            switch result {
+            case .success(let report):
+                report.withUnsafeBytes { payload in
+                    self?.recorder?.log(.interrupt, endpoint: endpoint, setup: nil, requested: length,
+                                        payload: payload, error: nil, start: start, end: end)
+                }
+            case .failure(let error):
+                self?.recorder?.log(.interrupt, endpoint: endpoint, setup: nil, requested: length,
+                                    payload: UnsafeRawBufferPointer(start: nil, count: 0), error: error,
+                                    start: start, end: end)
+            }
+            start = end
+            handler(result)
+        }
+    }
+
+    /// Pass the stream on. Isochronous packets are not recorded, as a replay could not deliver them on time.
+    func startIsochronousStream(
+        endpoint: UInt8,
+        transferCount: Int,
+        packetsPerTransfer: Int,
+        bufferedPackets: Int
+    ) throws -> IsochronousStream {
+        try base.startIsochronousStream(
+            endpoint: endpoint,
+            transferCount: transferCount,
+            packetsPerTransfer: packetsPerTransfer,
+            bufferedPackets: bufferedPackets)
+    }
+
+    /// Pass the whole sequence on, so pipelining still happens.
+    ///
+    /// The transfers overlap, so only the time of the whole sequence is known. It is logged once, against the last
+    /// transfer to the host, which is the one the host waits on, and the others are logged as taking no time. A replay
+    /// then waits as long as the device did, instead of once for each transfer.
+    func bulkTransfers(_ transfers: [USBBulkTransferRequest], timeout: Int) throws -> [Int] {
+        let start = DispatchTime.now().uptimeNanoseconds
+        do {
+            let counts = try base.bulkTransfers(transfers, timeout: timeout)
+            let end = DispatchTime.now().uptimeNanoseconds
+            let waitedOn = transfers.lastIndex { $0.endpoint & 0x80 != 0 } ?? transfers.count - 1
+            for (index, (transfer, count)) in zip(transfers, counts).enumerated() {
+                let isIn = transfer.endpoint & 0x80 != 0
+                let payload = UnsafeRawBufferPointer(rebasing: transfer.data[..<(isIn ? count : transfer.data.count)])
+                recorder?.log(.bulk, endpoint: transfer.endpoint, setup: nil, requested: transfer.data.count,
+                              payload: payload, error: nil, start: start, end: index == waitedOn ? end : start)
+            }
+            return counts
+        } catch {
+            // Which transfer failed isn't known, so the failure is logged against the last, which the host waits on
+            if let last = transfers.last {
+                recorder?.log(.bulk, endpoint: last.endpoint, setup: nil, requested: last.data.count,
+                              payload: UnsafeRawBufferPointer(start: nil, count: 0), error: error,
+                              start: start, end: DispatchTime.now().uptimeNanoseconds)
+            }
+            throw error
+        }
+    }
+
+    private func logged(
+        _ type: USBCapture.TransferType,
+        endpoint: UInt8,
+        setup: USBControlSetup?,
+        data: UnsafeMutableRawBufferPointer,
+        isIn: Bool,
+        requested: Int,
+        _ body: () throws -> Int
+    ) throws -> Int {
+        let start = DispatchTime.now().uptimeNanoseconds
+        do {
+            let count = try body()
+            let payload = UnsafeRawBufferPointer(rebasing: data[..<min(isIn ? count : requested, data.count)])
+            recorder?.log(type, endpoint: endpoint, setup: setup, requested: requested, payload: payload,
+                          error: nil, start: start, end: DispatchTime.now().uptimeNanoseconds)
+            return count
+        } catch {
+            recorder?.log(type, endpoint: endpoint, setup: setup, requested: requested,
+                          payload: UnsafeRawBufferPointer(start: nil, count: 0), error: error,
+                          start: start, end: DispatchTime.now().uptimeNanoseconds)
+            throw error
+        }
+    }
+}
+
+/// Plays back a log written by ``SessionRecorder``, answering each transfer with the recorded response.
+///
+/// The replayed device has the recorded descriptors, and its device side is simulated from the log: each transfer
+/// from the host takes the next recorded transfer on the same endpoint, or the next recorded control transfer with
+/// the same request, and gets back the recorded data or error after the recorded time. This lets host code, such as
+/// response parsing or pipelining, be profiled against a real workload without the instrument.
+///
+/// ```swift
+/// let replay = try SessionReplay(contentsOf: URL(fileURLWithPath: "dmm.usbrec"))
+/// replay.timeScale = 0 // as fast as possible
+/// let instrument = try replay.makeInstrument()
+/// ```
+///
+/// Only the device's time is replayed: the time between transfers was spent by the host, and is left to the code
+/// being measured.
+public final class SessionReplay {
+    /// One recorded transfer.
+    public struct Transfer {
+        /// The type of the transfer, as numbered in the endpoint descriptor: 1 for interrupt, 2 for control and 3 for bulk
+        public var type: UInt8
+        /// The endpoint address, or 0 for control transfers
+        public var endpoint: UInt8
+        /// The setup packet of a control transfer
+        public var setup: USBControlSetup?
+        /// The time since the previous transfer ended, in nanoseconds
+        public var gap: UInt64
+        /// How long the transfer took, in nanoseconds
+        public var duration: UInt64
+        /// The error the transfer failed with, or nil if it succeeded
+        public var error: USBError?
+        /// The number of bytes the host asked to send or receive
+        public var requested: Int
+        /// The bytes sent or received
+        public var payload: Data
+
+        /// True if the data went from the device to the host.
+        public var isIn: Bool {
+            setup.map { $0.isDeviceToHost } ?? (endpoint & 0x80 != 0)
+        }
+    }
+
+    /// A problem reading a recording.
+    public enum Error: Swift.Error {
+        /// The file was not written by ``SessionRecorder``.
+        case notARecording
+        /// The file was written by a newer version of the library.
+        case unsupportedVersion
+        /// The file ends part way through a transfer or descriptor.
+        case truncated
+    }
+
+    /// The transport the replayed device is on.
+    public let transport: InMemoryTransport
+
+    /// Every transfer in the recording, in the order they were made.
+    public let transfers: [Transfer]
+
+    /// How much of each recorded transfer's duration to wait before answering. 1 replays the device's recorded timing
+    /// and 0 answers immediately.
+    public var timeScale: Double {
+        get { locked { _timeScale } }
+        set { locked { _timeScale = newValue } }
+    }
+
+    /// If true, the bTag of each recorded USBTMC response is replaced by the bTag of the request the host just sent,
+    /// so host code that numbers its messages differently from the recording is still answered.
+    public var rewritesUSBTMCTags: Bool {
+        get { locked { _rewritesUSBTMCTags } }
+        set { locked { _rewritesUSBTMCTags = newValue } }
+    }
+
+    /// The number of transfers from the host whose data differed from the recording. Replay carries on regardless.
+    public var mismatchCount: Int {
+        locked { _mismatchCount }
+    }
+
+    /// The number of recorded transfers not yet replayed.
+    public var remainingCount: Int {
+        locked { queues.values.reduce(0) { $0 + $1.count } }
+    }
+
+    static let magic = Data("SLUSBREC".utf8)
+    static let version: UInt8 = 1
+
+    private var _timeScale: Double = 1
+    private var _rewritesUSBTMCTags = true
+    private var _mismatchCount = 0
+    /// The transfers not yet replayed, by endpoint address for bulk and interrupt transfers and by request for
+    /// control transfers
+    private var queues: [QueueKey: ArraySlice<Transfer>] = [:]
+    /// The bTag of the last REQUEST_DEV_DEP_MSG_IN sent by the host
+    private var lastRequestTag: UInt8?
+    private let lock = NSLock()
+
+    private enum QueueKey: Hashable {
+        case endpoint(UInt8)
+        case control(requestType: UInt8, request: UInt8, value: UInt16, index: UInt16)
+    }
+
+    /// Read a recording.
+    /// - Parameter url: The file written by ``SessionRecorder``
+    /// - Throws: ``SessionReplay/Error`` if the file is not a complete recording, or an error if it can't be read
+    public convenience init(contentsOf url: URL) throws {
+        try self.init(data: Data(contentsOf: url))
+    }
+
+    /// Read a recording from memory.
+    /// - Parameter data: The contents of a file written by ``SessionRecorder``
+    /// - Throws: ``SessionReplay/Error`` if the data is not a complete recording
+    public init(data: Data) throws {
+        var decoder = RecordingDecoder(data: data)
+        guard try decoder.bytes(Self.magic.count) == Self.magic else {
+            throw Error.notARecording
+        }
+        if try decoder.u8() > Self.version {
+            throw Error.unsupportedVersion
+        }
+        let deviceDescriptor = try decoder.device()
+        var strings: [UInt8: String] = [:]
+        for _ in 0..<(try decoder.count()) {
+            let index = try decoder.u8()
+            strings[index] = String(decoding: try decoder.data(), as: UTF8.self)
+        }
+        var configurations: [USBConfigurationDescriptor] = []
+        for _ in 0..<(try decoder.count()) {
+            configurations.append(try decoder.configuration())
+        }
+
+        var transfers: [Transfer] = []
+        while !decoder.isAtEnd {
+            let type = try decoder.u8()
+            let endpoint = try decoder.u8()
+            let gap = try decoder.varint()
+            let duration = try decoder.varint()
+            let status = try decoder.signedVarint()
+            var setup: USBControlSetup?
+            if type == USBCapture.TransferType.control.rawValue {
+                setup = try decoder.setup()
+            }
+            let requested = try decoder.count()
+            let payload = try decoder.data()
+            transfers.append(Transfer(
+                type: type,
+                endpoint: endpoint,
+                setup: setup,
+                gap: gap,
+                duration: duration,
+                error: status == 0 ? nil : USBError(rawValue: Int32(truncatingIfNeeded: status)) ?? .other,
+                requested: requested,
+                payload: payload))
+        }
+        self.transfers = transfers
+        queues = Self.queues(of: transfers)
+
+        transport = InMemoryTransport(
+            deviceDescriptor: deviceDescriptor,
+            configurationDescriptors: configurations,
+            strings: strings)
+        transport.outHandler = { [weak self] endpoint, data in
+            guard let self = self else {
+                throw USBError.noDevice
+            }
+            try self.receive(data, endpoint: endpoint)
+        }
+        transport.inHandler = { [weak self] endpoint, length in
+            guard let self = self else {
+                throw USBError.noDevice
+            }
+            return try self.send(endpoint: endpoint, maxLength: length)
+        }
+        transport.controlHandler = { [weak self] setup, data in
+            guard let self = self else {
+                throw USBError.noDevice
+            }
+            return try self.control(setup, data: data)
+        }
+    }
+
+    /// Create a ``Device`` for the replayed device.
+    public func makeDevice() -> Device {
+        Device(transport: transport)
+    }
+
+    /// Connect a ``USBTMCInstrument`` to the replayed device.
+    /// - Throws: Any error thrown by ``USBTMCInstrument/init(device:interfaceNumber:)``
+    public func makeInstrument() throws -> USBTMCInstrument {
+        try USBTMCInstrument(device: makeDevice())
+    }
+
+    /// Start the replay again from the first transfer.
+    public func rewind() {
+        locked {
+            queues = Self.queues(of: transfers)
+            lastRequestTag = nil
+            _mismatchCount = 0
+        }
+    }
+
+    private static func queues(of transfers: [Transfer]) -> [QueueKey: ArraySlice<Transfer>] {
+        var queues: [QueueKey: ArraySlice<Transfer>] = [:]
+        for transfer in transfers {
+            queues[key(of: transfer), default: []].append(transfer)
+        }
+        return queues
+    }
+
+    private static func key(of transfer: Transfer) -> QueueKey {
+        guard let setup = transfer.setup else {
+            return .endpoint(transfer.endpoint)
+        }
+        return .control(requestType: setup.requestType, request: setup.request, value: setup.value, index: setup.index)
+    }
+
+    /// Take the next recorded transfer for a key, and how long to wait before completing it.
+    private func next(_ key: QueueKey) -> (transfer: Transfer, delay: TimeInterval)? {
+        locked {
+            guard let transfer = queues[key]?.popFirst() else {
+                return nil
+            }
+            return (transfer, Double(transfer.duration) / 1e9 * _timeScale)
+        }
+    }
+
+    private func wait(_ delay: TimeInterval) {
+        if delay > 0 {
+            Thread.sleep(forTimeInterval: delay)
+        }
+    }
+
+    /// Accept a transfer from the host as the next recorded one on its endpoint.
+    private func receive(_ data: Data, endpoint: UInt8) throws {
+        guard let entry = next(.endpoint(endpoint)) else {
+            throw USBError.timeout
+        }
+        let transfer = entry.transfer
+        wait(entry.delay)
+        locked {
+            if data.count >= 12 && data[data.startIndex] == 2 {
+                // REQUEST_DEV_DEP_MSG_IN, which the next response must echo the bTag of
+                lastRequestTag = data[data.startIndex + 1]
+            }
+            if !Self.matches(data, transfer.payload, ignoringTag: _rewritesUSBTMCTags) {
+                _mismatchCount += 1
+            }
+        }
+        if let error = transfer.error {
+            throw error
+        }
+    }
+
+    /// Answer a transfer to the host with the next recorded one on its endpoint.
+    private func send(endpoint: UInt8, maxLength: Int) throws -> Data? {
+        guard let entry = next(.endpoint(endpoint)) else {
+            return nil
+        }
+        let transfer = entry.transfer
+        wait(entry.delay)
+        if let error = transfer.error {
+            throw error
+        }
+        var payload = transfer.payload
+        locked {
+            if _rewritesUSBTMCTags, let tag = lastRequestTag, payload.count >= 12, payload[payload.startIndex] == 2 {
+                payload[payload.startIndex + 1] = tag
+                payload[payload.startIndex + 2] = ~tag
+            }
+        }
+        return payload.prefix(maxLength)
+    }
+
+    /// Answer a control transfer with the next recorded one with the same request.
+    private func control(_ setup: USBControlSetup, data: Data) throws -> Data? {
+        let key = QueueKey.control(requestType: setup.requestType, request: setup.request, value: setup.value, index: setup.index)
+        guard let entry = next(key) else {
+            // Leave requests that weren't recorded to the transport's standard handling
+            return nil
+        }
+        let transfer = entry.transfer
+        wait(entry.delay)
+        if let error = transfer.error {
+            throw error
+        }
+        if setup.isDeviceToHost {
+            return transfer.payload
+        }
+        if data != transfer.payload {
+            locked { _mismatchCount += 1 }
+        }
+        return Data()
+    }
+
+    /// Compare data sent by the host with the recording, leaving out the bTag of USBTMC headers if asked.
+    private static func matches(_ sent: Data, _ recorded: Data, ignoringTag: Bool) -> Bool {
+        guard ignoringTag && sent.count >= 12 && sent.count == recorded.count else {
+            return sent == recorded
+        }
+        return sent.prefix(1) == recorded.prefix(1) && sent.dropFirst(3) == recorded.dropFirst(3)
+    }
+
+    private func locked<T>(_ body: () throws -> T) rethrows -> T {
+        lock.lock()
+        defer { lock.unlock() }
+        return try body()
+    }
+}
+
+extension SessionReplay.Error {
+    public var localizedDescription: String {
+        switch self {
+        case .notARecording:
+            return "The file is not a session recording"
+        case .unsupportedVersion:
+            return "The recording was made by a newer version of SwiftLibUSB"
+        case .truncated:
+            return "The recording ends part way through a transfer"
+        }
+    }
+}
+
+// MARK: Encoding
+
+/// Writes the little-endian integers, LEB128 variable-length integers and descriptors of a recording.
+struct RecordingEncoder {
+    private var buffer = Data()
+
+    var count: Int {
+        buffer.count
+    }
+
+    /// Return everything encoded so far and start again empty.
+    mutating func take() -> Data {
+        defer { buffer = Data() }
+        return buffer
+    }
+
+    mutating func u8(_ value: UInt8) {
+        buffer.append(value)
+    }
+
+    mutating func u16(_ value: UInt16) {
+        buffer.append(UInt8(truncatingIfNeeded: value))
+        buffer.append(UInt8(truncatingIfNeeded: value >> 8))
+    }
+
+    mutating func varint(_ value: UInt64) {
+        var value = value
+        while value >= 0x80 {
+            buffer.append(UInt8(truncatingIfNeeded: value) | 0x80)
+            value >>= 7
+        }
+        buffer.append(UInt8(value))
+    }
+
+    /// Zigzag encode, so small negative numbers stay small.
+    mutating func signedVarint(_ value: Int64) {
+        varint(UInt64(bitPattern: (value << 1) ^ (value >> 63)))
+    }
+
+    mutating func bytes<Bytes: Sequence>(_ bytes: Bytes) where Bytes.Element == UInt8 {
+        buffer.append(contentsOf: bytes)
+    }
+
+    mutating func data(_ data: Data) {
+        varint(UInt64(data.count))
+        buffer.append(data)
+    }
+
+    mutating func setup(_ setup: USBControlSetup) {
+        u8(setup.requestType)
+        u8(setup.request)
+        u16(setup.value)
+        u16(setup.index)
+        u16(setup.length)
+    }
+
+    mutating func device(_ device: USBDeviceDescriptor) {
+        u16(device.bcdUSB)
+        u8(device.deviceClass)
+        u8(device.deviceSubClass)
+        u8(device.deviceProtocol)
+        u8(device.maxPacketSize0)
+        u16(device.vendorID)
+        u16(device.productID)
+        u16(device.bcdDevice)
+        u8(device.manufacturerIndex)
+        u8(device.productIndex)
+        u8(device.serialNumberIndex)
+    }
+
+    mutating func configuration(_ configuration: USBConfigurationDescriptor) {
+        u8(configuration.value)
+        u8(configuration.nameIndex)
+        u8(configuration.attributes)
+        u8(configuration.maxPower)
+        varint(UInt64(configuration.interfaces.count))
+        for altSettings in configuration.interfaces {
+            varint(UInt64(altSettings.count))
+            for setting in altSettings {
+                u8(setting.interfaceNumber)
+                u8(setting.alternateSetting)
+                u8(setting.interfaceClass)
+                u8(setting.interfaceSubClass)
+                u8(setting.interfaceProtocol)
+                u8(setting.nameIndex)
+                varint(UInt64(setting.endpoints.count))
+                for endpoint in setting.endpoints {
+                    u8(endpoint.address)
+                    u8(endpoint.attributes)
+                    u16(endpoint.maxPacketSize)
+                    u8(endpoint.interval)
+                    u8(endpoint.refresh)
+                    u8(endpoint.synchAddress)
+                }
+            }
+        }
+    }
+}
+
+/// Reads what ``RecordingEncoder`` writes, throwing ``SessionReplay/Error/truncated`` if the data runs out.
+struct RecordingDecoder {
+    private let data: Data
+    private var offset: Int
+
+    init(data: Data) {
+        self.data = data
+        offset = data.startIndex
+    }
+
+    var isAtEnd: Bool {
+        offset >= data.endIndex
+    }
+
+    mutating func u8() throws -> UInt8 {
+        guard offset < data.endIndex else {
+            throw SessionReplay.Error.truncated
+        }
+        defer { offset += 1 }
+        return data[offset]
+    }
+
+    mutating func u16() throws -> UInt16 {
+        let low = try u8()
+        let high = try u8()
+        return UInt16(low) | UInt16(high) << 8
+    }
+
+    mutating func varint() throws -> UInt64 {
+        var value: UInt64 = 0
+        var shift: UInt64 = 0
+        while true {
+            let byte = try u8()
+            if shift < 64 {
+                value |= UInt64(byte & 0x7F) << shift
+            }
+            if byte & 0x80 == 0 {
+                return value
+            }
+            shift += 7
+        }
+    }
+
+    mutating func signedVarint() throws -> Int64 {
+        let value = try varint()
+        return Int64(bitPattern: value >> 1) ^ -Int64(bitPattern: value & 1)
+    }
+
+    /// A length or count, which must fit in what is left of the data.
+    mutating func count() throws -> Int {
+        let value = try varint()
+        guard value <= UInt64(data.count) else {
+            throw SessionReplay.Error.truncated
+        }
+        return Int(value)
+    }
+
+    mutating func bytes(_ count: Int) throws -> Data {
+        guard count <= data.endIndex - offset else {
+            throw SessionReplay.Error.truncated
+        }
+        defer { offset += count }
+        return data[offset..<offset + count]
+    }
+
+    mutating func data() throws -> Data {
+        Data(try bytes(try count()))
+    }
+
+    mutating func setup() throws -> USBControlSetup {
+        USBControlSetup(requestType: try u8(), request: try u8(), value: try u16(), index: try u16(), length: try u16())
+    }
+
+    mutating func device() throws -> USBDeviceDescriptor {
+        USBDeviceDescriptor(
+            bcdUSB: try u16(),
+            deviceClass: try u8(),
+            deviceSubClass: try u8(),
+            deviceProtocol: try u8(),
+            maxPacketSize0: try u8(),
+            vendorID: try u16(),
+            productID: try u16(),
+            bcdDevice: try u16(),
+            manufacturerIndex: try u8(),
+            productIndex: try u8(),
+            serialNumberIndex: try u8())
+    }
+
+    mutating func configuration() throws -> USBConfigurationDescriptor {
+        let value = try u8()
+        let nameIndex = try u8()
+        let attributes = try u8()
+        let maxPower = try u8()
+        var interfaces: [[USBInterfaceDescriptor]] = []
+        for _ in 0..<(try count()) {
+            var altSettings: [USBInterfaceDescriptor] = []
+            for _ in 0..<(try count()) {
+                let number = try u8()
+                let alternateSetting = try u8()
+                let interfaceClass = try u8()
+                let interfaceSubClass = try u8()
+                let interfaceProtocol = try u8()
+                let settingNameIndex = try u8()
+                var endpoints: [USBEndpointDescriptor] = []
+                for _ in 0..<(try count()) {
+                    endpoints.append(USBEndpointDescriptor(
+                        address: try u8(),
+                        attributes: try u8(),
+                        maxPacketSize: try u16(),
+                        interval: try u8(),
+                        refresh: try u8(),
+                        synchAddress: try u8()))
+                }
+                altSettings.append(USBInterfaceDescriptor(
+                    interfaceNumber: number,
+                    alternateSetting: alternateSetting,
+                    interfaceClass: interfaceClass,
+                    interfaceSubClass: interfaceSubClass,
+                    interfaceProtocol: interfaceProtocol,
+                    nameIndex: settingNameIndex,
+                    endpoints: endpoints))
+            }
+            interfaces.append(altSettings)
+        }
+        return USBConfigurationDescriptor(
+            value: value,
+            nameIndex: nameIndex,
+            attributes: attributes,
+            maxPower: maxPower,
+            interfaces: interfaces)
+    }
+}
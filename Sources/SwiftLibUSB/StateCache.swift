@@ -0,0 +1,139 @@
+//
+//  StateCache.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// The last value written to each setting of a device, keyed by SCPI header.
+///
+/// Only simple set commands, a header followed by one parameter such as `:SOUR:VOLT 1.0`, are remembered. As in
+/// section 7.6.1 of IEEE 488.2, the first header of a message starts at the root, and a later header without a leading
+/// colon continues from the node of the header before it, so `:SOUR:VOLT 1;CURR 2` sets `SOUR:VOLT` and `SOUR:CURR`.
+/// Headers are compared as written apart from case, so `:SOUR:VOLT` and `:SOURCE:VOLTAGE` are different entries.
+/// Anything the cache can't follow, such as common commands like `*RST`, forgets every value.
+internal struct SCPIStateCache {
+    /// The value last sent for each normalized header.
+    private var values: [String: String] = [:]
+
+    /// The connection generation of the session the values were sent on.
+    var generation = 0
+
+    /// What a message does to the remembered state.
+    enum Effect {
+        /// The message only sets these headers to these values, and may also contain queries
+        case sets([(header: String, value: String)], hasQueries: Bool)
+        /// The message may change settings in ways the cache can't follow
+        case unknown
+    }
+
+    /// Work out which settings a message changes.
+    /// - Parameter message: The message as sent, without its terminator. It may hold several commands joined with `;`.
+    static func effect(of message: String) -> Effect {
+        var sets: [(header: String, value: String)] = []
+        var hasQueries = false
+        // The nodes a header without a leading colon is relative to
+        var path: [Substring] = []
+        for unit in CommandBatch.split(message) {
+            let command = unit.trimmingCharacters(in: .whitespacesAndNewlines)
+            if command.isEmpty {
+                continue
+            }
+            let headerEnd = command.firstIndex(where: { $0.isWhitespace }) ?? command.endIndex
+            var header = command[..<headerEnd]
+            // Common commands such as *RST and *RCL can change any setting, but don't move the path
+            if header.hasPrefix("*") {
+                if CommandBatch.isQuery(command) {
+                    hasQueries = true
+                    continue
+                }
+                return .unknown
+            }
+
+            var nodes = path
+            if header.hasPrefix(":") {
+                nodes = []
+                header = header.dropFirst()
+            }
+            nodes.append(contentsOf: header.split(separator: ":", omittingEmptySubsequences: false))
+            path = Array(nodes.dropLast())
+
+            if CommandBatch.isQuery(command) {
+                hasQueries = true
+                continue
+            }
+            // Commands without a parameter, such as :INIT, are events rather than settings
+            if headerEnd == command.endIndex {
+                return .unknown
+            }
+            let value = command[headerEnd...].trimmingCharacters(in: .whitespaces)
+            sets.append((nodes.joined(separator: ":").uppercased(), value))
+        }
+        return .sets(sets, hasQueries: hasQueries)
+    }
+
+    /// True if sending a message with this effect would not change anything.
+    func isRedundant(_ effect: Effect) -> Bool {
+        guard case let .sets(sets, hasQueries) = effect, !hasQueries, !sets.isEmpty else {
+            return false
+        }
+        return sets.allSatisfy { values[$0.header] == $0.value }
+    }
+
+    /// Record that a message with this effect was sent.
+    mutating func record(_ effect: Effect) {
+        switch effect {
+        case let .sets(sets, _):
+            for set in sets {
+                values[set.header] = set.value
+            }
+        case .unknown:
+            values.removeAll()
+        }
+    }
+
+    /// Forget every remembered value.
+    mutating func removeAll() {
+        values.removeAll()
+    }
+}
+
+extension USBTMCInstrument {
+    /// Forget every setting remembered by the state cache.
+    ///
+    /// Call this after changing the device's settings by other means, such as its front panel.
+    public func invalidateStateCache() {
+        lock.lock()
+        defer { lock.unlock() }
+        stateCache.removeAll()
+    }
+
+    /// Decide whether a message needs to be sent, before it is written.
+    /// - Parameter message: The message, without its terminator
+    /// - Returns: The effect to record once the message has been sent, and whether it can be skipped
+    func stateCacheCheck(_ message: String) -> (effect: SCPIStateCache.Effect, isRedundant: Bool)? {
+        if !isStateCacheEnabled {
+            return nil
+        }
+        // Values sent before a reconnect may have been lost with the device's power
+        if stateCache.generation != _session.connectionGeneration {
+            stateCache.removeAll()
+            stateCache.generation = _session.connectionGeneration
+        }
+        let effect = SCPIStateCache.effect(of: message)
+        return (effect, stateCache.isRedundant(effect))
+    }
+
+    /// Record the outcome of writing a message checked with ``stateCacheCheck(_:)``.
+    /// - Parameters:
+    ///   - check: The result of ``stateCacheCheck(_:)``
+    ///   - succeeded: False if the write failed, leaving the device's state unknown
+    func stateCacheRecord(_ check: (effect: SCPIStateCache.Effect, isRedundant: Bool)?, succeeded: Bool) {
+        guard let check = check else {
+            return
+        }
+        stateCache.record(succeeded ? check.effect : .unknown)
+    }
+}
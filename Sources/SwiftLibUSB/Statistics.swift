@@ -0,0 +1,149 @@
+//
+//  Statistics.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// A histogram of durations with a fixed relative precision, in the style of HdrHistogram.
+///
+/// Durations are counted in buckets whose width grows with the duration: below 16 ns every nanosecond has its own
+/// bucket, and above that each power of two is split into 8 buckets. Every duration from 1 ns to centuries fits in 496
+/// buckets, recording is a few integer operations, and percentiles are within 6.25% of the true value.
+public struct LatencyHistogram: Hashable {
+    /// Buckets before the first logarithmic one, each one nanosecond wide
+    private static let linearBuckets = 16
+    /// Buckets each power of two is split into
+    private static let subBuckets = 8
+    private static let subBucketBits = 3
+    private static let bucketCount = linearBuckets + (64 - 4) * subBuckets
+
+    private var counts = [UInt64](repeating: 0, count: LatencyHistogram.bucketCount)
+
+    /// The number of durations recorded
+    public private(set) var count = 0
+    /// The sum of every recorded duration, in nanoseconds
+    public private(set) var totalNanoseconds: UInt64 = 0
+    private var minNanoseconds = UInt64.max
+    private var maxNanoseconds: UInt64 = 0
+
+    public init() {}
+
+    /// The shortest recorded duration in seconds, or 0 if nothing has been recorded.
+    public var min: TimeInterval {
+        count == 0 ? 0 : Double(minNanoseconds) / 1e9
+    }
+
+    /// The longest recorded duration in seconds.
+    public var max: TimeInterval {
+        Double(maxNanoseconds) / 1e9
+    }
+
+    /// The mean of the recorded durations in seconds, or 0 if nothing has been recorded.
+    public var mean: TimeInterval {
+        count == 0 ? 0 : Double(totalNanoseconds) / Double(count) / 1e9
+    }
+
+    /// The duration that the given percentage of recorded durations are at or below.
+    /// - Parameter percent: The percentile, from 0 to 100, such as 99 for the 99th percentile
+    /// - Returns: The duration in seconds, or 0 if nothing has been recorded
+    public func percentile(_ percent: Double) -> TimeInterval {
+        if count == 0 {
+            return 0
+        }
+        let rank = Int(Swift.max(1, (Swift.min(percent, 100) / 100 * Double(count)).rounded(.up)))
+        if rank >= count {
+            return max
+        }
+        var seen = 0
+        for (index, bucketCount) in counts.enumerated() where bucketCount > 0 {
+            seen += Int(bucketCount)
+            if seen >= rank {
+                let (lower, width) = Self.range(ofBucket: index)
+                let middle = lower + width / 2
+                return Double(Swift.min(Swift.max(middle, minNanoseconds), maxNanoseconds)) / 1e9
+            }
+        }
+        return max
+    }
+
+    /// Count one duration.
+    public mutating func record(nanoseconds: UInt64) {
+        counts[Self.bucket(of: nanoseconds)] += 1
+        count += 1
+        totalNanoseconds &+= nanoseconds
+        minNanoseconds = Swift.min(minNanoseconds, nanoseconds)
+        maxNanoseconds = Swift.max(maxNanoseconds, nanoseconds)
+    }
+
+    /// Count one duration.
+    /// - Parameter seconds: The duration in seconds. Negative durations count as 0.
+    public mutating func record(_ seconds: TimeInterval) {
+        record(nanoseconds: UInt64(Swift.max(0, seconds * 1e9)))
+    }
+
+    /// Add every duration recorded in another histogram to this one.
+    public mutating func merge(_ other: LatencyHistogram) {
+        for index in counts.indices {
+            counts[index] += other.counts[index]
+        }
+        count += other.count
+        totalNanoseconds &+= other.totalNanoseconds
+        minNanoseconds = Swift.min(minNanoseconds, other.minNanoseconds)
+        maxNanoseconds = Swift.max(maxNanoseconds, other.maxNanoseconds)
+    }
+
+    /// The index of the bucket a duration is counted in.
+    private static func bucket(of value: UInt64) -> Int {
+        if value < UInt64(linearBuckets) {
+            return Int(value)
+        }
+        let exponent = 63 - value.leadingZeroBitCount
+        let subBucket = Int(truncatingIfNeeded: value >> UInt64(exponent - subBucketBits)) & (subBuckets - 1)
+        return linearBuckets + (exponent - 4) * subBuckets + subBucket
+    }
+
+    /// The smallest duration counted in a bucket, and the number of durations it covers.
+    private static func range(ofBucket index: Int) -> (lower: UInt64, width: UInt64) {
+        if index < linearBuckets {
+            return (UInt64(index), 1)
+        }
+        let exponent = (index - linearBuckets) / subBuckets + 4
+        let subBucket = UInt64((index - linearBuckets) % subBuckets)
+        let shift = UInt64(exponent - subBucketBits)
+        return ((UInt64(subBuckets) + subBucket) << shift, 1 << shift)
+    }
+}
+
+/// A snapshot of what an instrument has done since it was created, read with ``USBTMCInstrument/statistics``.
+///
+/// Statistics are always collected, at the cost of reading the clock twice per operation, so that a few slow or failing
+/// instruments can be picked out of many without turning on ``USBTrace``.
+public struct InstrumentStatistics: Hashable {
+    /// How long each query took, from sending the command to receiving the whole response
+    public var query = LatencyHistogram()
+    /// How long each write took
+    public var write = LatencyHistogram()
+    /// How long each read took
+    ///
+    /// Queries that can't be sent as a pipeline are made of a write and a read, which are counted here too.
+    public var read = LatencyHistogram()
+    /// Transfers to the device, including those before the session last reconnected
+    public var bulkOut = EndpointStatistics()
+    /// Transfers from the device, including those before the session last reconnected
+    public var bulkIn = EndpointStatistics()
+    /// Calls to ``USBTMCInstrument/clear(timeout:)``
+    public var clears = 0
+    /// The number of times ``USBTMCInstrument/recover(timeout:)`` succeeded at each level
+    public var recoveries: [USBTMCInstrument.RecoveryLevel: Int] = [:]
+    /// Calls to ``USBTMCInstrument/recover(timeout:)`` that failed at every level
+    public var failedRecoveries = 0
+    /// True if the session's connection was open when it last opened, closed or reconnected
+    public var isSessionOpen = false
+    /// The number of times the session has reconnected
+    public var reconnects = 0
+
+    public init() {}
+}
@@ -36,6 +36,29 @@ public class USBSession {
     /// The lower-level connection to the device.
     public private(set) var device: Device
     
+    /// Counts the times the connection has been closed or reestablished.
+    ///
+    /// Instruments compare this against the value they last saw to notice that anything they remember about the
+    /// device may be out of date.
+    private(set) var connectionGeneration = 0
+    
+    /// The number of times ``reconnect(timeout:)`` has succeeded.
+    public private(set) var reconnectCount = 0
+    
+    /// Responses to queries that don't change while the device stays connected, such as `*IDN?`.
+    ///
+    /// The cache is emptied when the session is closed or reconnected.
+    public let queryCache = QueryCache()
+    
+    /// Called after the session reconnects, so instruments can set up the new connection.
+    var reconnectHandlers: [() throws -> Void] = []
+    
+    /// Called after the session is closed, so instruments can note that the connection is gone.
+    var closeHandlers: [() -> Void] = []
+    
+    /// True if the device was found by listing the devices on the bus, so it can be found again when reconnecting.
+    private let isEnumerated: Bool
+    
     /// Attempt to establish a connection to a device.
     ///
     /// - Parameters:
@@ -53,12 +76,27 @@ public class USBSession {
         self.vendorID = vendorID
         self.productID = productID
         self.serialNumber = serialNumber
+        isEnumerated = true
         try device = Self.rawFindDevice(
             vendorID: vendorID,
             productID: productID,
             serialNumber: serialNumber,
             context: Context())
     }
+    
+    /// Create a session for a device that has already been found.
+    ///
+    /// This is how a session is made for a device on a transport other than libUSB, such as an ``InMemoryTransport``.
+    /// Reconnecting closes and reopens the same device rather than searching for it again.
+    ///
+    /// - Parameter device: The device to communicate with, which should be open
+    public init(device: Device) {
+        vendorID = device.vendorId
+        productID = device.productId
+        serialNumber = device.serialNumber
+        isEnumerated = false
+        self.device = device
+    }
 }
 
 private extension USBSession {
@@ -152,14 +190,53 @@ public extension USBSession.Error {
 extension USBSession: Session {
     /// Closes the session. The instrument owning this session will no longer be able to read or write data.
     public func close() {
+        connectionGeneration += 1
+        queryCache.removeAll()
         device.close()
+        for handler in closeHandlers {
+            handler()
+        }
     }
     
     /// Tries to reestablish the session's connection.
+    ///
+    /// The device is closed and then found again, so this also works after the device has been reset or unplugged
+    /// and plugged back in. Attempts are repeated until one succeeds or the timeout passes.
     /// - Parameters:
     ///  - timeout: The amount of time in milliseconds to attempt to reconnect. A timeout of 0 will try forever
-    /// - Throws: ``USBSession/Error`` if the session cannot be reconnected
+    /// - Throws: ``USBSession/Error`` if the session cannot be reconnected, or the ``USBError`` from the last attempt
     public func reconnect(timeout: TimeInterval) throws {
-        try device.reopen()
+        connectionGeneration += 1
+        queryCache.removeAll()
+        
+        let deadline = timeout > 0 ? Date(timeIntervalSinceNow: timeout / 1000) : nil
+        while true {
+            do {
+                device.close()
+                if isEnumerated {
+                    device = try Self.rawFindDevice(
+                        vendorID: vendorID,
+                        productID: productID,
+                        serialNumber: serialNumber,
+                        context: Context())
+                } else {
+                    try device.reopen()
+                }
+                reconnectCount += 1
+                break
+            } catch {
+                if let deadline = deadline, Date(timeIntervalSinceNow: Self.reconnectInterval) >= deadline {
+                    throw error
+                }
+                Thread.sleep(forTimeInterval: Self.reconnectInterval)
+            }
+        }
+        
+        for handler in reconnectHandlers {
+            try handler()
+        }
     }
+    
+    /// The time, in seconds, to wait between attempts to reconnect.
+    private static let reconnectInterval: TimeInterval = 0.05
 }
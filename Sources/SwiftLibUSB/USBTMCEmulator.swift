@@ -0,0 +1,477 @@
+//
+//  USBTMCEmulator.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// A USBTMC device that runs in the process, for testing and load testing instrument code without hardware.
+///
+/// The emulator implements the device side of the USBTMC specification on an ``InMemoryTransport``:
+/// DEV_DEP_MSG_OUT and REQUEST_DEV_DEP_MSG_IN with bTag checking and TermChar, GET_CAPABILITIES, the abort and clear
+/// requests, and, if ``Options/isUSB488`` is true, the USB488 status byte, remote-local requests and service requests
+/// on an interrupt endpoint.
+///
+/// Each complete message from the host is given to ``responder``. By default a small SCPI model answers: `*IDN?`
+/// returns ``Options/identification``, set commands such as `VOLT 1.0` are remembered, and queries such as `VOLT?`
+/// return the remembered value.
+///
+/// ```swift
+/// let emulator = USBTMCEmulator()
+/// let instrument = try emulator.makeInstrument()
+/// let identity = try instrument.query("*IDN?")
+/// ```
+public final class USBTMCEmulator {
+    /// How the emulated device describes itself and how fast it responds.
+    public struct Options {
+        public var vendorID: UInt16 = 0x1209
+        public var productID: UInt16 = 0x0001
+        public var serialNumber = "EMULATOR"
+        /// The response to `*IDN?` from the default responder
+        public var identification = "SwiftVISA,USBTMC Emulator,EMULATOR,1.0"
+        /// If true, the interface implements the USB488 subclass and has an interrupt in endpoint.
+        public var isUSB488 = true
+        /// If true, the device reports that it can end reads at a TermChar.
+        public var supportsTermChar = true
+        /// The largest packet size of the bulk endpoints.
+        public var maxPacketSize: UInt16 = 512
+        /// The time, in seconds, added to every bulk and interrupt transfer.
+        public var latency: TimeInterval = 0
+        /// The bytes per second the bulk endpoints move, or nil for no limit.
+        public var bandwidth: Double? = nil
+
+        public init() {}
+    }
+
+    /// The transport the emulated device is on.
+    public let transport: InMemoryTransport
+
+    /// The options the device was created with. ``Options/latency`` and ``Options/bandwidth`` can be changed while
+    /// the device is in use.
+    public var options: Options {
+        get { locked { _options } }
+        set { locked { _options = newValue } }
+    }
+
+    /// Called with each complete message from the host. The returned data, if any, is queued as the response message.
+    ///
+    /// If this is nil, the built-in SCPI model answers.
+    public var responder: ((Data) -> Data?)? {
+        get { locked { _responder } }
+        set { locked { _responder = newValue } }
+    }
+
+    /// The status byte returned by USB488 READ_STATUS_BYTE. The message available bit (`0x10`) is added while a
+    /// response is waiting to be read.
+    public var statusByte: UInt8 {
+        get { locked { _statusByte | (output.isEmpty ? 0 : Self.messageAvailableBit) } }
+        set { locked { _statusByte = newValue & ~Self.messageAvailableBit } }
+    }
+
+    /// The number of complete messages received from the host.
+    public var messagesReceived: Int {
+        locked { _messagesReceived }
+    }
+
+    /// The number of USB488 TRIGGER messages received.
+    public var triggerCount: Int {
+        locked { _triggerCount }
+    }
+
+    /// The number of INDICATOR_PULSE requests received.
+    public var indicatorPulseCount: Int {
+        locked { _indicatorPulseCount }
+    }
+
+    /// True after a USB488 REN_CONTROL request enabled remote operation and before GO_TO_LOCAL.
+    public var isRemote: Bool {
+        locked { _isRemote }
+    }
+
+    /// The settings remembered by the built-in SCPI model, by uppercased header.
+    public var settings: [String: String] {
+        get { locked { _settings } }
+        set { locked { _settings = newValue } }
+    }
+
+    private var _options: Options
+    private var _responder: ((Data) -> Data?)?
+    private var _statusByte: UInt8 = 0
+    private var _messagesReceived = 0
+    private var _triggerCount = 0
+    private var _indicatorPulseCount = 0
+    private var _isRemote = false
+    private var _settings: [String: String] = [:]
+
+    /// The bTag of the last bulk out transfer, which INITIATE_ABORT_BULK_OUT refers to.
+    private var lastTag: UInt8 = 0
+    /// The part of a message received so far, waiting for the transfer with end of message set.
+    private var partialMessage = Data()
+    /// Bytes of the current message received before an abort, reported by CHECK_ABORT_BULK_OUT_STATUS.
+    private var abortedOutBytes = 0
+    /// Bytes of the current response sent before an abort, reported by CHECK_ABORT_BULK_IN_STATUS.
+    private var sentInBytes = 0
+    /// Response messages waiting to be read. The first may have been partly sent already.
+    private var output: [Data] = []
+    /// The REQUEST_DEV_DEP_MSG_IN waiting for a bulk in transfer.
+    private var pendingRequest: (tag: UInt8, size: Int, termChar: UInt8?)?
+
+    private let lock = NSLock()
+
+    private static let headerSize = 12
+    private static let interfaceNumber: UInt8 = 0
+    private static let bulkOutAddress: UInt8 = 0x01
+    private static let bulkInAddress: UInt8 = 0x82
+    private static let interruptInAddress: UInt8 = 0x83
+    private static let messageAvailableBit: UInt8 = 0x10
+    private static let statusSuccess: UInt8 = 0x01
+    private static let statusTransferNotInProgress: UInt8 = 0x81
+    private static let statusFailed: UInt8 = 0x80
+
+    /// Create an emulated device, ready to be opened as a ``Device``.
+    /// - Parameter options: How the device describes itself and how fast it responds
+    public init(options: Options = Options()) {
+        _options = options
+
+        var endpoints = [
+            USBEndpointDescriptor(address: Self.bulkOutAddress, attributes: 2, maxPacketSize: options.maxPacketSize),
+            USBEndpointDescriptor(address: Self.bulkInAddress, attributes: 2, maxPacketSize: options.maxPacketSize)
+        ]
+        if options.isUSB488 {
+            endpoints.append(USBEndpointDescriptor(address: Self.interruptInAddress, attributes: 3, maxPacketSize: 2, interval: 1))
+        }
+        let interface = USBInterfaceDescriptor(
+            interfaceNumber: Self.interfaceNumber,
+            interfaceClass: ClassCode.application.rawValue,
+            interfaceSubClass: 0x03,
+            interfaceProtocol: options.isUSB488 ? 1 : 0,
+            endpoints: endpoints)
+        transport = InMemoryTransport(
+            deviceDescriptor: USBDeviceDescriptor(
+                vendorID: options.vendorID,
+                productID: options.productID,
+                manufacturerIndex: 1,
+                productIndex: 2,
+                serialNumberIndex: 3),
+            configurationDescriptors: [USBConfigurationDescriptor(interfaces: [[interface]])],
+            strings: [1: "SwiftVISA", 2: "USBTMC Emulator", 3: options.serialNumber])
+
+        // The transport outlives the emulator if a device is still using it, so the device disappears with the emulator
+        transport.outHandler = { [weak self] endpoint, data in
+            guard let self = self else {
+                throw USBError.noDevice
+            }
+            try self.receive(data, endpoint: endpoint)
+        }
+        transport.inHandler = { [weak self] endpoint, length in
+            guard let self = self else {
+                throw USBError.noDevice
+            }
+            return try self.send(endpoint: endpoint, maxLength: length)
+        }
+        transport.controlHandler = { [weak self] setup, _ in
+            guard let self = self else {
+                throw USBError.noDevice
+            }
+            return self.control(setup)
+        }
+        transport.resetHandler = { [weak self] in
+            guard let self = self else {
+                return
+            }
+            self.locked { self.clearState() }
+        }
+    }
+
+    /// Create a ``Device`` for the emulated device.
+    public func makeDevice() -> Device {
+        Device(transport: transport)
+    }
+
+    /// Connect a ``USBTMCInstrument`` to the emulated device.
+    /// - Throws: Any error thrown by ``USBTMCInstrument/init(device:interfaceNumber:)``
+    public func makeInstrument() throws -> USBTMCInstrument {
+        try USBTMCInstrument(device: makeDevice())
+    }
+
+    /// Send a USB488 SRQ notification on the interrupt endpoint, with the request service bit set in the status byte.
+    public func requestService() {
+        let status = statusByte | 0x40
+        transport.enqueue(Data([0x81, status]), endpoint: Self.interruptInAddress)
+    }
+
+    // MARK: Bulk transfers
+
+    /// Handle a bulk out transfer, as described in section 3.2 of the USBTMC specifications.
+    private func receive(_ data: Data, endpoint: UInt8) throws {
+        wait(forBytes: data.count)
+        let bytes = [UInt8](data)
+        let message = try locked { () -> Data? in
+            guard endpoint == Self.bulkOutAddress, bytes.count >= Self.headerSize,
+                  bytes[1] != 0, bytes[1] == ~bytes[2] else {
+                // Halting the endpoint is the specified response to a bad header
+                transport.halt(endpoint: endpoint)
+                throw USBError.pipe
+            }
+            lastTag = bytes[1]
+            let size = Int(UInt32(bytes[4]) | UInt32(bytes[5]) << 8 | UInt32(bytes[6]) << 16 | UInt32(bytes[7]) << 24)
+
+            switch bytes[0] {
+            case 1: // DEV_DEP_MSG_OUT
+                let end = min(bytes.count, Self.headerSize + size)
+                partialMessage.append(contentsOf: bytes[Self.headerSize..<end])
+                if bytes[8] & 1 == 0 {
+                    return nil
+                }
+                let message = partialMessage
+                partialMessage = Data()
+                _messagesReceived += 1
+                return message
+            case 2: // REQUEST_DEV_DEP_MSG_IN
+                pendingRequest = (bytes[1], size, bytes[8] & 2 != 0 ? bytes[9] : nil)
+                return nil
+            case 128 where _options.isUSB488: // TRIGGER
+                _triggerCount += 1
+                return nil
+            default:
+                transport.halt(endpoint: endpoint)
+                throw USBError.pipe
+            }
+        }
+
+        guard let complete = message else {
+            return
+        }
+        let responder = self.responder
+        let response = responder.map { $0(complete) } ?? respond(to: complete)
+        if let response = response {
+            locked { output.append(response) }
+        }
+    }
+
+    /// Handle a bulk or interrupt in transfer, as described in section 3.3 of the USBTMC specifications.
+    private func send(endpoint: UInt8, maxLength: Int) throws -> Data? {
+        if endpoint == Self.interruptInAddress {
+            // Queued notifications are returned by the transport
+            return nil
+        }
+        let response = try locked { () -> Data in
+            guard let request = pendingRequest, let message = output.first else {
+                // A real device NAKs until it has something to send
+                throw USBError.timeout
+            }
+
+            var count = min(message.count, request.size, max(maxLength - Self.headerSize, 0))
+            var endedAtTermChar = false
+            if let termChar = request.termChar, _options.supportsTermChar,
+               let index = message.prefix(count).firstIndex(of: termChar) {
+                count = index - message.startIndex + 1
+                endedAtTermChar = true
+            }
+            let endOfMessage = count == message.count
+
+            var transfer = Data([2, request.tag, ~request.tag, 0])
+            withUnsafeBytes(of: UInt32(count).littleEndian) { transfer.append(contentsOf: $0) }
+            transfer.append(contentsOf: [(endOfMessage ? 1 : 0) | (endedAtTermChar ? 2 : 0), 0, 0, 0])
+            transfer.append(message.prefix(count))
+            transfer.append(Data(count: (4 - count % 4) % 4))
+
+            pendingRequest = nil
+            if endOfMessage {
+                output.removeFirst()
+                sentInBytes = 0
+            } else {
+                output[0] = message.dropFirst(count)
+                sentInBytes += count
+            }
+            return transfer
+        }
+        wait(forBytes: response.count)
+        return response
+    }
+
+    /// Sleep for the configured latency and the time the bandwidth needs to move `count` bytes.
+    private func wait(forBytes count: Int) {
+        let options = self.options
+        var delay = options.latency
+        if let bandwidth = options.bandwidth, bandwidth > 0 {
+            delay += Double(count) / bandwidth
+        }
+        if delay > 0 {
+            Thread.sleep(forTimeInterval: delay)
+        }
+    }
+
+    // MARK: Control transfers
+
+    /// Answer USBTMC and USB488 class requests, as described in section 4.2 of each specification.
+    /// - Returns: The data stage, or nil to stall or to leave standard requests to the transport
+    private func control(_ setup: USBControlSetup) -> Data? {
+        // Only class requests are handled here
+        if setup.requestType & 0x60 != 0x20 {
+            return nil
+        }
+        // Abort requests go to the endpoint being aborted, and the others to the interface, as in table 15. A request
+        // anywhere else stalls.
+        switch setup.request {
+        case 1, 2:
+            if setup.requestType != 0xA2 || setup.index != UInt16(Self.bulkOutAddress) {
+                return nil
+            }
+        case 3, 4:
+            if setup.requestType != 0xA2 || setup.index != UInt16(Self.bulkInAddress) {
+                return nil
+            }
+        default:
+            if setup.requestType != 0xA1 || setup.index != UInt16(Self.interfaceNumber) {
+                return nil
+            }
+        }
+        let tag = UInt8(truncatingIfNeeded: setup.value)
+        return locked { () -> Data? in
+            switch setup.request {
+            case 1: // INITIATE_ABORT_BULK_OUT
+                if partialMessage.isEmpty && tag != lastTag {
+                    return Data([Self.statusTransferNotInProgress, tag])
+                }
+                abortedOutBytes = partialMessage.count
+                partialMessage = Data()
+                return Data([Self.statusSuccess, tag])
+            case 2: // CHECK_ABORT_BULK_OUT_STATUS
+                return Data([Self.statusSuccess, 0, 0, 0]) + Self.littleEndian(abortedOutBytes)
+            case 3: // INITIATE_ABORT_BULK_IN
+                if pendingRequest == nil && output.isEmpty {
+                    return Data([Self.statusTransferNotInProgress, tag])
+                }
+                pendingRequest = nil
+                if !output.isEmpty {
+                    output.removeFirst()
+                }
+                return Data([Self.statusSuccess, tag])
+            case 4: // CHECK_ABORT_BULK_IN_STATUS
+                let sent = sentInBytes
+                sentInBytes = 0
+                return Data([Self.statusSuccess, 0, 0, 0]) + Self.littleEndian(sent)
+            case 5: // INITIATE_CLEAR
+                clearState()
+                return Data([Self.statusSuccess])
+            case 6: // CHECK_CLEAR_STATUS
+                return Data([Self.statusSuccess, 0])
+            case 7: // GET_CAPABILITIES
+                var capabilities = Data(count: 24)
+                capabilities[0] = Self.statusSuccess
+                capabilities[2] = 0x00 // bcdUSBTMC 1.00
+                capabilities[3] = 0x01
+                capabilities[4] = 0x04 // Accepts INDICATOR_PULSE
+                capabilities[5] = _options.supportsTermChar ? 1 : 0
+                if _options.isUSB488 {
+                    capabilities[12] = 0x00 // bcdUSB488 1.00
+                    capabilities[13] = 0x01
+                    capabilities[14] = 0x07 // USB488.2, REN_CONTROL and TRIGGER
+                    capabilities[15] = 0x0F // SCPI, SR1, RL1 and DT1
+                }
+                return capabilities
+            case 64: // INDICATOR_PULSE
+                _indicatorPulseCount += 1
+                return Data([Self.statusSuccess])
+            case 128 where _options.isUSB488: // READ_STATUS_BYTE
+                let status = _statusByte | (output.isEmpty ? 0 : Self.messageAvailableBit)
+                // With an interrupt endpoint, the status byte is sent there instead
+                transport.enqueue(Data([0x80 | (tag & 0x7F), status]), endpoint: Self.interruptInAddress)
+                return Data([Self.statusSuccess, tag, 0])
+            case 160 where _options.isUSB488: // REN_CONTROL
+                _isRemote = setup.value & 1 != 0
+                return Data([Self.statusSuccess])
+            case 161 where _options.isUSB488: // GO_TO_LOCAL
+                _isRemote = false
+                return Data([Self.statusSuccess])
+            case 162 where _options.isUSB488: // LOCAL_LOCKOUT
+                return Data([Self.statusSuccess])
+            default:
+                return Data([Self.statusFailed])
+            }
+        }
+    }
+
+    private static func littleEndian(_ value: Int) -> Data {
+        withUnsafeBytes(of: UInt32(value).littleEndian) { Data($0) }
+    }
+
+    /// Forget any message in progress and any response waiting to be read.
+    private func clearState() {
+        partialMessage = Data()
+        output = []
+        pendingRequest = nil
+        lastTag = 0
+        sentInBytes = 0
+    }
+
+    // MARK: SCPI model
+
+    /// Answer a message using the built-in SCPI model.
+    /// - Returns: The responses to the queries in the message, separated by `;` and ending in a newline, or nil if
+    ///   the message had no queries
+    private func respond(to message: Data) -> Data? {
+        let text = String(decoding: message, as: UTF8.self)
+        var responses: [String] = []
+        for rawCommand in text.split(whereSeparator: { $0 == ";" || $0 == "\n" }) {
+            let command = rawCommand.trimmingCharacters(in: .whitespaces)
+            if command.isEmpty {
+                continue
+            }
+            let parts = command.split(separator: " ", maxSplits: 1)
+            let header = parts[0].uppercased()
+            if header.hasSuffix("?") {
+                responses.append(query(String(header.dropLast())))
+            } else {
+                set(header, to: parts.count > 1 ? String(parts[1]) : "")
+            }
+        }
+        if responses.isEmpty {
+            return nil
+        }
+        return Data((responses.joined(separator: ";") + "\n").utf8)
+    }
+
+    private func query(_ header: String) -> String {
+        locked {
+            switch header {
+            case "*IDN":
+                return _options.identification
+            case "*OPC":
+                return "1"
+            case "*STB":
+                return String(_statusByte)
+            case "*ESR":
+                return "0"
+            default:
+                return _settings[Self.normalized(header)] ?? "0"
+            }
+        }
+    }
+
+    private func set(_ header: String, to value: String) {
+        locked {
+            switch header {
+            case "*RST", "*CLS":
+                _settings = [:]
+                _statusByte = 0
+            default:
+                _settings[Self.normalized(header)] = value
+            }
+        }
+    }
+
+    /// Treat `:SOUR:VOLT` and `SOUR:VOLT` as the same header.
+    private static func normalized(_ header: String) -> String {
+        header.hasPrefix(":") ? String(header.dropFirst()) : header
+    }
+
+    private func locked<T>(_ body: () throws -> T) rethrows -> T {
+        lock.lock()
+        defer { lock.unlock() }
+        return try body()
+    }
+}
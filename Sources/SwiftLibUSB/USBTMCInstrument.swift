@@ -13,9 +13,12 @@ import CoreSwiftVISA
 ///
 /// This class controlls [USB Test and Measurement Class Devices](https://www.usb.org/document-library/test-measurement-class-specification).
 /// This classification of devices is used for VISA-compatible instruments. If you need to connect to a USB device that does not support this protocol, you will need a new class to communicate with it.
+///
+/// An instrument can be shared between threads. Each read, write or query runs to completion before the next one on
+/// the same instrument starts; use ``withExclusiveAccess(_:)`` to keep a sequence of operations together.
 public class USBTMCInstrument: Instrument {
     /// Internal session property used so we can use the USBSession methods.
-    private var _session: USBSession
+    var _session: USBSession
     
     /// The session that this instrument communicates through.
     ///
@@ -25,35 +28,128 @@ public class USBTMCInstrument: Instrument {
     }
     
     // USB instruments are required to have various attributes, we use the defaults
-    public var attributes = MessageBasedInstrumentAttributes()
+    public var attributes: MessageBasedInstrumentAttributes {
+        get {
+            lock.lock()
+            defer { lock.unlock() }
+            return _attributes
+        }
+        set {
+            lock.lock()
+            defer { lock.unlock() }
+            _attributes = newValue
+        }
+    }
+    private var _attributes = MessageBasedInstrumentAttributes()
+    /// The attributes the instrument was created with, which ``prepareForReuse()`` restores.
+    private let initialAttributes = MessageBasedInstrumentAttributes()
+    
+    /// Held for the whole of each operation, so concurrent callers never interleave transfers or bTags.
+    ///
+    /// The lock is recursive so operations can be built from other operations. Each instrument has its own lock, so
+    /// different instruments are used in parallel.
+    let lock = NSRecursiveLock()
     private var messageIndex: UInt8
     private var inEndpoint: Endpoint
     private var outEndpoint: Endpoint
     private var activeInterface: AltSetting
+    /// The number of the USBTMC interface to use, or nil to use the first one found.
+    private let interfaceNumber: Int?
     private var canUseTerminator: Bool
+    /// True if the device has a USB488 interface, which must accept READ_STATUS_BYTE requests.
+    private var canReadStatusByte = false
+    /// The bTag of the last READ_STATUS_BYTE request, kept in the range [2-127] as section 4.3.1 of the USB488
+    /// specification requires.
+    private var statusByteTag: UInt8 = 1
+    /// Received bytes past the terminator of the last read, kept for the next read.
+    var readAhead = ReadAheadBuffer()
+    /// Reused storage for bulk in transfers, so receiving a message does not allocate a buffer for each chunk.
+    private var receiveBuffer: [UInt8] = []
+    /// Reused storage for building bulk out transfers.
+    private var sendBuffer: [UInt8] = []
+    
+    /// If true, set commands that would write the value a setting already has are not sent.
+    ///
+    /// The instrument remembers the last value written with each simple set command such as `VOLT 1.0`, keyed by its
+    /// header. Writing the same value again returns without a transfer. The remembered values are forgotten
+    /// after common commands such as `*RST`, after the session reconnects, and when ``invalidateStateCache()`` is
+    /// called. Only enable this if nothing else changes the device's settings.
+    public var isStateCacheEnabled: Bool {
+        get {
+            lock.lock()
+            defer { lock.unlock() }
+            return _isStateCacheEnabled
+        }
+        set {
+            lock.lock()
+            defer { lock.unlock() }
+            _isStateCacheEnabled = newValue
+            stateCache.removeAll()
+        }
+    }
+    private var _isStateCacheEnabled = false
+    /// The settings remembered while ``isStateCacheEnabled`` is true.
+    var stateCache = SCPIStateCache()
+    
+    /// What this instrument has done, and the endpoint counts from before the session last reconnected.
+    ///
+    /// These have their own lock so reading them never waits on an operation in progress. The endpoints are only
+    /// replaced while holding it too.
+    private var _statistics = InstrumentStatistics()
+    private var retiredBulkOut = EndpointStatistics()
+    private var retiredBulkIn = EndpointStatistics()
+    private let statisticsLock = NSLock()
     
     /// Attempts to connect to a USB device with the given identification.
     ///
     /// The product ID, vendor ID, and serial number can be found from the VISA identification string in the following format:
     ///
-    /// `USB::<vendor ID>::<product ID>::<serial number>::...`
+    /// `USB::<vendor ID>::<product ID>::<serial number>::<interface number>::...`
     ///
     /// - Parameters:
     ///    - vendorID: The number assigned to the manufacturer of the device
     ///    - productID: The number assigned to this type of device
     ///    - serialNumber: An optional string assigned uniquely to this device. This is needed if multiple of the same type of device are connected.
+    ///    - interfaceNumber: The number of the USBTMC interface to use, for devices with more than one. If nil, the first USBTMC interface is used.
     ///
     /// - Throws: ``USBSession/Error`` if there is an error establishing the instrument, ``USBError`` if the libUSB library encounters an error and ``USBTMCInstrument/Error`` if there is any other problem.
-    public init(vendorID: Int, productID: Int, serialNumber: String? = nil) throws {
+    public init(vendorID: Int, productID: Int, serialNumber: String? = nil, interfaceNumber: Int? = nil) throws {
         messageIndex = 1
         canUseTerminator = false
+        self.interfaceNumber = interfaceNumber
         try _session = USBSession(vendorID: vendorID, productID: productID, serialNumber: serialNumber)
-        try (activeInterface, inEndpoint, outEndpoint) = Self.findEndpoints(device: _session.device)
+        try (activeInterface, inEndpoint, outEndpoint) = Self.findEndpoints(
+            device: _session.device,
+            interfaceNumber: interfaceNumber)
         getCapabilities()
+        observeSession()
+    }
+    
+    /// Connect to the USBTMC interface of a device that has already been found.
+    ///
+    /// This allows instruments on transports other than libUSB, such as an ``InMemoryTransport``.
+    ///
+    /// - Parameters:
+    ///    - device: The device to communicate with, which should be open
+    ///    - interfaceNumber: The number of the USBTMC interface to use, for devices with more than one. If nil, the first USBTMC interface is used.
+    /// - Throws: ``USBError`` if the transport encounters an error and ``USBTMCInstrument/Error`` if the device has no such USBTMC interface.
+    public init(device: Device, interfaceNumber: Int? = nil) throws {
+        messageIndex = 1
+        canUseTerminator = false
+        self.interfaceNumber = interfaceNumber
+        _session = USBSession(device: device)
+        try (activeInterface, inEndpoint, outEndpoint) = Self.findEndpoints(
+            device: _session.device,
+            interfaceNumber: interfaceNumber)
+        getCapabilities()
+        observeSession()
     }
     
     /// Attempt to connect to a device described by a VISA identifier.
     ///
+    /// Strings of the form `USB0::<vendor ID>::<product ID>::<serial number>::<interface number>::INSTR`, as made by
+    /// ``USBTMCInstrument/discoverResources()``, connect to that interface. Without the interface number, the first
+    /// USBTMC interface of the device is used.
     /// - Parameters:
     ///     - visaString: A properly formatted VISA string that corresponds to a physically connected device
     /// - Throws: ``USBSession/Error`` if there is an error establishing the instrument, ``USBError`` if the libUSB library encounters an error, and ``USBTMCInstrument/Error`` if there is any other problem.
@@ -71,10 +167,21 @@ public class USBTMCInstrument: Instrument {
             throw Error.invalidVisa
         }
         
+        // The interface number comes before the resource class, so a string ending in "::INSTR" right after the
+        // serial number has none
+        var interfaceNumber: Int? = nil
+        if sections.count > 5 {
+            guard let number = Int(sections[4]) else {
+                throw Error.invalidVisa
+            }
+            interfaceNumber = number
+        }
+        
         try self.init(
             vendorID: vendorID,
             productID: productID,
-            serialNumber: serialNumber)
+            serialNumber: serialNumber,
+            interfaceNumber: interfaceNumber)
     }
 }
 
@@ -82,9 +189,19 @@ extension USBTMCInstrument {
     private static let headerSize = 12
     private static let transferAttributesByteIndex = 8
     private static let endOfMessageBit: UInt8 = 1
+    private static let termCharEnabledBit: UInt8 = 2
+    private static let termCharIndex = 9
     private static let readLengthStartIndex = 4
-    private static let readLengthEndIndex = 8
     private static let capabilitiesIndex = 5
+    private static let usb488VersionIndex = 12
+    /// USBTMC_status values from table 16 of the USBTMC specifications
+    private static let statusSuccess: UInt8 = 0x01
+    private static let statusPending: UInt8 = 0x02
+    /// The smallest message size requested when the terminator has to be found in software. Devices send no more than
+    /// they have, so asking for more lets several responses arrive in one transfer.
+    private static let readAheadChunkSize = 16384
+    /// The largest number of message bytes sent in one bulk out transfer.
+    static let maxWriteChunkSize = 1024
     
     /// Message types defined by USBTMC specification, table 15
     private enum ControlMessage: UInt8 {
@@ -96,6 +213,7 @@ extension USBTMCInstrument {
         case checkClearStatus = 6
         case getCapabilities = 7
         case indicatorPulse = 64
+        case readStatusByte = 128
     }
     
     private enum MessageKind: UInt8 {
@@ -104,11 +222,17 @@ extension USBTMCInstrument {
     }
     
     /// Looks through the available configurations and interfaces for an AltSetting that supports USBTMC
+    /// - Parameters:
+    ///   - device: The device to look through
+    ///   - interfaceNumber: The number of the interface to use, or nil to use the first USBTMC interface
     /// - throws: An ``Error`` if no endpoints can be found that fit the requiements of USBTMC
-    private static func findEndpoints(device: Device) throws -> (AltSetting, Endpoint, Endpoint) {
+    private static func findEndpoints(device: Device, interfaceNumber: Int?) throws -> (AltSetting, Endpoint, Endpoint) {
         for config in device.configurations {
             for interface in config.interfaces {
                 for altSetting in interface.altSettings where isTMC(altSetting: altSetting) {
+                    if let number = interfaceNumber, altSetting.interfaceIndex != number {
+                        continue
+                    }
                     // Stop looking after the first USBTMC interface we find
                     return try setupEndpoints(
                         config: config,
@@ -142,9 +266,15 @@ extension USBTMCInstrument {
         interface: Interface,
         altSetting: AltSetting
     ) throws -> (AltSetting, Endpoint, Endpoint) {
-        try config.setActive()
+        // Selecting a configuration or setting the device is already in still makes it reset, so only switch if needed
+        if try !config.isActive() {
+            try config.setActive()
+        }
         try interface.claim()
-        try altSetting.setActive()
+        // Some devices stall GET_INTERFACE, so a setting that can't be confirmed as active is selected anyway
+        if (try? altSetting.isActive()) != true {
+            try altSetting.setActive()
+        }
         let inEndpoint = try getEndpoint(endpoints: altSetting.endpoints, direction: Direction.in)
         let outEndpoint = try getEndpoint(endpoints: altSetting.endpoints, direction: Direction.out)
         return (altSetting, inEndpoint, outEndpoint)
@@ -166,6 +296,19 @@ extension USBTMCInstrument {
         throw Error.couldNotFindEndpoint
     }
     
+    /// Perform several operations on the instrument without operations from other threads in between.
+    ///
+    /// For example, a write followed by a read can't have another thread's query land between them. Operations on
+    /// other instruments are not blocked.
+    /// - Parameter body: The operations to perform, given this instrument
+    /// - Returns: The value returned by `body`
+    /// - Throws: Any error thrown by `body`
+    public func withExclusiveAccess<T>(_ body: (USBTMCInstrument) throws -> T) rethrows -> T {
+        lock.lock()
+        defer { lock.unlock() }
+        return try body(self)
+    }
+    
     /// Increment the message index such that it remains in the range [1-255] inclusive
     private func nextMessage() {
         messageIndex = (messageIndex % 255) + 1
@@ -188,6 +331,172 @@ extension USBTMCInstrument {
         return message
     }
     
+    /// Writes the header described in Table 8 of the USBTMC specifications into the start of `buffer`, followed by the
+    /// transfer attributes byte and three bytes of padding.
+    /// - Parameters:
+    ///   - buffer: The transfer being built. It must hold at least ``headerSize`` bytes.
+    ///   - kind: Whether this message is going to write to the device or request to read from the device
+    ///   - bufferSize: The amount of data being sent or received.
+    ///   - transferAttributes: The attributes byte, such as ``endOfMessageBit`` for the last transfer of a message
+    private func writeHeader(
+        into buffer: UnsafeMutableRawBufferPointer,
+        kind: MessageKind,
+        bufferSize: Int,
+        transferAttributes: UInt8
+    ) {
+        buffer[0] = kind.rawValue
+        buffer[1] = messageIndex
+        buffer[2] = 255 - messageIndex
+        buffer[3] = 0
+        buffer.storeBytes(of: UInt32(bufferSize).littleEndian, toByteOffset: Self.readLengthStartIndex, as: UInt32.self)
+        buffer[Self.transferAttributesByteIndex] = transferAttributes
+        buffer[9] = 0
+        buffer[10] = 0
+        buffer[11] = 0
+    }
+    
+    /// Send `bytes` to the device as one message, split into transfers of at most ``maxWriteChunkSize`` bytes.
+    ///
+    /// Each transfer is built in the same buffer, so sending does not allocate memory.
+    /// - Parameter bytes: The message to send
+    /// - Returns: The number of message bytes sent
+    /// - Throws: A ``USBError`` if a failure occurs during a data transfer, or ``USBTMCInstrument/Error/transferIncomplete`` if a transfer was only partly sent
+    private func sendMessage(_ bytes: UnsafeRawBufferPointer) throws -> Int {
+        try outEndpoint.clearHalt()
+        
+        var lowerBound = 0
+        repeat {
+            let size = min(Self.maxWriteChunkSize, bytes.count - lowerBound)
+            let lastMessage = lowerBound + size == bytes.count
+            
+            // Pad to 4 byte boundary
+            let paddingLength = (4 - size % 4) % 4
+            let transferSize = Self.headerSize + size + paddingLength
+            
+            if sendBuffer.count < transferSize {
+                sendBuffer = [UInt8](repeating: 0, count: transferSize)
+            }
+            let numSent = try sendBuffer.withUnsafeMutableBytes { buffer -> Int in
+                writeHeader(
+                    into: buffer,
+                    kind: MessageKind.write,
+                    bufferSize: size,
+                    transferAttributes: lastMessage ? Self.endOfMessageBit : 0)
+                if size > 0 {
+                    UnsafeMutableRawBufferPointer(rebasing: buffer[Self.headerSize..<Self.headerSize + size])
+                        .copyMemory(from: UnsafeRawBufferPointer(rebasing: bytes[lowerBound..<lowerBound + size]))
+                }
+                for index in Self.headerSize + size..<transferSize {
+                    buffer[index] = 0
+                }
+                return try USBTrace.trace("DEV_DEP_MSG_OUT", category: "usbtmc", tag: messageIndex, size: { $0 }) {
+                    try outEndpoint.sendBulkTransfer(
+                        bytes: UnsafeRawBufferPointer(rebasing: buffer[..<transferSize]),
+                        timeout: Int(attributes.operationDelay * 1000))
+                }
+            }
+            
+            nextMessage()
+            
+            if numSent != transferSize {
+                throw Error.transferIncomplete
+            }
+            lowerBound += size
+        } while lowerBound < bytes.count
+        
+        return lowerBound
+    }
+    
+    /// Encode a string and its terminator as UTF-8 directly after the header of a single transfer, then send it.
+    ///
+    /// This avoids building a combined `String` or any `Data` for short commands.
+    /// - Parameters:
+    ///   - string: The string to send
+    ///   - terminator: The terminator to send after `string`
+    ///   - asciiOnly: If true, strings containing non-ASCII characters are rejected
+    /// - Returns: The number of message bytes sent, or `nil` if the message does not fit in one transfer
+    /// - Throws: ``USBTMCInstrument/Error/cannotEncode`` if `asciiOnly` is true and the message is not ASCII, or any error thrown when sending
+    private func sendUTF8Message(_ string: String, appending terminator: String, asciiOnly: Bool) throws -> Int? {
+        let size = string.utf8.count + terminator.utf8.count
+        if size > Self.maxWriteChunkSize {
+            return nil
+        }
+        let paddingLength = (4 - size % 4) % 4
+        let transferSize = Self.headerSize + size + paddingLength
+        
+        if sendBuffer.count < transferSize {
+            sendBuffer = [UInt8](repeating: 0, count: transferSize)
+        }
+        let encoded = sendBuffer.withUnsafeMutableBytes { buffer -> Bool in
+            writeHeader(
+                into: buffer,
+                kind: MessageKind.write,
+                bufferSize: size,
+                transferAttributes: Self.endOfMessageBit)
+            var position = Self.headerSize
+            guard Self.copyUTF8(string, into: buffer, at: &position, asciiOnly: asciiOnly),
+                  Self.copyUTF8(terminator, into: buffer, at: &position, asciiOnly: asciiOnly) else {
+                return false
+            }
+            for index in position..<transferSize {
+                buffer[index] = 0
+            }
+            return true
+        }
+        if !encoded {
+            throw Error.cannotEncode
+        }
+        
+        try outEndpoint.clearHalt()
+        let numSent = try sendBuffer.withUnsafeBytes { buffer in
+            try USBTrace.trace("DEV_DEP_MSG_OUT", category: "usbtmc", tag: messageIndex, size: { $0 }) {
+                try outEndpoint.sendBulkTransfer(
+                    bytes: UnsafeRawBufferPointer(rebasing: buffer[..<transferSize]),
+                    timeout: Int(attributes.operationDelay * 1000))
+            }
+        }
+        
+        nextMessage()
+        
+        if numSent != transferSize {
+            throw Error.transferIncomplete
+        }
+        return size
+    }
+    
+    /// Copy the UTF-8 bytes of `string` into `buffer` starting at `position`, moving `position` past them.
+    /// - Returns: False if `asciiOnly` is true and the string is not ASCII
+    private static func copyUTF8(
+        _ string: String,
+        into buffer: UnsafeMutableRawBufferPointer,
+        at position: inout Int,
+        asciiOnly: Bool
+    ) -> Bool {
+        let start = position
+        let copied = string.utf8.withContiguousStorageIfAvailable { source -> Bool in
+            if asciiOnly && source.contains(where: { $0 >= 0x80 }) {
+                return false
+            }
+            UnsafeMutableRawBufferPointer(rebasing: buffer[start..<start + source.count])
+                .copyMemory(from: UnsafeRawBufferPointer(source))
+            return true
+        }
+        if let copied = copied {
+            position += copied ? string.utf8.count : 0
+            return copied
+        }
+        
+        // Bridged strings may not store UTF-8 contiguously
+        for byte in string.utf8 {
+            if asciiOnly && byte >= 0x80 {
+                return false
+            }
+            buffer[position] = byte
+            position += 1
+        }
+        return true
+    }
+    
     /// Get the capabilities of the device.
     ///
     /// Available capabilities include whether the device supports sending data, receiving data, pulsing, or using a terminator character on reads.
@@ -200,19 +509,163 @@ extension USBTMCInstrument {
                 recipient: .interface,
                 request: ControlMessage.getCapabilities.rawValue,
                 value: 0,
-                index: UInt16(activeInterface.index),
+                index: UInt16(activeInterface.interfaceIndex),
                 data: Data(count: 24),
                 length: 24,
                 timeout: UInt32(Int(attributes.operationDelay * 1000))
             )
             let termCapability = capabilities[Self.capabilitiesIndex]
             canUseTerminator = termCapability == 1
+            // USB488 devices report a nonzero bcdUSB488, as in table 2 of the USB488 specification
+            canReadStatusByte = capabilities.count > Self.usb488VersionIndex + 1
+                && (capabilities[Self.usb488VersionIndex] != 0 || capabilities[Self.usb488VersionIndex + 1] != 0)
         } catch {
             // Ignore errors for now; assume no capabilities
             canUseTerminator = false
+            canReadStatusByte = false
         }
     }
 
+    /// The interface this instrument is connected to, as ``discoverResources()`` lists it.
+    var resource: USBTMCResource {
+        lock.lock()
+        defer { lock.unlock() }
+        return USBTMCResource(
+            vendorID: _session.vendorID,
+            productID: _session.productID,
+            serialNumber: _session.serialNumber ?? "",
+            interfaceNumber: activeInterface.interfaceIndex,
+            isUSB488: canReadStatusByte)
+    }
+    
+    /// Follow the session through reconnects and closes.
+    private func observeSession() {
+        _session.reconnectHandlers.append { [weak self] in
+            try self?.rebind()
+        }
+        _session.closeHandlers.append { [weak self] in
+            self?.recordConnectionState()
+        }
+        recordConnectionState()
+    }
+    
+    /// Copy the session's connection state into the statistics, so they can be read on any thread without touching
+    /// the session. This must be called on the thread using the session.
+    private func recordConnectionState() {
+        let isOpen = _session.device.isOpen
+        let reconnects = _session.reconnectCount
+        updateStatistics {
+            $0.isSessionOpen = isOpen
+            $0.reconnects = reconnects
+        }
+    }
+    
+    /// Find the endpoints again after the session has reconnected, and start a new conversation with the device.
+    private func rebind() throws {
+        lock.lock()
+        defer { lock.unlock() }
+        
+        let (interface, newInEndpoint, newOutEndpoint) = try Self.findEndpoints(
+            device: _session.device,
+            interfaceNumber: interfaceNumber)
+        statisticsLock.lock()
+        retiredBulkIn = retiredBulkIn + inEndpoint.statistics
+        retiredBulkOut = retiredBulkOut + outEndpoint.statistics
+        (activeInterface, inEndpoint, outEndpoint) = (interface, newInEndpoint, newOutEndpoint)
+        statisticsLock.unlock()
+        messageIndex = 1
+        forgetPendingState()
+        getCapabilities()
+        recordConnectionState()
+    }
+    
+    /// Clear the device and start a new conversation with it, as if the instrument had just connected.
+    ///
+    /// ``InstrumentPool`` does this when an instrument is checked in, so nothing the last user sent, left unread or
+    /// changed reaches the next one. The attributes go back to the ones the instrument was created with, the state
+    /// cache is disabled and the session's query cache is reset to its default declarations.
+    /// - Throws: ``USBTMCInstrument/Error/requestFailed`` if the device refuses the clear, or a ``USBError`` if a transfer fails
+    func prepareForReuse() throws {
+        lock.lock()
+        defer { lock.unlock() }
+        
+        _attributes = initialAttributes
+        _isStateCacheEnabled = false
+        stateCache.removeAll()
+        _session.queryCache.reset()
+        try clearDevice(deadline: Date(timeIntervalSinceNow: 1))
+        messageIndex = 1
+    }
+    
+    /// Forget everything received from or assumed about the device that a clear or reset makes out of date.
+    private func forgetPendingState() {
+        readAhead.removeAll()
+        stateCache.removeAll()
+    }
+    
+    /// Send a USBTMC control request to the active interface and return the response.
+    /// - Parameters:
+    ///   - request: The request, from table 15 of the USBTMC specifications
+    ///   - value: The wValue of the request, such as a bTag
+    ///   - length: The number of bytes in the response
+    ///   - deadline: When the request must have finished by
+    /// - Throws: ``USBError/timeout`` if the deadline has passed, or any ``USBError`` from the transfer
+    private func controlRequest(
+        _ request: ControlMessage,
+        value: UInt16 = 0,
+        length: UInt16,
+        deadline: Date
+    ) throws -> Data {
+        let remaining = Int(deadline.timeIntervalSinceNow * 1000)
+        if remaining <= 0 {
+            throw USBError.timeout
+        }
+        // Class request to the interface, device to host, as in table 15
+        return try _session.device.sendControlTransfer(
+            requestType: 0xA1,
+            request: request.rawValue,
+            value: value,
+            index: UInt16(activeInterface.interfaceIndex),
+            data: Data(count: Int(length)),
+            length: length,
+            timeout: UInt32(min(remaining, Int(attributes.operationDelay * 1000))))
+    }
+    
+    /// Send a USBTMC INITIATE_CLEAR request and wait for the device to finish clearing, as described in section 4.2.1.6
+    /// of the USBTMC specifications.
+    /// - Parameter deadline: When the clear must have finished by
+    /// - Throws: ``USBTMCInstrument/Error/requestFailed`` if the device refuses the clear, or a ``USBError`` if a transfer fails or the deadline passes
+    private func clearDevice(deadline: Date) throws {
+        let initiate = try controlRequest(.initiateClear, length: 1, deadline: deadline)
+        if initiate.first != Self.statusSuccess {
+            throw Error.requestFailed
+        }
+        
+        while true {
+            let status = try controlRequest(.checkClearStatus, length: 2, deadline: deadline)
+            if status.first == Self.statusPending {
+                // The device may be waiting for us to read what it had queued
+                if status.count > 1 && status[status.startIndex + 1] & 1 != 0 {
+                    var discard = [UInt8](repeating: 0, count: inEndpoint.maxPacketSize)
+                    _ = try? discard.withUnsafeMutableBytes { buffer in
+                        try inEndpoint.receiveBulkTransfer(into: buffer, timeout: 10)
+                    }
+                } else {
+                    Thread.sleep(forTimeInterval: 0.005)
+                }
+                continue
+            }
+            if status.first != Self.statusSuccess {
+                throw Error.requestFailed
+            }
+            break
+        }
+        
+        // The specification requires the bulk out endpoint to be cleared after a clear
+        try outEndpoint.clearHalt()
+        forgetPendingState()
+    }
+    
     /// Send a USBTMC request message as defined in section 3.2.1.2 of the USBTMC specifications.
     /// - Parameters:
     ///   - headerSuffix: Header for the read request
@@ -226,31 +679,49 @@ extension USBTMCInstrument {
         chunkSize: Int
     ) throws -> Data {
         var readData = Data()
-        var endOfMessage = false
         
-        // TODO: get max transfer size
+        try receiveMessage(headerSuffix: headerSuffix, length: length, chunkSize: chunkSize) { bytes in
+            readData.append(bytes.bindMemory(to: UInt8.self))
+        }
+        
+        return readData
+    }
+    
+    /// Receive a message from the device, handing the message bytes of each transfer to `body` as they arrive.
+    ///
+    /// Every transfer is received into the same buffer, so reading a message of any size does not allocate memory for
+    /// each chunk.
+    /// - Parameters:
+    ///   - headerSuffix: Header for the read request
+    ///   - length: The maximum amount of data to receive
+    ///   - chunkSize: The amount of data to receive each time
+    ///   - body: Called with the message bytes of each transfer, without the header or alignment bytes. The bytes are
+    ///     only valid until `body` returns.
+    /// - Throws: a ``USBError`` if at any point a data transfer fails, ``USBTMCInstrument/Error/transferIncomplete`` if we could not request required information from the device, or any error thrown by `body`
+    func receiveMessage(
+        headerSuffix: Data,
+        length: Int?,
+        chunkSize: Int,
+        _ body: (UnsafeRawBufferPointer) throws -> Void
+    ) throws {
+        var received = 0
+        var endOfMessage = false
         
         while !endOfMessage {
-            var message : Data
-            
             // Send read request to out endpoint
-            if let length = length {
-                message = makeHeader(
-                    kind: MessageKind.read,
-                    bufferSize: min(chunkSize, length - readData.count))
-            } else {
-                message = makeHeader(kind: MessageKind.read, bufferSize: chunkSize)
-            }
-            
+            let requestSize = min(chunkSize, (length ?? Int.max) - received)
+            var message = makeHeader(kind: MessageKind.read, bufferSize: requestSize)
             message += headerSuffix
             
             // Clear halt for the in endpoint
             try inEndpoint.clearHalt()
             
             // Send the request message to a bulk out endpoint
-            let bytesSent = try outEndpoint.sendBulkTransfer(
-                data: message,
-                timeout: Int(attributes.operationDelay * 1000))
+            let bytesSent = try USBTrace.trace("REQUEST_DEV_DEP_MSG_IN", category: "usbtmc", tag: messageIndex, size: { $0 }) {
+                try outEndpoint.sendBulkTransfer(
+                    data: message,
+                    timeout: Int(attributes.operationDelay * 1000))
+            }
             
             // Throw if not all bytes were sent
             if bytesSent != message.count {
@@ -258,22 +729,198 @@ extension USBTMCInstrument {
             }
             
             // Get the response message from a bulk in endpoint
-            let data = try inEndpoint.receiveBulkTransfer(
-                length: chunkSize + Self.headerSize + 3,
-                timeout: Int(attributes.operationDelay * 1000))
+            let responseSize = requestSize + Self.headerSize + 3
+            if receiveBuffer.count < responseSize {
+                receiveBuffer = [UInt8](repeating: 0, count: responseSize)
+            }
+            let bytesReceived = try receiveBuffer.withUnsafeMutableBytes { buffer in
+                try USBTrace.trace("DEV_DEP_MSG_IN", category: "usbtmc", tag: messageIndex, size: { $0 }) {
+                    try inEndpoint.receiveBulkTransfer(
+                        into: UnsafeMutableRawBufferPointer(rebasing: buffer[..<responseSize]),
+                        timeout: Int(attributes.operationDelay * 1000))
+                }
+            }
             
             nextMessage()
             
-            // Don't add the header to the data buffer
-            readData += data[Self.headerSize...]
+            try receiveBuffer.withUnsafeBytes { buffer in
+                let response = try Self.responseMessage(in: buffer, received: bytesReceived)
+                try body(response.message)
+                
+                received += response.message.count
+                endOfMessage = response.endOfMessage
+            }
             
-            let resultLength = UInt32(littleEndian: data[Self.readLengthStartIndex..<Self.readLengthEndIndex].withUnsafeBytes { $0.pointee })
-            if resultLength <= readData.count + data.count - Self.headerSize {
-                endOfMessage = data[Self.transferAttributesByteIndex] & Self.endOfMessageBit != 0
+            if let length = length, received >= length {
+                break
             }
         }
+    }
+    
+    /// Find the message bytes in a DEV_DEP_MSG_IN transfer, as described in section 3.3.1 of the USBTMC specifications.
+    /// - Parameters:
+    ///   - buffer: The received transfer
+    ///   - received: The number of bytes received
+    /// - Returns: The message bytes, without the header or alignment bytes, and whether this transfer ends the message
+    /// - Throws: ``USBTMCInstrument/Error/transferIncomplete`` if the transfer is too short to hold a header
+    private static func responseMessage(
+        in buffer: UnsafeRawBufferPointer,
+        received: Int
+    ) throws -> (message: UnsafeRawBufferPointer, endOfMessage: Bool) {
+        if received < headerSize {
+            throw Error.transferIncomplete
+        }
+        let resultLength = UInt32(littleEndian: buffer.load(fromByteOffset: readLengthStartIndex, as: UInt32.self))
+        let messageEnd = min(received, headerSize + Int(resultLength))
+        return (
+            UnsafeRawBufferPointer(rebasing: buffer[headerSize..<messageEnd]),
+            buffer[transferAttributesByteIndex] & endOfMessageBit != 0)
+    }
+    
+    /// Write a short command and read its response with a single wait.
+    ///
+    /// The command, the request for the response and the transfer receiving the response are all submitted before
+    /// waiting, so the device can answer as soon as it has handled the command. Only a response longer than
+    /// `chunkSize` needs further round trips.
+    /// - Parameters:
+    ///   - string: The command, which must fit in one transfer when encoded with its terminator
+    ///   - writeTerminator: The terminator sent after the command
+    ///   - asciiOnly: If true, commands containing non-ASCII characters are rejected
+    ///   - terminator: The read terminator, if the device should stop sending at it
+    ///   - chunkSize: The most response bytes to request at a time
+    /// - Returns: The whole response message
+    /// - Throws: A ``USBError`` if a failure occurs during a data transfer, or an ``USBTMCInstrument/Error`` if the command cannot be encoded or the response is incomplete
+    private func pipelinedQuery(
+        _ string: String,
+        appending writeTerminator: String,
+        asciiOnly: Bool,
+        termChar: UInt8?,
+        chunkSize: Int
+    ) throws -> Data {
+        let timeout = Int(attributes.operationDelay * 1000)
         
-        return readData
+        // The command, as one whole message, followed by the request for the response in the same buffer
+        let size = string.utf8.count + writeTerminator.utf8.count
+        let commandSize = Self.headerSize + size + (4 - size % 4) % 4
+        if sendBuffer.count < commandSize + Self.headerSize {
+            sendBuffer = [UInt8](repeating: 0, count: commandSize + Self.headerSize)
+        }
+        let responseSize = chunkSize + Self.headerSize + 3
+        if receiveBuffer.count < responseSize {
+            receiveBuffer = [UInt8](repeating: 0, count: responseSize)
+        }
+        let requestIndex = messageIndex % 255 + 1
+        
+        let received = try sendBuffer.withUnsafeMutableBytes { send -> Int in
+            let command = UnsafeMutableRawBufferPointer(rebasing: send[..<commandSize])
+            writeHeader(into: command, kind: MessageKind.write, bufferSize: size, transferAttributes: Self.endOfMessageBit)
+            var position = Self.headerSize
+            guard Self.copyUTF8(string, into: command, at: &position, asciiOnly: asciiOnly),
+                  Self.copyUTF8(writeTerminator, into: command, at: &position, asciiOnly: asciiOnly) else {
+                throw Error.cannotEncode
+            }
+            for index in position..<commandSize {
+                command[index] = 0
+            }
+            nextMessage()
+            
+            let request = UnsafeMutableRawBufferPointer(rebasing: send[commandSize..<commandSize + Self.headerSize])
+            writeHeader(
+                into: request,
+                kind: MessageKind.read,
+                bufferSize: chunkSize,
+                transferAttributes: termChar == nil ? 0 : Self.termCharEnabledBit)
+            request[Self.termCharIndex] = termChar ?? 0
+            
+            return try receiveBuffer.withUnsafeMutableBytes { receive -> Int in
+                let response = UnsafeMutableRawBufferPointer(rebasing: receive[..<responseSize])
+                let transport = _session.device.transport
+                let transfers = [
+                    USBBulkTransferRequest(endpoint: UInt8(outEndpoint.address), data: command),
+                    USBBulkTransferRequest(endpoint: UInt8(outEndpoint.address), data: request),
+                    USBBulkTransferRequest(endpoint: UInt8(inEndpoint.address), data: response)
+                ]
+                do {
+                    // Transports that can submit transfers without waiting hand all three to the device at once
+                    let count = try USBTrace.trace("pipelined query", category: "usbtmc", tag: requestIndex, size: { $0 }) {
+                        try USBCapture.capture(transfers, transport: transport) {
+                            try transport.bulkTransfers(transfers, timeout: timeout)
+                        }[2]
+                    }
+                    // The transfers bypass the endpoints, so they are counted here
+                    outEndpoint.recordTransfer(bytes: commandSize)
+                    outEndpoint.recordTransfer(bytes: Self.headerSize)
+                    inEndpoint.recordTransfer(bytes: count)
+                    return count
+                } catch {
+                    // The pipeline fails as a whole, so the failure is counted against the response it was waiting for
+                    inEndpoint.recordTransfer(error: error)
+                    if error as? USBError == .pipe {
+                        // Halts are cleared before each separate write and read, but the pipeline skips that round trip
+                        try? outEndpoint.clearHalt()
+                        try? inEndpoint.clearHalt()
+                    }
+                    throw error
+                }
+            }
+        }
+        nextMessage()
+        
+        if received >= Self.headerSize && receiveBuffer[1] != requestIndex {
+            throw Error.transferIncomplete
+        }
+        let first = try receiveBuffer.withUnsafeBytes { buffer in
+            try Self.responseMessage(in: buffer, received: received)
+        }
+        var message = Data(first.message)
+        
+        // Responses longer than one chunk continue as a normal read
+        if !first.endOfMessage {
+            try receiveMessage(
+                headerSuffix: Data([termChar == nil ? 0 : Self.termCharEnabledBit, termChar ?? 0, 0, 0]),
+                length: nil,
+                chunkSize: chunkSize
+            ) { bytes in
+                message.append(contentsOf: bytes)
+            }
+        }
+        return message
+    }
+    
+    /// Read up to a terminator found in software, keeping any bytes after it for the next read.
+    ///
+    /// Whole messages are requested, so a device that sends several terminated responses in one message only needs
+    /// one transfer for all of them. If a message ends without a terminator, the read ends with the message.
+    /// - Parameters:
+    ///   - maxLength: The maximum number of bytes to return
+    ///   - terminator: The byte sequence to end reading at
+    ///   - strippingTerminator: If true, the terminator is not included in the returned data
+    ///   - chunkSize: The number of bytes to request at a time. At least ``readAheadChunkSize`` bytes are requested.
+    /// - Returns: The data up to and possibly including the terminator
+    /// - Throws: A ``USBError`` if a failure occurs during a data transfer
+    private func readBuffered(
+        maxLength: Int?,
+        until terminator: [UInt8],
+        strippingTerminator: Bool,
+        chunkSize: Int
+    ) throws -> Data {
+        if readAhead.isEmpty {
+            readAhead.append(try receiveUntilEndOfMessage(
+                headerSuffix: Data([0, 0, 0, 0]),
+                length: nil,
+                chunkSize: max(chunkSize, Self.readAheadChunkSize)))
+        }
+        
+        // The buffer only ever holds whole messages, so no terminator means the message ended first
+        guard let end = readAhead.endOfFirst(terminator) else {
+            return readAhead.take(maxLength ?? readAhead.count)
+        }
+        if let maxLength = maxLength, maxLength < end {
+            return readAhead.take(maxLength)
+        }
+        
+        let line = readAhead.take(end)
+        return strippingTerminator ? line.dropLast(terminator.count) : line
     }
 }
 
@@ -299,17 +946,22 @@ extension USBTMCInstrument: MessageBasedInstrument {
         }
         
         // Make the call to readBytes
-        let dataRead = try readBytes(
-            maxLength: nil,
-            until: terminatorBytes,
-            strippingTerminator: strippingTerminator,
-            chunkSize: chunkSize)
+        let dataRead = try USBTrace.trace("read", category: "usbtmc", size: { $0.count }) {
+            try readBytes(
+                maxLength: nil,
+                until: terminatorBytes,
+                strippingTerminator: strippingTerminator,
+                chunkSize: chunkSize)
+        }
         
         // Encode the output as a string
-        guard let outputString = String(data: dataRead, encoding: encoding) else {
+        let outputString = USBTrace.trace("decode", category: "usbtmc", size: { _ in dataRead.count }) {
+            String(data: dataRead, encoding: encoding)
+        }
+        guard let decoded = outputString else {
             throw Error.cannotEncode
         }
-        return outputString
+        return decoded
     }
     
     /// Read bytes from a device with no terminator
@@ -319,6 +971,15 @@ extension USBTMCInstrument: MessageBasedInstrument {
     /// - Returns: The data received
     /// - Throws: A ``USBError`` if a failure occurs during a data transfer
     public func readBytes(length: Int, chunkSize: Int) throws -> Data {
+        lock.lock()
+        defer { lock.unlock() }
+        let start = DispatchTime.now().uptimeNanoseconds
+        defer { recordLatency(\.read, since: start) }
+        
+        // Bytes left over from an earlier read come before anything still on the device
+        if !readAhead.isEmpty {
+            return readAhead.take(length)
+        }
         return try receiveUntilEndOfMessage(
             headerSuffix: Data([0, 0, 0, 0]),
             length: length,
@@ -326,38 +987,211 @@ extension USBTMCInstrument: MessageBasedInstrument {
     }
     
     /// Reads bytes from a device until the terminator is reached.
+    ///
+    /// If the device supports a terminator character and `terminator` is a single byte, the device stops sending at the
+    /// terminator. Otherwise whole messages are read and searched for the terminator; bytes after it are kept and
+    /// returned by the next read, so several terminated responses only cost one transfer. In both cases reading also
+    /// stops at the end of a message.
     /// - Parameters:
     ///   - maxLength: The maximum number of bytes to read.
-    ///   - terminator: The byte sequence to end reading at. USBTMC devices may not support terminator bytes, and
-    ///     only support a single byte terminator if at all.
+    ///   - terminator: The byte sequence to end reading at.
     ///   - strippingTerminator: If `true`, the terminator is stripped from the data before being returned, otherwise the data is returned with the terminator at the end.
     ///   - chunkSize: The number of bytes to read into a buffer at a time.
-    /// - Throws: Error if the device could not be read from.
     /// - Returns: The data read from the device as bytes.
-    /// - Throws: ``USBSession/Error/notSupported`` if the device does not support terminators, ``USBTMCInstrument/Error/invalidTerminator`` if the terminator has more than one byte, or a ``USBError`` if a failure occurs during a data transfer.
+    /// - Throws: ``USBTMCInstrument/Error/invalidTerminator`` if the terminator is empty, or a ``USBError`` if a failure occurs during a data transfer.
     public func readBytes(
         maxLength: Int?,
         until terminator: Data,
         strippingTerminator: Bool,
         chunkSize: Int
     ) throws -> Data {
-        //check if terminator is ok
-        if !canUseTerminator { throw USBSession.Error.notSupported }
-        if terminator.count != 1 { throw Error.invalidTerminator }
+        lock.lock()
+        defer { lock.unlock() }
         
-        let received: Data = try receiveUntilEndOfMessage(
-            headerSuffix: Data([2, terminator[0], 0, 0]),
-            length: maxLength,
+        if terminator.isEmpty { throw Error.invalidTerminator }
+        let start = DispatchTime.now().uptimeNanoseconds
+        defer { recordLatency(\.read, since: start) }
+        
+        if canUseTerminator && terminator.count == 1 && readAhead.isEmpty {
+            let received: Data = try receiveUntilEndOfMessage(
+                headerSuffix: Data([2, terminator[terminator.startIndex], 0, 0]),
+                length: maxLength,
+                chunkSize: chunkSize)
+            
+            if strippingTerminator && received.last == terminator[terminator.startIndex] {
+                return received.dropLast(1)
+            } else {
+                return received
+            }
+        }
+        
+        return try readBuffered(
+            maxLength: maxLength,
+            until: [UInt8](terminator),
+            strippingTerminator: strippingTerminator,
+            chunkSize: chunkSize)
+    }
+    
+    /// Write a command and read the response as a string.
+    ///
+    /// Short ASCII or UTF-8 commands are sent as a pipeline: the command, the request for the response and the
+    /// transfer receiving the response are submitted together and waited on once. Other commands are written and read
+    /// separately.
+    /// - Parameters:
+    ///   - string: The command to send
+    ///   - writeTerminator: The terminator to add to the end of `string`. Defaults to `attributes.writeTerminator`.
+    ///   - readTerminator: The terminator that ends the response. Defaults to `attributes.readTerminator`.
+    ///   - strippingTerminator: If true, the read terminator is removed from the response
+    ///   - encoding: The encoding of the command and response. Defaults to `attributes.encoding`.
+    ///   - chunkSize: The number of bytes to read into a buffer at a time. Defaults to `attributes.chunkSize`.
+    /// - Returns: The response
+    /// - Throws: A ``USBError`` if a failure occurs during a data transfer or an ``USBTMCInstrument/Error`` if the data cannot be encoded
+    public func query(
+        _ string: String,
+        writeTerminator: String? = nil,
+        readTerminator: String? = nil,
+        strippingTerminator: Bool = true,
+        encoding: String.Encoding? = nil,
+        chunkSize: Int? = nil
+    ) throws -> String {
+        lock.lock()
+        defer { lock.unlock() }
+        
+        let encoding = encoding ?? attributes.encoding
+        guard let terminator = (readTerminator ?? attributes.readTerminator).data(using: encoding) else {
+            throw Error.invalidTerminator
+        }
+        
+        let response = try USBTrace.trace("query", category: "usbtmc", size: { $0.count }) {
+            try queryBytes(
+                string,
+                appending: writeTerminator ?? attributes.writeTerminator,
+                encoding: encoding,
+                until: terminator,
+                strippingTerminator: strippingTerminator,
+                chunkSize: chunkSize ?? attributes.chunkSize)
+        }
+        
+        let outputString = USBTrace.trace("decode", category: "usbtmc", size: { _ in response.count }) {
+            String(data: response, encoding: encoding)
+        }
+        guard let decoded = outputString else {
+            throw Error.cannotEncode
+        }
+        return decoded
+    }
+    
+    /// Write a command and read the response as bytes.
+    ///
+    /// Responses to queries declared in the session's ``USBSession/queryCache`` are returned from memory when they are
+    /// cached.
+    /// - Parameters:
+    ///   - string: The command to send
+    ///   - writeTerminator: The terminator to add to the end of `string`
+    ///   - encoding: The encoding of the command
+    ///   - terminator: The byte sequence that ends the response
+    ///   - strippingTerminator: If true, the terminator is removed from the response
+    ///   - chunkSize: The number of bytes to read into a buffer at a time
+    /// - Returns: The response
+    /// - Throws: A ``USBError`` if a failure occurs during a data transfer or an ``USBTMCInstrument/Error`` if the data cannot be encoded
+    func queryBytes(
+        _ string: String,
+        appending writeTerminator: String,
+        encoding: String.Encoding,
+        until terminator: Data,
+        strippingTerminator: Bool,
+        chunkSize: Int
+    ) throws -> Data {
+        // Cached responses are stored without their terminator
+        let cache = _session.queryCache
+        if strippingTerminator, let cached = cache.response(for: string) {
+            return cached
+        }
+        let start = DispatchTime.now().uptimeNanoseconds
+        defer { recordLatency(\.query, since: start) }
+        
+        let response = try exchangeQuery(
+            string,
+            appending: writeTerminator,
+            encoding: encoding,
+            until: terminator,
+            strippingTerminator: strippingTerminator,
             chunkSize: chunkSize)
         
         if strippingTerminator {
-           return received.dropLast(1)
-        } else {
-            return received
+            cache.store(response, for: string)
         }
+        return response
+    }
+    
+    /// Write a command and read the response as bytes, pipelining the two when possible.
+    /// - Parameters:
+    ///   - string: The command to send
+    ///   - writeTerminator: The terminator to add to the end of `string`
+    ///   - encoding: The encoding of the command
+    ///   - terminator: The byte sequence that ends the response
+    ///   - strippingTerminator: If true, the terminator is removed from the response
+    ///   - chunkSize: The number of bytes to read into a buffer at a time
+    /// - Returns: The response
+    /// - Throws: A ``USBError`` if a failure occurs during a data transfer or an ``USBTMCInstrument/Error`` if the data cannot be encoded
+    private func exchangeQuery(
+        _ string: String,
+        appending writeTerminator: String,
+        encoding: String.Encoding,
+        until terminator: Data,
+        strippingTerminator: Bool,
+        chunkSize: Int
+    ) throws -> Data {
+        if terminator.isEmpty { throw Error.invalidTerminator }
+        
+        // Unread bytes from an earlier response have to be returned first, so only pipeline from a clean state
+        let fitsInOneTransfer = string.utf8.count + writeTerminator.utf8.count <= Self.maxWriteChunkSize
+        guard readAhead.isEmpty && fitsInOneTransfer && (encoding == .ascii || encoding == .utf8) else {
+            _ = try write(string, appending: writeTerminator, encoding: encoding)
+            return try readBytes(
+                maxLength: nil,
+                until: terminator,
+                strippingTerminator: strippingTerminator,
+                chunkSize: chunkSize)
+        }
+        
+        let useTermChar = canUseTerminator && terminator.count == 1
+        let check = stateCacheCheck(string)
+        let message: Data
+        do {
+            message = try pipelinedQuery(
+                string,
+                appending: writeTerminator,
+                asciiOnly: encoding == .ascii,
+                termChar: useTermChar ? terminator[terminator.startIndex] : nil,
+                chunkSize: useTermChar ? chunkSize : max(chunkSize, Self.readAheadChunkSize))
+        } catch {
+            stateCacheRecord(check, succeeded: false)
+            throw error
+        }
+        stateCacheRecord(check, succeeded: true)
+        
+        if useTermChar {
+            if strippingTerminator && message.last == terminator[terminator.startIndex] {
+                return message.dropLast(1)
+            }
+            return message
+        }
+        
+        // Keep anything after the terminator for the next read, as readBytes would
+        readAhead.append(message)
+        return try readBuffered(
+            maxLength: nil,
+            until: [UInt8](terminator),
+            strippingTerminator: strippingTerminator,
+            chunkSize: chunkSize)
     }
     
     /// Write data to the device as a string.
+    ///
+    /// ASCII and UTF-8 messages that fit in one transfer are encoded straight into the outgoing transfer, without
+    /// building an intermediate `String` or `Data`. If ``isStateCacheEnabled`` is true and the message would not change
+    /// any setting, nothing is sent.
     /// - Parameters:
     ///   - string: The string to write to the device.
     ///   - terminator: The terminator to add to the end of `string`.
@@ -370,58 +1204,251 @@ extension USBTMCInstrument: MessageBasedInstrument {
         appending terminator: String?,
         encoding: String.Encoding
     ) throws -> Int {
+        lock.lock()
+        defer { lock.unlock() }
+        
+        let check = stateCacheCheck(string)
+        if let check = check, check.isRedundant {
+            return (string + (terminator ?? "")).lengthOfBytes(using: encoding)
+        }
+        
+        let start = DispatchTime.now().uptimeNanoseconds
+        defer { recordLatency(\.write, since: start) }
+        let sent: Int
+        do {
+            sent = try USBTrace.trace("write", category: "usbtmc", size: { $0 }) {
+                try sendString(string, appending: terminator, encoding: encoding)
+            }
+        } catch {
+            stateCacheRecord(check, succeeded: false)
+            throw error
+        }
+        stateCacheRecord(check, succeeded: true)
+        return sent
+    }
+    
+    /// Encode and send a string, without consulting the state cache.
+    private func sendString(
+        _ string: String,
+        appending terminator: String?,
+        encoding: String.Encoding
+    ) throws -> Int {
+        if encoding == .ascii || encoding == .utf8 {
+            if let sent = try sendUTF8Message(string, appending: terminator ?? "", asciiOnly: encoding == .ascii) {
+                return sent
+            }
+        }
+        
         let message = string + (terminator ?? "")
         guard let messageData = message.data(using: encoding) else {
             throw Error.cannotEncode
         }
-        return try writeBytes(messageData, appending: nil)
+        return try messageData.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+            try sendMessage(bytes)
+        }
     }
     
     /// Write data to a device as bytes.
+    ///
+    /// Raw bytes are not interpreted, so this forgets every setting remembered by the state cache.
     /// - Parameters:
     ///   - bytes: The data to write to the device.
     ///   - terminator: The sequence of bytes to append to the end of `bytes`.
     /// - Returns: The number of bytes that were written to the device.
     /// - Throws: A ``USBError`` if a failure occurs during a data transfer
     public func writeBytes(_ data: Data, appending terminator: Data?) throws -> Int {
-        let messageData = data + (terminator ?? Data())
-
-        let writeSize = min(data.count,1024)
+        lock.lock()
+        defer { lock.unlock() }
+        
+        let messageData = terminator.map { data + $0 } ?? data
+        stateCache.removeAll()
+        let start = DispatchTime.now().uptimeNanoseconds
+        defer { recordLatency(\.write, since: start) }
+        
+        return try USBTrace.trace("write", category: "usbtmc", size: { $0 }) {
+            try messageData.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                try sendMessage(bytes)
+            }
+        }
+    }
+}
 
-        try outEndpoint.clearHalt()
+extension USBTMCInstrument {
+    /// Latency histograms and transfer counts for everything this instrument has done since it was created.
+    ///
+    /// Reading the statistics does not wait for an operation in progress. The endpoint counts carry over when the
+    /// session reconnects.
+    public var statistics: InstrumentStatistics {
+        statisticsLock.lock()
+        defer { statisticsLock.unlock() }
+        var statistics = _statistics
+        statistics.bulkOut = retiredBulkOut + outEndpoint.statistics
+        statistics.bulkIn = retiredBulkIn + inEndpoint.statistics
+        return statistics
+    }
+    
+    /// Add the time since `start` to one of the latency histograms.
+    private func recordLatency(_ histogram: WritableKeyPath<InstrumentStatistics, LatencyHistogram>, since start: UInt64) {
+        let elapsed = DispatchTime.now().uptimeNanoseconds - start
+        updateStatistics { $0[keyPath: histogram].record(nanoseconds: elapsed) }
+    }
+    
+    private func updateStatistics(_ update: (inout InstrumentStatistics) -> Void) {
+        statisticsLock.lock()
+        defer { statisticsLock.unlock() }
+        update(&_statistics)
+    }
+}
 
-        var lastMessage = false
-        var lowerBound = 0
-        while !lastMessage {
-            var upperBound = lowerBound + writeSize
-            
-            if upperBound >= messageData.count {
-                lastMessage = true
-                upperBound = messageData.count
+extension USBTMCInstrument {
+    /// How far ``USBTMCInstrument/recover(timeout:)`` had to go to get the device working again.
+    public enum RecoveryLevel {
+        /// A USBTMC clear emptied the device's input and output buffers.
+        case cleared
+        /// The device refused the clear, but its halted endpoints were cleared.
+        case haltsCleared
+        /// The device was reset and its interface claimed again.
+        case reset
+        /// The device had to be found again after the reset.
+        case reconnected
+    }
+    
+    /// Clear the device's input and output buffers using the USBTMC INITIATE_CLEAR request.
+    ///
+    /// This abandons any command in progress and any response not yet read, without changing the device's settings.
+    /// - Parameter timeout: The most time, in seconds, to wait for the device to finish clearing
+    /// - Throws: ``USBTMCInstrument/Error/requestFailed`` if the device refuses the clear, or a ``USBError`` if a transfer fails or the timeout passes
+    public func clear(timeout: TimeInterval = 1) throws {
+        lock.lock()
+        defer { lock.unlock() }
+        
+        updateStatistics { $0.clears += 1 }
+        try clearDevice(deadline: Date(timeIntervalSinceNow: timeout))
+    }
+    
+    /// Get a device that has stopped responding working again, trying the least disruptive fix first.
+    ///
+    /// Each step is only tried if the one before it fails:
+    /// 1. A USBTMC clear.
+    /// 2. Clearing halts on the bulk endpoints.
+    /// 3. Resetting the device and claiming its interface again.
+    /// 4. Finding the device again.
+    ///
+    /// A step only succeeds if the device answers afterwards, either a USB488 READ_STATUS_BYTE request or, for devices
+    /// without USB488, a `*STB?` query. Each step gets an equal share of the time left, so a step that hangs leaves time
+    /// for the ones after it.
+    ///
+    /// Anything received but not read, and anything remembered by the state cache, is discarded. After a reset the
+    /// bTag sequence starts again from 1.
+    /// - Parameter timeout: The total time, in seconds, to spend recovering
+    /// - Returns: The step that got the device working again
+    /// - Throws: The error from the last step if every step fails
+    @discardableResult
+    public func recover(timeout: TimeInterval = 1) throws -> RecoveryLevel {
+        lock.lock()
+        defer { lock.unlock() }
+        
+        do {
+            let level = try recoverDevice(timeout: timeout)
+            updateStatistics { $0.recoveries[level, default: 0] += 1 }
+            return level
+        } catch {
+            updateStatistics { $0.failedRecoveries += 1 }
+            throw error
+        }
+    }
+    
+    /// Carry out the steps of ``recover(timeout:)``.
+    private func recoverDevice(timeout: TimeInterval) throws -> RecoveryLevel {
+        let deadline = Date(timeIntervalSinceNow: timeout)
+        forgetPendingState()
+        
+        var stepDeadline = Self.share(of: deadline, steps: 4)
+        let cleared = try? limitingTransfers(until: stepDeadline) {
+            try clearDevice(deadline: stepDeadline)
+            try verifyResponding(deadline: stepDeadline)
+        }
+        if cleared != nil {
+            return .cleared
+        }
+        
+        stepDeadline = Self.share(of: deadline, steps: 3)
+        let haltsCleared = try? limitingTransfers(until: stepDeadline) {
+            try inEndpoint.clearHalt()
+            try outEndpoint.clearHalt()
+            try verifyResponding(deadline: stepDeadline)
+        }
+        if haltsCleared != nil {
+            return .haltsCleared
+        }
+        
+        stepDeadline = Self.share(of: deadline, steps: 2)
+        do {
+            try limitingTransfers(until: stepDeadline) {
+                try _session.device.reset()
+                try rebind()
+                try verifyResponding(deadline: stepDeadline)
             }
-            let dataSlice = messageData.subdata(in: lowerBound..<upperBound)
-            
-            var dataToSend = makeHeader(kind: MessageKind.write, bufferSize: dataSlice.count)
-            
-            // After the header, there is one byte to indicate the end of message, then
-            // three bytes of padding.
-            dataToSend.append(Data([lastMessage ? 1 : 0, 0, 0, 0]))
-            
-            dataToSend.append(dataSlice)
-            
-            // Pad to 4 byte boundary
-            let paddingLength = (4 - dataSlice.count % 4) % 4
-            dataToSend.append(Data(Array(repeating: 0, count: paddingLength)))
-            
-            let numSent = try outEndpoint.sendBulkTransfer(
-                data: dataToSend,
-                timeout: Int(attributes.operationDelay * 1000))
-            
-            lowerBound += numSent - Self.headerSize - paddingLength // Move up by the amount sent
-
-            nextMessage()
+            return .reset
+        } catch {
+            let remaining = deadline.timeIntervalSinceNow
+            if remaining <= 0 {
+                throw error
+            }
+            // Reconnecting rebinds this instrument through its reconnect handler. Half the time left is kept to check
+            // that the device answers.
+            try _session.reconnect(timeout: remaining * 500)
+            try limitingTransfers(until: deadline) {
+                try verifyResponding(deadline: deadline)
+            }
+            return .reconnected
         }
-        return lowerBound
+    }
+    
+    /// The deadline of the next of `steps` steps that share the time left before `deadline` equally.
+    private static func share(of deadline: Date, steps: Int) -> Date {
+        Date(timeIntervalSinceNow: max(deadline.timeIntervalSinceNow, 0) / Double(steps))
+    }
+    
+    /// Run `body` with ``MessageBasedInstrumentAttributes/operationDelay``, the timeout of each transfer, shortened to
+    /// end by `deadline`.
+    private func limitingTransfers(until deadline: Date, _ body: () throws -> Void) throws {
+        let operationDelay = _attributes.operationDelay
+        defer { _attributes.operationDelay = operationDelay }
+        let remaining = deadline.timeIntervalSinceNow
+        if remaining <= 0 {
+            throw USBError.timeout
+        }
+        _attributes.operationDelay = min(operationDelay, remaining)
+        try body()
+    }
+    
+    /// Check that the device answers, after a step of ``recover(timeout:)``.
+    /// - Parameter deadline: When the device must have answered by
+    /// - Throws: ``USBTMCInstrument/Error/requestFailed`` if the device refuses the request, or a ``USBError`` if a transfer fails or the deadline passes
+    private func verifyResponding(deadline: Date) throws {
+        if canReadStatusByte {
+            statusByteTag = statusByteTag >= 127 ? 2 : statusByteTag + 1
+            let status = try controlRequest(
+                .readStatusByte,
+                value: UInt16(statusByteTag),
+                length: 3,
+                deadline: deadline)
+            if status.first != Self.statusSuccess {
+                throw Error.requestFailed
+            }
+            return
+        }
+        if deadline.timeIntervalSinceNow <= 0 {
+            throw USBError.timeout
+        }
+        _ = try exchangeQuery(
+            "*STB?",
+            appending: _attributes.writeTerminator,
+            encoding: _attributes.encoding,
+            until: Data(_attributes.readTerminator.utf8),
+            strippingTerminator: true,
+            chunkSize: _attributes.chunkSize)
     }
 }
 
@@ -443,6 +1470,21 @@ extension USBTMCInstrument {
         
         /// Not all bytes of the transfer were send, but no error was thrown by libUSB.
         case transferIncomplete
+        
+        /// The response was not a definite length block of the expected element type.
+        case invalidBlock
+        
+        /// The response was larger than the buffer given to receive it.
+        case bufferTooSmall
+        
+        /// The response could not be parsed as a number.
+        case invalidNumber
+        
+        /// The device reported that a USBTMC control request, such as a clear, failed.
+        case requestFailed
+        
+        /// A batched response did not hold one response for each query in the batch.
+        case responseCountMismatch
     }
 }
 
@@ -459,6 +1501,16 @@ extension USBTMCInstrument.Error {
             return "The given visa string could not be interpreted"
         case .transferIncomplete:
             return "The amount of bytes actually sent did not match expectations"
+        case .invalidBlock:
+            return "The response was not a valid definite length block"
+        case .bufferTooSmall:
+            return "The response did not fit in the given buffer"
+        case .invalidNumber:
+            return "The response could not be parsed as a number"
+        case .requestFailed:
+            return "The device could not carry out the request"
+        case .responseCountMismatch:
+            return "The number of responses did not match the number of queries sent"
         }
     }
 }
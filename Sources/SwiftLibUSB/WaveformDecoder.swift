@@ -0,0 +1,328 @@
+//
+//  WaveformDecoder.swift
+//  SwiftLibUSB
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+
+/// How the samples of a binary waveform are encoded.
+public struct WaveformFormat {
+    /// The type of each raw sample.
+    public enum SampleType {
+        case int8
+        case uint8
+        case int16
+        case uint16
+        case int32
+        case float32
+        case float64
+    }
+
+    /// The order of the bytes in each raw sample.
+    public enum ByteOrder {
+        /// Most significant byte first. This is the IEEE 488.2 default, often selected with `:WAV:BYT MSBF`.
+        case bigEndian
+        /// Least significant byte first.
+        case littleEndian
+    }
+
+    /// The type of each raw sample.
+    public var sampleType: SampleType
+
+    /// The order of the bytes in each raw sample.
+    public var byteOrder: ByteOrder
+
+    public init(sampleType: SampleType, byteOrder: ByteOrder = .bigEndian) {
+        self.sampleType = sampleType
+        self.byteOrder = byteOrder
+    }
+
+    /// The number of bytes in each raw sample.
+    public var sampleSize: Int {
+        switch sampleType {
+        case .int8, .uint8:
+            return 1
+        case .int16, .uint16:
+            return 2
+        case .int32, .float32:
+            return 4
+        case .float64:
+            return 8
+        }
+    }
+}
+
+/// The conversion from raw samples to physical values, such as volts.
+///
+/// Each value is `(raw - reference) * increment + origin`. These correspond to the Y increment, Y reference and Y
+/// origin reported by most oscilloscopes (or `YMULT`, `YOFF` and `YZERO` on some).
+public struct WaveformScaling {
+    public var increment: Double
+    public var origin: Double
+    public var reference: Double
+
+    public init(increment: Double = 1, origin: Double = 0, reference: Double = 0) {
+        self.increment = increment
+        self.origin = origin
+        self.reference = reference
+    }
+
+    /// Leaves raw values unchanged.
+    public static let identity = WaveformScaling()
+
+    /// The value added after multiplying by ``increment``.
+    var offset: Double {
+        origin - reference * increment
+    }
+}
+
+/// Converts raw binary waveform bytes to scaled floating point values.
+///
+/// Samples are byte swapped and scaled eight at a time using SIMD vectors, with the scaling done as a single fused
+/// multiply-add. The decoder keeps partial samples between calls, so it can be fed chunks as they arrive from the
+/// device, split at any byte.
+public struct WaveformDecoder {
+    /// The encoding of the raw samples.
+    public let format: WaveformFormat
+
+    /// The conversion applied to each raw sample.
+    public let scaling: WaveformScaling
+
+    /// The start of a sample split between two chunks.
+    private var carry: [UInt8] = []
+
+    public init(format: WaveformFormat, scaling: WaveformScaling = .identity) {
+        self.format = format
+        self.scaling = scaling
+    }
+
+    /// The number of values decoded from `byteCount` bytes, including any partial sample left from earlier calls.
+    public func decodedCount(byteCount: Int) -> Int {
+        (carry.count + byteCount) / format.sampleSize
+    }
+
+    /// Decode the whole samples in `bytes` into `output`.
+    /// - Parameters:
+    ///   - bytes: The next raw bytes of the waveform
+    ///   - output: Where to write the values. It must have room for ``decodedCount(byteCount:)`` values.
+    /// - Returns: The number of values written to the start of `output`
+    public mutating func decode(_ bytes: UnsafeRawBufferPointer, into output: UnsafeMutableBufferPointer<Float>) -> Int {
+        decodeChunk(bytes, into: output)
+    }
+
+    /// Decode the whole samples in `bytes` into `output`.
+    /// - Parameters:
+    ///   - bytes: The next raw bytes of the waveform
+    ///   - output: Where to write the values. It must have room for ``decodedCount(byteCount:)`` values.
+    /// - Returns: The number of values written to the start of `output`
+    public mutating func decode(_ bytes: UnsafeRawBufferPointer, into output: UnsafeMutableBufferPointer<Double>) -> Int {
+        decodeChunk(bytes, into: output)
+    }
+
+    /// Decode one chunk, finishing any sample split from the previous chunk first.
+    fileprivate mutating func decodeChunk<Sample: BinaryFloatingPoint & SIMDScalar>(
+        _ bytes: UnsafeRawBufferPointer,
+        into output: UnsafeMutableBufferPointer<Sample>
+    ) -> Int {
+        precondition(decodedCount(byteCount: bytes.count) <= output.count, "Output buffer is too small")
+        let sampleSize = format.sampleSize
+        var consumed = 0
+        var written = 0
+
+        if !carry.isEmpty {
+            consumed = min(sampleSize - carry.count, bytes.count)
+            carry.append(contentsOf: bytes[0..<consumed])
+            if carry.count < sampleSize {
+                return 0
+            }
+            carry.withUnsafeBytes { sample in
+                convert(sample.baseAddress!, count: 1, into: output.baseAddress!)
+            }
+            carry.removeAll(keepingCapacity: true)
+            written = 1
+        }
+
+        let whole = (bytes.count - consumed) / sampleSize
+        if whole > 0 {
+            convert(bytes.baseAddress! + consumed, count: whole, into: output.baseAddress! + written)
+        }
+        carry.append(contentsOf: bytes[(consumed + whole * sampleSize)...])
+
+        return written + whole
+    }
+
+    /// Convert `count` whole samples.
+    private func convert<Sample: BinaryFloatingPoint & SIMDScalar>(
+        _ source: UnsafeRawPointer,
+        count: Int,
+        into output: UnsafeMutablePointer<Sample>
+    ) {
+        let swapped = (format.byteOrder == .bigEndian) == (1.bigEndian != 1)
+        let scale = Sample(scaling.increment)
+        let offset = Sample(scaling.offset)
+
+        switch format.sampleType {
+        case .int8:
+            convertLanes(source, count: count, into: output, scale: scale, offset: offset, swapped: false,
+                         vector: { (lanes: SIMD8<Int8>) in SIMD8<Sample>(lanes) },
+                         scalar: { Sample($0) })
+        case .uint8:
+            convertLanes(source, count: count, into: output, scale: scale, offset: offset, swapped: false,
+                         vector: { (lanes: SIMD8<UInt8>) in SIMD8<Sample>(lanes) },
+                         scalar: { Sample($0) })
+        case .int16:
+            convertLanes(source, count: count, into: output, scale: scale, offset: offset, swapped: swapped,
+                         vector: { (lanes: SIMD8<Int16>) in SIMD8<Sample>(lanes) },
+                         scalar: { Sample($0) })
+        case .uint16:
+            convertLanes(source, count: count, into: output, scale: scale, offset: offset, swapped: swapped,
+                         vector: { (lanes: SIMD8<UInt16>) in SIMD8<Sample>(lanes) },
+                         scalar: { Sample($0) })
+        case .int32:
+            convertLanes(source, count: count, into: output, scale: scale, offset: offset, swapped: swapped,
+                         vector: { (lanes: SIMD8<Int32>) in SIMD8<Sample>(lanes) },
+                         scalar: { Sample($0) })
+        case .float32:
+            convertLanes(source, count: count, into: output, scale: scale, offset: offset, swapped: swapped,
+                         vector: { (lanes: SIMD8<UInt32>) in SIMD8<Sample>(unsafeBitCast(lanes, to: SIMD8<Float>.self)) },
+                         scalar: { Sample(Float(bitPattern: $0)) })
+        case .float64:
+            convertLanes(source, count: count, into: output, scale: scale, offset: offset, swapped: swapped,
+                         vector: { (lanes: SIMD8<UInt64>) in SIMD8<Sample>(unsafeBitCast(lanes, to: SIMD8<Double>.self)) },
+                         scalar: { Sample(Double(bitPattern: $0)) })
+        }
+    }
+
+    /// Load raw samples eight at a time, swap their bytes if needed, and scale them.
+    /// - Parameters:
+    ///   - vector: Converts eight raw samples, already in host byte order, to values
+    ///   - scalar: Converts one raw sample, already in host byte order, to a value
+    @inline(__always)
+    private func convertLanes<Raw: FixedWidthInteger & SIMDScalar, Sample: BinaryFloatingPoint & SIMDScalar>(
+        _ source: UnsafeRawPointer,
+        count: Int,
+        into output: UnsafeMutablePointer<Sample>,
+        scale: Sample,
+        offset: Sample,
+        swapped: Bool,
+        vector: (SIMD8<Raw>) -> SIMD8<Sample>,
+        scalar: (Raw) -> Sample
+    ) {
+        let rawSize = MemoryLayout<Raw>.size
+        let scaleLanes = SIMD8<Sample>(repeating: scale)
+        let offsetLanes = SIMD8<Sample>(repeating: offset)
+        var index = 0
+
+        while index + 8 <= count {
+            var lanes = SIMD8<Raw>()
+            withUnsafeMutableBytes(of: &lanes) { destination in
+                destination.copyMemory(from: UnsafeRawBufferPointer(start: source + index * rawSize, count: 8 * rawSize))
+            }
+            if swapped {
+                lanes = lanes.byteSwappedLanes
+            }
+            let values = offsetLanes.addingProduct(vector(lanes), scaleLanes)
+            withUnsafeBytes(of: values) { bytes in
+                UnsafeMutableRawPointer(output + index).copyMemory(from: bytes.baseAddress!, byteCount: bytes.count)
+            }
+            index += 8
+        }
+
+        while index < count {
+            var raw = Raw.zero
+            withUnsafeMutableBytes(of: &raw) { destination in
+                destination.copyMemory(from: UnsafeRawBufferPointer(start: source + index * rawSize, count: rawSize))
+            }
+            if swapped {
+                raw = raw.byteSwapped
+            }
+            output[index] = offset.addingProduct(scalar(raw), scale)
+            index += 1
+        }
+    }
+}
+
+private extension SIMD8 where Scalar: FixedWidthInteger {
+    /// The lanes with the order of their bytes reversed.
+    var byteSwappedLanes: SIMD8 {
+        if Scalar.bitWidth == 8 {
+            return self
+        }
+        let lowByte = Scalar(truncatingIfNeeded: 0xFF)
+        var remaining = self
+        var result = SIMD8()
+        for _ in 0..<(Scalar.bitWidth / 8) {
+            result = (result &<< 8) | (remaining & lowByte)
+            remaining = remaining &>> 8
+        }
+        return result
+    }
+}
+
+extension USBTMCInstrument {
+    /// Read a binary waveform sent as a definite length block, converting it to scaled values as chunks arrive.
+    ///
+    /// The result is allocated once at its final size, and each chunk is decoded straight from the receive buffer,
+    /// so the raw bytes are never collected.
+    /// - Parameters:
+    ///   - type: Pass `Float.self` to get single precision values
+    ///   - format: How the instrument encodes its samples
+    ///   - scaling: The conversion from raw samples to physical values
+    ///   - chunkSize: The number of bytes to read at a time. Defaults to `attributes.chunkSize`.
+    /// - Returns: The scaled values
+    /// - Throws: ``USBTMCInstrument/Error/invalidBlock`` if the response is not a block of whole samples, or any error thrown by ``readBlock(chunkSize:start:body:)``
+    public func readWaveform(
+        as type: Float.Type,
+        format: WaveformFormat,
+        scaling: WaveformScaling = .identity,
+        chunkSize: Int? = nil
+    ) throws -> [Float] {
+        try readDecodedWaveform(format: format, scaling: scaling, chunkSize: chunkSize)
+    }
+
+    /// Read a binary waveform sent as a definite length block, converting it to scaled values as chunks arrive.
+    ///
+    /// The result is allocated once at its final size, and each chunk is decoded straight from the receive buffer,
+    /// so the raw bytes are never collected.
+    /// - Parameters:
+    ///   - type: Pass `Double.self` to get double precision values
+    ///   - format: How the instrument encodes its samples
+    ///   - scaling: The conversion from raw samples to physical values
+    ///   - chunkSize: The number of bytes to read at a time. Defaults to `attributes.chunkSize`.
+    /// - Returns: The scaled values
+    /// - Throws: ``USBTMCInstrument/Error/invalidBlock`` if the response is not a block of whole samples, or any error thrown by ``readBlock(chunkSize:start:body:)``
+    public func readWaveform(
+        as type: Double.Type,
+        format: WaveformFormat,
+        scaling: WaveformScaling = .identity,
+        chunkSize: Int? = nil
+    ) throws -> [Double] {
+        try readDecodedWaveform(format: format, scaling: scaling, chunkSize: chunkSize)
+    }
+
+    /// Read and decode a waveform block into values of either precision.
+    private func readDecodedWaveform<Sample: BinaryFloatingPoint & SIMDScalar>(
+        format: WaveformFormat,
+        scaling: WaveformScaling,
+        chunkSize: Int?
+    ) throws -> [Sample] {
+        var decoder = WaveformDecoder(format: format, scaling: scaling)
+        var values: [Sample] = []
+        var written = 0
+
+        try readBlock(chunkSize: chunkSize, start: { length in
+            if length % format.sampleSize != 0 {
+                throw Error.invalidBlock
+            }
+            values = [Sample](repeating: 0, count: length / format.sampleSize)
+        }, body: { bytes in
+            values.withUnsafeMutableBufferPointer { output in
+                written += decoder.decodeChunk(bytes, into: UnsafeMutableBufferPointer(rebasing: output[written...]))
+            }
+        })
+
+        return values
+    }
+}
@@ -0,0 +1,244 @@
+//
+//  main.swift
+//  SwiftLibUSBBenchmarks
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import Foundation
+import SwiftLibUSB
+
+// Benchmarks for the USB and USBTMC hot paths, run against a USBTMCEmulator so results don't depend on hardware.
+//
+// Usage: swift run -c release SwiftLibUSBBenchmarks [--iterations N] [--latency SECONDS] [--output PATH]
+//
+// Results are written as JSON to standard output, or to PATH if given, so they can be compared between releases.
+
+struct Options {
+    var iterations = 10_000
+    var latency: TimeInterval = 0
+    var output: String?
+
+    init(arguments: [String]) {
+        var remaining = arguments.dropFirst()
+        while let argument = remaining.popFirst() {
+            switch argument {
+            case "--iterations":
+                iterations = remaining.popFirst().flatMap { Int($0) } ?? iterations
+            case "--latency":
+                latency = remaining.popFirst().flatMap { TimeInterval($0) } ?? latency
+            case "--output":
+                output = remaining.popFirst()
+            default:
+                FileHandle.standardError.write("Unknown argument \(argument)\n".data(using: .utf8)!)
+                exit(2)
+            }
+        }
+    }
+}
+
+struct LatencyResult: Codable {
+    var name: String
+    var iterations: Int
+    var p50Microseconds: Double
+    var p99Microseconds: Double
+    var meanMicroseconds: Double
+}
+
+struct ThroughputResult: Codable {
+    var name: String
+    /// The chunk size of reads, or the message size of writes
+    var size: Int
+    var bytes: Int
+    var megabytesPerSecond: Double
+}
+
+struct EnumerationResult: Codable {
+    var deviceCount: Int
+    var milliseconds: Double
+}
+
+struct AllocationResult: Codable {
+    var name: String
+    /// Swift heap objects allocated per operation, or nil if the runtime can't count them
+    var allocationsPerOperation: Double?
+}
+
+struct Report: Codable {
+    var version = 1
+    var iterations: Int
+    var emulatedLatencySeconds: Double
+    var latency: [LatencyResult] = []
+    var throughput: [ThroughputResult] = []
+    var enumeration: [EnumerationResult] = []
+    var allocations: [AllocationResult] = []
+}
+
+/// Run `body` and return how long it took, in nanoseconds.
+func time(_ body: () throws -> Void) rethrows -> UInt64 {
+    let start = DispatchTime.now().uptimeNanoseconds
+    try body()
+    return DispatchTime.now().uptimeNanoseconds - start
+}
+
+/// Time each of `iterations` calls to `body` and summarize them.
+func measureLatency(_ name: String, iterations: Int, _ body: () throws -> Void) rethrows -> LatencyResult {
+    var samples: [UInt64] = []
+    samples.reserveCapacity(iterations)
+    for _ in 0..<iterations {
+        samples.append(try time(body))
+    }
+    samples.sort()
+    func percentile(_ fraction: Double) -> Double {
+        Double(samples[min(samples.count - 1, Int(Double(samples.count) * fraction))]) / 1000
+    }
+    return LatencyResult(
+        name: name,
+        iterations: iterations,
+        p50Microseconds: percentile(0.5),
+        p99Microseconds: percentile(0.99),
+        meanMicroseconds: Double(samples.reduce(0, +)) / Double(samples.count) / 1000)
+}
+
+// MARK: Allocation counting
+
+/// The Swift runtime calls through this hook for every heap object, including array and string storage.
+typealias AllocObject = @convention(c) (UnsafeRawPointer?, Int, Int) -> UnsafeMutableRawPointer?
+
+var originalAllocObject: AllocObject?
+var allocationCount = 0
+
+/// Start counting Swift heap allocations.
+/// - Returns: False if the runtime does not expose an allocation hook
+func installAllocationCounter() -> Bool {
+    guard let handle = dlopen(nil, RTLD_NOW),
+          let symbol = dlsym(handle, "_swift_allocObject") else {
+        return false
+    }
+    let hook = symbol.assumingMemoryBound(to: Optional<AllocObject>.self)
+    guard let original = hook.pointee else {
+        return false
+    }
+    originalAllocObject = original
+    hook.pointee = { metadata, size, alignment in
+        allocationCount += 1
+        return originalAllocObject!(metadata, size, alignment)
+    }
+    return true
+}
+
+func measureAllocations(_ name: String, iterations: Int, counting: Bool, _ body: () throws -> Void) rethrows -> AllocationResult {
+    // Warm up caches and buffers so only steady state allocations are counted
+    for _ in 0..<10 {
+        try body()
+    }
+    if !counting {
+        return AllocationResult(name: name, allocationsPerOperation: nil)
+    }
+    let before = allocationCount
+    for _ in 0..<iterations {
+        try body()
+    }
+    return AllocationResult(name: name, allocationsPerOperation: Double(allocationCount - before) / Double(iterations))
+}
+
+// MARK: Benchmarks
+
+let options = Options(arguments: CommandLine.arguments)
+var report = Report(iterations: options.iterations, emulatedLatencySeconds: options.latency)
+let canCountAllocations = installAllocationCounter()
+
+var emulatorOptions = USBTMCEmulator.Options()
+emulatorOptions.latency = options.latency
+let emulator = USBTMCEmulator(options: emulatorOptions)
+let instrument = try emulator.makeInstrument()
+
+// Query latency
+report.latency.append(try measureLatency("query *IDN?", iterations: options.iterations) {
+    _ = try instrument.query("*IDN?")
+})
+try instrument.write("VOLT 1.0")
+report.latency.append(try measureLatency("query VOLT?", iterations: options.iterations) {
+    _ = try instrument.query("VOLT?")
+})
+report.latency.append(try measureLatency("write VOLT", iterations: options.iterations) {
+    _ = try instrument.write("VOLT 1.0")
+})
+let queryCache = (instrument.session as! USBSession).queryCache
+queryCache.declare("*IDN?")
+report.latency.append(try measureLatency("cached query *IDN?", iterations: options.iterations) {
+    _ = try instrument.query("*IDN?")
+})
+queryCache.removeAll()
+
+// Bulk throughput
+let payloadSize = 1 << 20
+let payload = Data(repeating: 0x41, count: payloadSize)
+emulator.responder = { message in
+    message.starts(with: Data("DATA?".utf8)) ? payload : nil
+}
+for chunkSize in [64, 256, 1024, 4096, 16384, 65536] {
+    let elapsed = try time {
+        try instrument.write("DATA?")
+        _ = try instrument.readBytes(length: payloadSize, chunkSize: chunkSize)
+    }
+    report.throughput.append(ThroughputResult(
+        name: "bulk read",
+        size: chunkSize,
+        bytes: payloadSize,
+        megabytesPerSecond: Double(payloadSize) / 1_000_000 / (Double(elapsed) / 1_000_000_000)))
+}
+emulator.responder = { _ in nil }
+for size in [64, 1024, 16384, 262144] {
+    let block = Data(repeating: 0x41, count: size)
+    let repetitions = max(1, payloadSize / size)
+    let elapsed = try time {
+        for _ in 0..<repetitions {
+            _ = try instrument.writeBytes(block, appending: nil)
+        }
+    }
+    report.throughput.append(ThroughputResult(
+        name: "bulk write",
+        size: size,
+        bytes: size * repetitions,
+        megabytesPerSecond: Double(size * repetitions) / 1_000_000 / (Double(elapsed) / 1_000_000_000)))
+}
+emulator.responder = nil
+
+// Enumeration: wrap every device and find its USBTMC interfaces, as connecting by VISA string does
+for count in [1, 8, 64, 256] {
+    let emulators = (0..<count).map { _ in USBTMCEmulator() }
+    let elapsed = time {
+        var found = 0
+        for device in emulators.map({ $0.makeDevice() }) {
+            for configuration in device.configurations {
+                for interface in configuration.interfaces {
+                    found += interface.altSettings.filter {
+                        $0.interfaceClass == .application && $0.interfaceSubClass == 0x03
+                    }.count
+                }
+            }
+        }
+        precondition(found == count)
+    }
+    report.enumeration.append(EnumerationResult(deviceCount: count, milliseconds: Double(elapsed) / 1_000_000))
+}
+
+// Allocations
+let allocationIterations = min(options.iterations, 1000)
+report.allocations.append(try measureAllocations("query VOLT?", iterations: allocationIterations, counting: canCountAllocations) {
+    _ = try instrument.query("VOLT?")
+})
+report.allocations.append(try measureAllocations("write VOLT", iterations: allocationIterations, counting: canCountAllocations) {
+    _ = try instrument.write("VOLT 1.0")
+})
+
+let encoder = JSONEncoder()
+encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+let json = try encoder.encode(report)
+if let path = options.output {
+    try json.write(to: URL(fileURLWithPath: path))
+} else {
+    FileHandle.standardOutput.write(json)
+    FileHandle.standardOutput.write("\n".data(using: .utf8)!)
+}
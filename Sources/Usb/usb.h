@@ -8,6 +8,22 @@
 #ifndef usb_h
 #define usb_h
 
+#include <stdint.h>
 #include <libusb.h>
 
+// The descriptor of one packet of an isochronous transfer. Swift can't index the flexible array member itself.
+static inline struct libusb_iso_packet_descriptor *swiftlibusb_iso_packet(struct libusb_transfer *transfer, int index) {
+    return &transfer->iso_packet_desc[index];
+}
+
+// Read a value written by another thread with swiftlibusb_store_release, seeing every write made before it.
+static inline intptr_t swiftlibusb_load_acquire(const intptr_t *value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+// Write a value for another thread to read with swiftlibusb_load_acquire, publishing every write made before it.
+static inline void swiftlibusb_store_release(intptr_t *value, intptr_t newValue) {
+    __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+}
+
 #endif /* usb_h */
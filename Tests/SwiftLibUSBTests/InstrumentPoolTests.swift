@@ -0,0 +1,120 @@
+//
+//  InstrumentPoolTests.swift
+//  SwiftLibUSBTests
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import XCTest
+@testable import SwiftLibUSB
+
+final class InstrumentPoolTests: XCTestCase {
+    private let visaString = "USB0::4617::1::EMULATOR::0::INSTR"
+    /// The emulator behind each instrument the pool has connected, in order.
+    private var emulators: [USBTMCEmulator] = []
+    private var pool: InstrumentPool!
+
+    override func setUp() {
+        emulators = []
+        pool = InstrumentPool { [unowned self] _ in
+            let emulator = USBTMCEmulator()
+            self.emulators.append(emulator)
+            return try emulator.makeInstrument()
+        }
+    }
+
+    override func tearDown() {
+        pool = nil
+        emulators = []
+    }
+
+    func testCheckinReusesInstrument() throws {
+        let first = try pool.checkout(visaString: visaString)
+        pool.checkin(first)
+        let second = try pool.checkout(visaString: visaString)
+        XCTAssertTrue(first === second)
+        XCTAssertEqual(emulators.count, 1)
+
+        // Another resource gets its own instrument, even while the first is checked out
+        let other = try pool.checkout(visaString: "USB0::4617::1::OTHER::0::INSTR")
+        XCTAssertFalse(other === second)
+        XCTAssertEqual(emulators.count, 2)
+    }
+
+    func testCheckinRestoresInstrumentState() throws {
+        let defaults = MessageBasedInstrumentAttributes()
+        let instrument = try pool.checkout(visaString: visaString)
+        instrument.isStateCacheEnabled = true
+        let queryCache = instrument._session.queryCache
+        queryCache.declare("SOUR:VOLT?")
+        try instrument.write(":SOUR:VOLT 1.5")
+        XCTAssertEqual(try instrument.query("SOUR:VOLT?"), "1.5")
+        XCTAssertEqual(try instrument.query("*IDN?"), "SwiftVISA,USBTMC Emulator,EMULATOR,1.0")
+        // Leave a response unread
+        try instrument.write("*IDN?")
+        instrument.attributes.chunkSize = 7
+        instrument.attributes.operationDelay = defaults.operationDelay * 2
+        instrument.attributes.readTerminator = "\r\n"
+        instrument.attributes.writeTerminator = "\r\n"
+        pool.checkin(instrument)
+
+        let reused = try pool.checkout(visaString: visaString)
+        XCTAssertTrue(reused === instrument)
+        let emulator = emulators[0]
+        XCTAssertEqual(emulator.statusByte & 0x10, 0)
+        XCTAssertEqual(reused.attributes.chunkSize, defaults.chunkSize)
+        XCTAssertEqual(reused.attributes.operationDelay, defaults.operationDelay)
+        XCTAssertEqual(reused.attributes.readTerminator, defaults.readTerminator)
+        XCTAssertEqual(reused.attributes.writeTerminator, defaults.writeTerminator)
+        XCTAssertFalse(reused.isStateCacheEnabled)
+
+        // The set command and the query are sent again, and only the default queries are cached
+        let received = emulator.messagesReceived
+        try reused.write(":SOUR:VOLT 1.5")
+        XCTAssertEqual(try reused.query("SOUR:VOLT?"), "1.5")
+        XCTAssertEqual(emulator.messagesReceived, received + 2)
+        XCTAssertNil(queryCache.response(for: "*IDN?"))
+        XCTAssertEqual(try reused.query("*IDN?"), "SwiftVISA,USBTMC Emulator,EMULATOR,1.0")
+        XCTAssertNotNil(queryCache.response(for: "*IDN?"))
+    }
+
+    func testUnhealthyInstrumentIsReplaced() throws {
+        let first = try pool.checkout(visaString: visaString)
+        pool.checkin(first)
+        emulators[0].transport.close()
+
+        let second = try pool.checkout(visaString: visaString)
+        XCTAssertFalse(first === second)
+        XCTAssertEqual(emulators.count, 2)
+        XCTAssertEqual(try second.query("*OPC?"), "1")
+    }
+
+    func testInstrumentRefusingClearIsNotKept() throws {
+        let first = try pool.checkout(visaString: visaString)
+        emulators[0].transport.close()
+        pool.checkin(first)
+
+        let second = try pool.checkout(visaString: visaString)
+        XCTAssertFalse(first === second)
+        XCTAssertEqual(emulators.count, 2)
+    }
+
+    func testDiscardedInstrumentIsNotReused() throws {
+        let first = try pool.checkout(visaString: visaString)
+        pool.discard(first)
+        // Checking in an instrument the pool no longer tracks is ignored
+        pool.checkin(first)
+        let second = try pool.checkout(visaString: visaString)
+        XCTAssertFalse(first === second)
+
+        // A USB error from the body discards the instrument too
+        XCTAssertThrowsError(try pool.withInstrument(visaString: visaString) { instrument -> Void in
+            XCTAssertTrue(instrument !== second)
+            throw USBError.pipe
+        })
+        XCTAssertEqual(emulators.count, 3)
+        pool.checkin(second)
+        XCTAssertTrue(try pool.checkout(visaString: visaString) === second)
+        XCTAssertEqual(emulators.count, 3)
+    }
+}
@@ -0,0 +1,89 @@
+//
+//  NumericResponseParserTests.swift
+//  SwiftLibUSBTests
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import XCTest
+@testable import SwiftLibUSB
+
+final class NumericResponseParserTests: XCTestCase {
+    func testSCPINumberFormats() throws {
+        XCTAssertEqual(try parse("+1.000000E+00\n"), 1)
+        XCTAssertEqual(try parse("  -0.5 "), -0.5)
+        XCTAssertEqual(try parse("42"), 42)
+        XCTAssertEqual(try parse(".25"), 0.25)
+        XCTAssertEqual(try parse("7."), 7)
+        XCTAssertEqual(try parse("1.5e-3\r\n"), 1.5e-3)
+    }
+
+    func testFastPathBoundariesMatchStandardLibrary() throws {
+        let fields = [
+            // 2^53 is the largest mantissa the fast path takes, 2^53 + 1 is not exactly representable
+            "9007199254740992", "9007199254740993", "-9007199254740993",
+            // 19 significant digits still fit in the mantissa, 20 do not
+            "1234567890123456789", "12345678901234567890", "0.1234567890123456789",
+            "1.0000000000000000000001", "100000000000000000000000",
+            // 10^22 is the largest exactly representable power of ten
+            "1e22", "1e-22", "1e23", "1e-23", "3.5E+22", "3.5E-22", "9.9E37", "4.9e-324", "1.7976931348623157e308",
+            "0.1", "0.3", "123.456", "-0.000001",
+        ]
+        for field in fields {
+            XCTAssertEqual(try parse(field), Double(field), field)
+        }
+    }
+
+    func testFallsBackForSpecialValues() throws {
+        XCTAssertEqual(try parse("inf"), Double.infinity)
+        XCTAssertEqual(try parse("-INF"), -Double.infinity)
+        XCTAssertTrue(try parse("nan").isNaN)
+        XCTAssertEqual(try parse("1e400"), Double.infinity)
+    }
+
+    func testRejectsMalformedNumbers() {
+        for field in ["", "   ", "1e", "1e+", "abc", "1.2.3", "--1", "1,2", "e5"] {
+            XCTAssertThrowsError(try parse(field), field) { error in
+                XCTAssertEqual(error as? USBTMCInstrument.Error, .invalidNumber)
+            }
+        }
+    }
+
+    func testListFields() throws {
+        XCTAssertEqual(try parseList("1,-2.5,+3E1\n"), [1, -2.5, 30])
+        XCTAssertEqual(try parseList(" 1 , 2 ,3"), [1, 2, 3])
+        XCTAssertEqual(try parseList("\n"), [])
+        XCTAssertEqual(try parseList("1;2", separator: ";"), [1, 2])
+    }
+
+    func testEmptyFields() throws {
+        // A separator at the very end does not start another field
+        XCTAssertEqual(try parseList("1,2,\n"), [1, 2])
+        XCTAssertThrowsError(try parseList("1,,2"))
+        XCTAssertThrowsError(try parseList(",1"))
+        XCTAssertThrowsError(try parseList("1,2, ,"))
+    }
+
+    func testLongListsParseConcurrently() throws {
+        let values = (0..<60_000).map { Double($0) * 0.001 - 7.5 }
+        let fields = values.map { "\($0)" }
+        var response = fields.joined(separator: ",") + "\n"
+        XCTAssertGreaterThanOrEqual(response.utf8.count, NumericResponseParser.parallelThreshold)
+        XCTAssertEqual(try parseList(response), fields.map { Double($0)! })
+
+        response = fields.joined(separator: ",") + ",x\n"
+        XCTAssertThrowsError(try parseList(response))
+    }
+
+    private func parse(_ response: String) throws -> Double {
+        try Array(response.utf8).withUnsafeBytes { bytes in
+            try NumericResponseParser.parseDouble(bytes)
+        }
+    }
+
+    private func parseList(_ response: String, separator: Character = ",") throws -> [Double] {
+        try Array(response.utf8).withUnsafeBytes { bytes in
+            try NumericResponseParser.parseDoubles(bytes, separator: separator.asciiValue!)
+        }
+    }
+}
@@ -0,0 +1,53 @@
+//
+//  ReadAheadBufferTests.swift
+//  SwiftLibUSBTests
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import XCTest
+@testable import SwiftLibUSB
+
+final class ReadAheadBufferTests: XCTestCase {
+    func testTerminatorSplitAcrossAppends() {
+        var buffer = ReadAheadBuffer()
+        buffer.append(Data("1.5\r".utf8))
+        XCTAssertNil(buffer.endOfFirst([13, 10]))
+        buffer.append(Data("\n2.5\r\n".utf8))
+        XCTAssertEqual(buffer.endOfFirst([13, 10]), 5)
+        XCTAssertEqual(buffer.take(5), Data("1.5\r\n".utf8))
+        XCTAssertEqual(buffer.endOfFirst([13, 10]), 5)
+        XCTAssertEqual(buffer.takeAll(), Data("2.5\r\n".utf8))
+        XCTAssertTrue(buffer.isEmpty)
+    }
+
+    func testSkipsPartialMatches() {
+        var buffer = ReadAheadBuffer()
+        buffer.append(Data("a\rb\r\r\nc".utf8))
+        XCTAssertEqual(buffer.endOfFirst([13, 10]), 6)
+        XCTAssertNil(buffer.endOfFirst([10, 13]))
+        XCTAssertEqual(buffer.endOfFirst([10]), 6)
+        XCTAssertNil(buffer.endOfFirst([]))
+    }
+
+    func testOffsetsCountFromFirstUnreadByte() {
+        var buffer = ReadAheadBuffer()
+        buffer.append(Data("one\ntwo\nthree\n".utf8))
+        XCTAssertEqual(buffer.take(4), Data("one\n".utf8))
+        XCTAssertEqual(buffer.endOfFirst([10]), 4)
+        XCTAssertEqual(buffer.take(4), Data("two\n".utf8))
+        // Appending compacts the bytes already read without losing unread ones
+        buffer.append(Data("four\n".utf8))
+        XCTAssertEqual(buffer.count, 11)
+        XCTAssertEqual(buffer.endOfFirst([10]), 6)
+        XCTAssertEqual(buffer.takeAll(), Data("three\nfour\n".utf8))
+    }
+
+    func testTakeStopsAtUnreadBytes() {
+        var buffer = ReadAheadBuffer()
+        buffer.append(Data("abc".utf8))
+        XCTAssertEqual(buffer.take(10), Data("abc".utf8))
+        XCTAssertTrue(buffer.isEmpty)
+        XCTAssertEqual(buffer.take(1), Data())
+    }
+}
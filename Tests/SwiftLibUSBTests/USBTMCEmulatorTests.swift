@@ -0,0 +1,486 @@
+//
+//  USBTMCEmulatorTests.swift
+//  SwiftLibUSBTests
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import XCTest
+@testable import SwiftLibUSB
+
+final class USBTMCEmulatorTests: XCTestCase {
+    var emulator: USBTMCEmulator!
+    var instrument: USBTMCInstrument!
+
+    override func setUpWithError() throws {
+        emulator = USBTMCEmulator()
+        try instrument = emulator.makeInstrument()
+    }
+
+    override func tearDown() {
+        instrument = nil
+        emulator = nil
+    }
+
+    func testIdentification() throws {
+        XCTAssertEqual(try instrument.query("*IDN?"), "SwiftVISA,USBTMC Emulator,EMULATOR,1.0")
+    }
+
+    func testSetThenQuery() throws {
+        try instrument.write(":SOUR:VOLT 1.5")
+        XCTAssertEqual(try instrument.query("SOUR:VOLT?"), "1.5")
+        XCTAssertEqual(emulator.messagesReceived, 2)
+    }
+
+    func testMultipleChunks() throws {
+        instrument.attributes.chunkSize = 16
+        let response = String(repeating: "0123456789", count: 20)
+        emulator.responder = { _ in Data((response + "\n").utf8) }
+        XCTAssertEqual(try instrument.query("DATA?"), response)
+    }
+
+    func testTerminatorSplitAcrossTransfers() throws {
+        emulator.options.supportsTermChar = false
+        try instrument = emulator.makeInstrument()
+        // The first transfer of the response ends between the carriage return and the line feed
+        let first = String(repeating: "A", count: 16383)
+        emulator.responder = { _ in Data((first + "\r\nB\r\n").utf8) }
+        XCTAssertEqual(try instrument.query("DATA?", readTerminator: "\r\n"), first)
+        XCTAssertEqual(try instrument.read(until: "\r\n", strippingTerminator: true, encoding: .ascii, chunkSize: 64), "B")
+        XCTAssertEqual(emulator.messagesReceived, 1)
+    }
+
+    func testLongWrite() throws {
+        var received = Data()
+        emulator.responder = { message in
+            received = message
+            return nil
+        }
+        let command = String(repeating: "A", count: USBTMCInstrument.maxWriteChunkSize * 3)
+        try instrument.write(command)
+        XCTAssertEqual(received, Data((command + "\n").utf8))
+    }
+
+    func testClearDiscardsResponse() throws {
+        try instrument.write("*IDN?")
+        XCTAssertNotEqual(emulator.statusByte & 0x10, 0)
+        try instrument.clear()
+        XCTAssertEqual(emulator.statusByte & 0x10, 0)
+        XCTAssertEqual(try instrument.query("*OPC?"), "1")
+    }
+
+    func testPrepareForReuseClearsDevice() throws {
+        instrument.isStateCacheEnabled = true
+        try instrument.write("VOLT 1.0")
+        try instrument.write("*IDN?")
+        XCTAssertNotEqual(emulator.statusByte & 0x10, 0)
+        try instrument.prepareForReuse()
+        XCTAssertEqual(emulator.statusByte & 0x10, 0)
+        try instrument.write("VOLT 1.0")
+        XCTAssertEqual(emulator.messagesReceived, 3)
+        XCTAssertEqual(try instrument.query("*OPC?"), "1")
+    }
+
+    func testEmulatorStallsMisaddressedClassRequests() throws {
+        let transport = emulator.transport
+        func send(_ requestType: UInt8, _ request: UInt8, index: UInt16, length: UInt16) throws -> [UInt8] {
+            var data = [UInt8](repeating: 0, count: Int(length))
+            let setup = USBControlSetup(requestType: requestType, request: request, value: 1, index: index, length: length)
+            let count = try data.withUnsafeMutableBytes { buffer in
+                try transport.controlTransfer(setup, data: buffer, timeout: 1000)
+            }
+            return Array(data[..<count])
+        }
+
+        // GET_CAPABILITIES and INITIATE_CLEAR only answer on interface 0
+        XCTAssertEqual(try send(0xA1, 7, index: 0, length: 24).first, 0x01)
+        XCTAssertThrowsError(try send(0xA1, 7, index: 1, length: 24)) { error in
+            XCTAssertEqual(error as? USBError, .pipe)
+        }
+        XCTAssertThrowsError(try send(0xA1, 5, index: 1, length: 1)) { error in
+            XCTAssertEqual(error as? USBError, .pipe)
+        }
+        XCTAssertThrowsError(try send(0xA2, 5, index: 0x01, length: 1)) { error in
+            XCTAssertEqual(error as? USBError, .pipe)
+        }
+
+        // Aborts only answer on the endpoint they abort
+        XCTAssertNoThrow(try send(0xA2, 1, index: 0x01, length: 2))
+        XCTAssertNoThrow(try send(0xA2, 2, index: 0x01, length: 8))
+        XCTAssertNoThrow(try send(0xA2, 3, index: 0x82, length: 2))
+        XCTAssertNoThrow(try send(0xA2, 4, index: 0x82, length: 8))
+        for (request, index) in [(1, 0x82), (3, 0x01), (1, 0x00), (3, 0x00)] as [(UInt8, UInt16)] {
+            XCTAssertThrowsError(try send(0xA2, request, index: index, length: 2)) { error in
+                XCTAssertEqual(error as? USBError, .pipe)
+            }
+        }
+        XCTAssertThrowsError(try send(0xA1, 3, index: 0x82, length: 2)) { error in
+            XCTAssertEqual(error as? USBError, .pipe)
+        }
+    }
+
+    func testInMemoryTransportDefaults() throws {
+        let transport = emulator.transport
+        XCTAssertEqual(try transport.activeConfiguration(), 1)
+        XCTAssertEqual(transport.claimedInterfaces, [0])
+        XCTAssertEqual(instrument._session.device.serialNumber, "EMULATOR")
+    }
+
+    func testSelectsInterfaceByNumber() throws {
+        instrument = nil
+        let selected = try USBTMCInstrument(device: emulator.makeDevice(), interfaceNumber: 0)
+        XCTAssertEqual(try selected.query("*OPC?"), "1")
+        XCTAssertThrowsError(try USBTMCInstrument(device: emulator.makeDevice(), interfaceNumber: 1)) { error in
+            XCTAssertEqual(error as? USBTMCInstrument.Error, .couldNotFindEndpoint)
+        }
+    }
+
+    func testBadTagHaltsEndpoint() throws {
+        let header: [UInt8] = [1, 5, 5, 0, 0, 0, 0, 0, 1, 0, 0, 0]
+        let device = instrument._session.device
+        var bytes = header
+        XCTAssertThrowsError(try bytes.withUnsafeMutableBytes { buffer in
+            try device.transport.bulkTransfer(endpoint: 0x01, data: buffer, timeout: 1000)
+        }) { error in
+            XCTAssertEqual(error as? USBError, .pipe)
+        }
+        XCTAssertEqual(try instrument.recover(), .cleared)
+        XCTAssertEqual(try instrument.query("*OPC?"), "1")
+    }
+
+    func testTraceRecordsQuery() throws {
+        USBTrace.start()
+        _ = try instrument.query("*IDN?")
+        USBTrace.stop()
+        let names = USBTrace.events.map { $0.name }
+        XCTAssert(names.contains("query"))
+        XCTAssert(names.contains("decode"))
+        XCTAssertNoThrow(try JSONSerialization.jsonObject(with: USBTrace.chromeTrace()))
+    }
+
+    func testTraceKeepsEventsOfExitedThreadsUntilReset() throws {
+        USBTrace.start()
+        _ = try instrument.query("*IDN?")
+        guard let ownThread = USBTrace.events.first?.threadID else {
+            XCTFail("No events were recorded")
+            return
+        }
+        let finished = DispatchSemaphore(value: 0)
+        let thread = Thread { [instrument] in
+            _ = try? instrument?.query("*OPC?")
+            finished.signal()
+        }
+        thread.start()
+        finished.wait()
+        XCTAssertEqual(Set(USBTrace.events.map { $0.threadID }).count, 2)
+
+        USBTrace.reset()
+        XCTAssertTrue(USBTrace.events.isEmpty)
+        _ = try instrument.query("*OPC?")
+        USBTrace.stop()
+        XCTAssertFalse(USBTrace.events.isEmpty)
+        XCTAssertEqual(Set(USBTrace.events.map { $0.threadID }), [ownThread])
+        XCTAssertEqual(USBTrace.droppedEventCount, 0)
+    }
+
+    func testStatisticsCountOperations() throws {
+        _ = try instrument.query("*IDN?")
+        try instrument.write("VOLT 1.0")
+        try instrument.clear()
+        let statistics = instrument.statistics
+        XCTAssertEqual(statistics.query.count, 1)
+        XCTAssertEqual(statistics.write.count, 1)
+        XCTAssertEqual(statistics.clears, 1)
+        XCTAssertGreaterThan(statistics.bulkOut.transfers, 0)
+        XCTAssertGreaterThan(statistics.bulkIn.bytes, 0)
+        XCTAssertEqual(statistics.bulkIn.errors, 0)
+        XCTAssertLessThanOrEqual(statistics.query.percentile(50), statistics.query.max)
+    }
+
+    func testLatencyHistogramPercentiles() {
+        var histogram = LatencyHistogram()
+        for microseconds in 1...1000 {
+            histogram.record(nanoseconds: UInt64(microseconds) * 1000)
+        }
+        XCTAssertEqual(histogram.count, 1000)
+        XCTAssertEqual(histogram.percentile(50), 500e-6, accuracy: 500e-6 * 0.0625)
+        XCTAssertEqual(histogram.percentile(99), 990e-6, accuracy: 990e-6 * 0.0625)
+        XCTAssertEqual(histogram.percentile(100), 1e-3)
+        XCTAssertEqual(histogram.mean, 500.5e-6, accuracy: 1e-9)
+    }
+
+    func testCaptureWritesUsbmonPcap() throws {
+        let url = FileManager.default.temporaryDirectory.appendingPathComponent("\(UUID().uuidString).pcap")
+        defer { try? FileManager.default.removeItem(at: url) }
+        try USBCapture.start(writingTo: url)
+        _ = try instrument.query("*IDN?")
+        USBCapture.stop()
+
+        let capture = [UInt8](try Data(contentsOf: url))
+        XCTAssertEqual(Array(capture[0..<4]), [0xD4, 0xC3, 0xB2, 0xA1])
+        XCTAssertEqual(capture[20], 220)
+        // Each transfer is a submission followed by a completion, each with a record and usbmon header
+        var events: [UInt8] = []
+        var offset = 24
+        while offset + 16 <= capture.count {
+            let length = Int(capture[offset + 8]) | Int(capture[offset + 9]) << 8 | Int(capture[offset + 10]) << 16
+            events.append(capture[offset + 16 + 8])
+            offset += 16 + length
+        }
+        XCTAssertEqual(offset, capture.count)
+        XCTAssertEqual(events.filter { $0 == UInt8(ascii: "S") }.count, events.filter { $0 == UInt8(ascii: "C") }.count)
+        XCTAssertGreaterThanOrEqual(events.count, 4)
+    }
+
+    func testTransferCompletingAfterCaptureStops() throws {
+        let url = FileManager.default.temporaryDirectory.appendingPathComponent("\(UUID().uuidString).pcap")
+        defer { try? FileManager.default.removeItem(at: url) }
+        try USBCapture.start(writingTo: url)
+        var bytes = [UInt8](repeating: 0, count: 8)
+        let count = bytes.withUnsafeMutableBytes { buffer in
+            USBCapture.capture(.bulk, transport: emulator.transport, endpoint: 0x82, data: buffer) {
+                USBCapture.stop()
+                return buffer.count
+            }
+        }
+        XCTAssertEqual(count, 8)
+        // The submission was written before the file closed, and the completion is left out
+        let capture = try Data(contentsOf: url)
+        XCTAssertEqual(capture.count, 24 + 16 + 64)
+    }
+
+    func testRecordAndReplay() throws {
+        let url = FileManager.default.temporaryDirectory.appendingPathComponent("\(UUID().uuidString).usbrec")
+        defer { try? FileManager.default.removeItem(at: url) }
+        let recorder = try SessionRecorder(recording: emulator.makeDevice(), to: url)
+        let recorded = try USBTMCInstrument(device: recorder.device)
+        try recorded.write("VOLT 2.5")
+        XCTAssertEqual(try recorded.query("VOLT?"), "2.5")
+        try recorder.close()
+        XCTAssertGreaterThan(recorder.transferCount, 0)
+
+        let replay = try SessionReplay(contentsOf: url)
+        // The query was pipelined, and only the response it waited for carries the time the device took
+        let pipeline = replay.transfers.suffix(3)
+        XCTAssertEqual(pipeline.map { $0.endpoint }, [0x01, 0x01, 0x82])
+        XCTAssertEqual(pipeline.map { $0.duration }.prefix(2), [0, 0])
+        XCTAssertEqual(pipeline.map { $0.gap }.suffix(2), [0, 0])
+        replay.timeScale = 0
+        let replayed = try replay.makeInstrument()
+        XCTAssertEqual(replayed._session.device.serialNumber, "EMULATOR")
+        try replayed.write("VOLT 2.5")
+        XCTAssertEqual(try replayed.query("VOLT?"), "2.5")
+        XCTAssertEqual(replay.mismatchCount, 0)
+        XCTAssertEqual(replay.remainingCount, 0)
+    }
+
+    func testMetricsExposition() throws {
+        let exporter = MetricsExporter()
+        exporter.register(instrument, name: "psu")
+        _ = try instrument.query("*IDN?")
+        let text = exporter.exposition()
+        XCTAssert(text.contains("swiftlibusb_queries_total{instrument=\"psu\"} 1\n"))
+        XCTAssert(text.contains("swiftlibusb_session_open{instrument=\"psu\"} 1\n"))
+        XCTAssert(text.contains("# TYPE swiftlibusb_transfer_bytes_total counter\n"))
+        instrument = nil
+        XCTAssertFalse(exporter.exposition().contains("psu"))
+    }
+
+    func testMetricsFollowSessionState() throws {
+        let exporter = MetricsExporter()
+        exporter.register(instrument, name: "psu")
+        try instrument._session.reconnect(timeout: 1000)
+        XCTAssert(exporter.exposition().contains("swiftlibusb_reconnects_total{instrument=\"psu\"} 1\n"))
+        XCTAssertEqual(instrument.statistics.reconnects, 1)
+        instrument._session.close()
+        XCTAssert(exporter.exposition().contains("swiftlibusb_session_open{instrument=\"psu\"} 0\n"))
+        XCTAssertFalse(instrument.statistics.isSessionOpen)
+    }
+
+    func testMetricsLabelIsDiscoveryResourceString() {
+        let exporter = MetricsExporter()
+        exporter.register(instrument)
+        XCTAssert(exporter.exposition().contains("{instrument=\"USB0::4617::1::EMULATOR::0::INSTR\"}"))
+    }
+
+    func testPollingDeliversServiceRequests() throws {
+        let device = instrument._session.device
+        let endpoints = device.configurations[0].interfaces[0].altSettings[0].endpoints
+        guard let statusEndpoint = endpoints.first(where: { $0.transferType == .interrupt }) else {
+            return XCTFail("The emulator has no interrupt endpoint")
+        }
+        XCTAssertThrowsError(try endpoints[0].startPolling { _ in })
+
+        let received = expectation(description: "service requests")
+        received.expectedFulfillmentCount = 3
+        var reports: [Data] = []
+        let polling = try statusEndpoint.startPolling { result in
+            if case .success(let report) = result {
+                reports.append(report)
+                received.fulfill()
+            }
+        }
+        for status: UInt8 in [1, 2, 4] {
+            emulator.statusByte = status
+            emulator.requestService()
+        }
+        wait(for: [received], timeout: 5)
+        polling.stop()
+
+        XCTAssertEqual(reports, [Data([0x81, 0x41]), Data([0x81, 0x42]), Data([0x81, 0x44])])
+        XCTAssertEqual(statusEndpoint.statistics.transfers, 3)
+    }
+
+    func testBatchCountsQueriesInCompoundCommands() throws {
+        XCTAssertEqual(CommandBatch.queryCount(":VOLT 1;VOLT?"), 1)
+        XCTAssertEqual(CommandBatch.queryCount(":VOLT?;CURR?"), 2)
+        let responses = try instrument.batch(["VOLT 1.5;VOLT?", "CURR 0.2", "VOLT?;CURR?"])
+        XCTAssertEqual(responses, ["1.5", "1.5", "0.2"])
+        XCTAssertEqual(emulator.messagesReceived, 1)
+    }
+
+    func testBatchThrowsOnResponseCountMismatch() throws {
+        emulator.responder = { _ in Data("1\n".utf8) }
+        XCTAssertThrowsError(try instrument.batch(["VOLT?;CURR?"])) { error in
+            XCTAssertEqual(error as? USBTMCInstrument.Error, .responseCountMismatch)
+        }
+        emulator.responder = { _ in Data("1;2\n".utf8) }
+        XCTAssertThrowsError(try instrument.batch(["VOLT?"])) { error in
+            XCTAssertEqual(error as? USBTMCInstrument.Error, .responseCountMismatch)
+        }
+    }
+
+    func testStateCacheSkipsRepeatedSets() throws {
+        instrument.isStateCacheEnabled = true
+        try instrument.write("VOLT 1.0")
+        try instrument.write("VOLT 1.0")
+        try instrument.write(":volt 1.0")
+        XCTAssertEqual(emulator.messagesReceived, 1)
+        try instrument.write("VOLT 2.0")
+        XCTAssertEqual(emulator.messagesReceived, 2)
+        XCTAssertEqual(try instrument.query("VOLT?"), "2.0")
+    }
+
+    func testStateCacheResolvesRelativeHeaders() throws {
+        guard case let .sets(sets, hasQueries) = SCPIStateCache.effect(of: "SOUR:VOLT 1;CURR 2;:OUTP ON;STAT?") else {
+            return XCTFail("The message should be understood")
+        }
+        XCTAssertEqual(sets.map { $0.header }, ["SOUR:VOLT", "SOUR:CURR", "OUTP"])
+        XCTAssertEqual(sets.map { $0.value }, ["1", "2", "ON"])
+        XCTAssertTrue(hasQueries)
+
+        instrument.isStateCacheEnabled = true
+        try instrument.write(":SOUR:VOLT 1;CURR 2")
+        try instrument.write("SOUR:CURR 2")
+        try instrument.write("SOUR:VOLT 1;*RST")
+        try instrument.write("SOUR:VOLT 1")
+        XCTAssertEqual(emulator.messagesReceived, 3)
+    }
+
+    func testStateCacheForgetsOnClearAndReconnect() throws {
+        instrument.isStateCacheEnabled = true
+        try instrument.write("VOLT 1.0")
+        try instrument.clear()
+        try instrument.write("VOLT 1.0")
+        XCTAssertEqual(emulator.messagesReceived, 2)
+        try instrument._session.reconnect(timeout: 1000)
+        try instrument.write("VOLT 1.0")
+        XCTAssertEqual(emulator.messagesReceived, 3)
+    }
+
+    func testQueryCacheMatchesDeclaredQueries() throws {
+        let cache = instrument._session.queryCache
+        XCTAssertEqual(try instrument.query("*IDN?"), "SwiftVISA,USBTMC Emulator,EMULATOR,1.0")
+        XCTAssertEqual(try instrument.query(" *idn? "), "SwiftVISA,USBTMC Emulator,EMULATOR,1.0")
+        XCTAssertEqual(emulator.messagesReceived, 1)
+        cache.declare(":SYST:ERR?")
+        _ = try instrument.query("syst:err?")
+        _ = try instrument.query(":Syst:Err?")
+        _ = try instrument.query("SYST:ERR:NEXT?")
+        XCTAssertEqual(emulator.messagesReceived, 3)
+
+        cache.undeclare("*IDN?")
+        cache.undeclare("*OPT?")
+        cache.undeclare("SYST:VERS?")
+        cache.undeclare("SYST:ERR?")
+        _ = try instrument.query("*IDN?")
+        _ = try instrument.query("*IDN?")
+        XCTAssertEqual(emulator.messagesReceived, 5)
+    }
+
+    func testQueryCacheExpiresAndForgetsOnReconnect() throws {
+        instrument._session.queryCache.declare("VOLT?", timeToLive: 0.05)
+        try instrument.write("VOLT 1.0")
+        XCTAssertEqual(try instrument.query("VOLT?"), "1.0")
+        try instrument.write("VOLT 2.0")
+        XCTAssertEqual(try instrument.query("VOLT?"), "1.0")
+        Thread.sleep(forTimeInterval: 0.1)
+        XCTAssertEqual(try instrument.query("VOLT?"), "2.0")
+
+        _ = try instrument.query("*IDN?")
+        let received = emulator.messagesReceived
+        try instrument._session.reconnect(timeout: 1000)
+        _ = try instrument.query("*IDN?")
+        XCTAssertEqual(emulator.messagesReceived, received + 1)
+    }
+
+    func testFailedBlockReadDiscardsRestOfMessage() throws {
+        instrument.attributes.chunkSize = 4
+        emulator.responder = { message in
+            if message.starts(with: Data("CURV?".utf8)) {
+                return Data("#216".utf8) + Data(repeating: 0x41, count: 16) + Data("\n".utf8)
+            }
+            if message.starts(with: Data("BAD?".utf8)) {
+                return Data("1,2,3,4,5,6,7,8\n".utf8)
+            }
+            return Data("1\n".utf8)
+        }
+        var samples = [Int16](repeating: 0, count: 2)
+        try instrument.write("CURV?")
+        XCTAssertThrowsError(try samples.withUnsafeMutableBufferPointer { buffer in
+            try instrument.readBlock(into: buffer)
+        }) { error in
+            XCTAssertEqual(error as? USBTMCInstrument.Error, .bufferTooSmall)
+        }
+        XCTAssertEqual(try instrument.query("*OPC?"), "1")
+
+        try instrument.write("BAD?")
+        XCTAssertThrowsError(try instrument.readBlock()) { error in
+            XCTAssertEqual(error as? USBTMCInstrument.Error, .invalidBlock)
+        }
+        XCTAssertEqual(try instrument.query("*OPC?"), "1")
+    }
+
+    func testIsochronousRingKeepsOrderAndCountsDrops() {
+        let ring = IsochronousPacketRing(packetSize: 4, minimumCapacity: 6)
+        XCTAssertEqual(ring.capacity, 8)
+        // Packet n is the two bytes [n, n]
+        let bytes = (0..<10).flatMap { [UInt8($0), UInt8($0)] }
+        let packets = (0..<10).map { [UInt8($0), UInt8($0)] }
+        var received: [[UInt8]] = []
+        var errors: [USBError] = []
+        let collect = { (packet: IsochronousStream.Packet) in
+            received.append(Array(packet.data))
+            if let error = packet.error {
+                errors.append(error)
+            }
+        }
+
+        bytes.withUnsafeBytes { all in
+            ring.append(count: 5) { index in
+                (index == 2 ? USBError.overflow : nil, UnsafeRawBufferPointer(rebasing: all[(index * 2)..<(index * 2 + 2)]))
+            }
+            XCTAssertEqual(ring.read(maxPackets: 3, collect), 3)
+            ring.append(count: 10) { index in
+                (nil, UnsafeRawBufferPointer(rebasing: all[(index * 2)..<(index * 2 + 2)]))
+            }
+        }
+        XCTAssertEqual(ring.count, 8)
+        XCTAssertEqual(ring.droppedCount, 4)
+        XCTAssertEqual(ring.read(maxPackets: Int.max, collect), 8)
+
+        XCTAssertEqual(received, Array(packets[0..<5] + packets[0..<6]))
+        XCTAssertEqual(errors, [.overflow])
+        XCTAssertFalse(ring.wait(until: DispatchTime.now()))
+    }
+}
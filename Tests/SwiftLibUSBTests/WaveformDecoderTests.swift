@@ -0,0 +1,125 @@
+//
+//  WaveformDecoderTests.swift
+//  SwiftLibUSBTests
+//
+//  Created by SwiftVISA contributors on 10/16/26.
+//
+
+import XCTest
+@testable import SwiftLibUSB
+
+final class WaveformDecoderTests: XCTestCase {
+    /// Eleven samples, so eight go through the SIMD loop and three through the scalar tail.
+    private let int16Samples: [Int16] = [-32768, -1, 0, 1, 2, 300, 32767, -300, 5, 6, 7]
+
+    func testInt16SIMDAndTailMatchScalar() {
+        let scaling = WaveformScaling(increment: 0.5, origin: 1, reference: 2)
+        let expected = int16Samples.map { (Double($0) - 2) * 0.5 + 1 }
+        for byteOrder in [WaveformFormat.ByteOrder.bigEndian, .littleEndian] {
+            let bytes = Self.bytes(of: int16Samples, byteOrder: byteOrder)
+            let format = WaveformFormat(sampleType: .int16, byteOrder: byteOrder)
+            XCTAssertEqual(decode(bytes, format, scaling: scaling), expected)
+            // Fewer than eight samples at a time only ever take the scalar path
+            XCTAssertEqual(decode(bytes, format, scaling: scaling, chunkSize: 6), expected)
+        }
+    }
+
+    func testInt32ByteOrders() {
+        let samples: [Int32] = [Int32.min, -65536, -1, 0, 1, 65536, 0x0102_0304, Int32.max, 42]
+        let expected = samples.map { Double($0) }
+        for byteOrder in [WaveformFormat.ByteOrder.bigEndian, .littleEndian] {
+            let format = WaveformFormat(sampleType: .int32, byteOrder: byteOrder)
+            XCTAssertEqual(decode(Self.bytes(of: samples, byteOrder: byteOrder), format), expected)
+        }
+    }
+
+    func testFloat32ByteOrders() {
+        let samples: [Float] = [1.5, -2.25, 0.001, -0, 3.0e38, -1.0e-38, 100, 0.1, 7.75]
+        let bitPatterns = samples.map { $0.bitPattern }
+        for byteOrder in [WaveformFormat.ByteOrder.bigEndian, .littleEndian] {
+            let bytes = Self.bytes(of: bitPatterns, byteOrder: byteOrder)
+            let format = WaveformFormat(sampleType: .float32, byteOrder: byteOrder)
+            XCTAssertEqual(decode(bytes, format), samples.map { Double($0) })
+            XCTAssertEqual(decodeFloats(bytes, format), samples)
+        }
+    }
+
+    func testSamplesSplitAtEveryByte() {
+        let bytes = Self.bytes(of: int16Samples, byteOrder: .bigEndian)
+        let format = WaveformFormat(sampleType: .int16)
+        let expected = int16Samples.map { Double($0) }
+        for chunkSize in 1...5 {
+            XCTAssertEqual(decode(bytes, format, chunkSize: chunkSize), expected)
+        }
+    }
+
+    func testEightBitSamples() {
+        let bytes: [UInt8] = [0, 1, 127, 128, 255, 2, 3, 4, 5, 200]
+        XCTAssertEqual(decode(bytes, WaveformFormat(sampleType: .uint8)), bytes.map { Double($0) })
+        XCTAssertEqual(
+            decode(bytes, WaveformFormat(sampleType: .int8)),
+            bytes.map { Double(Int8(bitPattern: $0)) })
+    }
+
+    func testReadWaveformFromInstrument() throws {
+        let emulator = USBTMCEmulator()
+        let instrument = try emulator.makeInstrument()
+        instrument.attributes.chunkSize = 7
+        let payload = Self.bytes(of: int16Samples, byteOrder: .bigEndian)
+        emulator.responder = { _ in Data("#222".utf8) + Data(payload) + Data("\n".utf8) }
+        try instrument.write(":WAV:DATA?")
+        let values = try instrument.readWaveform(
+            as: Float.self,
+            format: WaveformFormat(sampleType: .int16),
+            scaling: WaveformScaling(increment: 0.5, origin: 1, reference: 2))
+        XCTAssertEqual(values, int16Samples.map { (Float($0) - 2) * 0.5 + 1 })
+    }
+
+    /// The bytes of `samples`, each in the given byte order.
+    private static func bytes<T: FixedWidthInteger>(of samples: [T], byteOrder: WaveformFormat.ByteOrder) -> [UInt8] {
+        samples.flatMap { sample -> [UInt8] in
+            let ordered = byteOrder == .bigEndian ? sample.bigEndian : sample.littleEndian
+            return withUnsafeBytes(of: ordered) { Array($0) }
+        }
+    }
+
+    /// Decode `bytes` as double precision values, fed to the decoder `chunkSize` bytes at a time.
+    private func decode(
+        _ bytes: [UInt8],
+        _ format: WaveformFormat,
+        scaling: WaveformScaling = .identity,
+        chunkSize: Int? = nil
+    ) -> [Double] {
+        var decoder = WaveformDecoder(format: format, scaling: scaling)
+        var output = [Double](repeating: .nan, count: bytes.count / format.sampleSize)
+        var written = 0
+        let step = chunkSize ?? bytes.count
+        bytes.withUnsafeBytes { all in
+            output.withUnsafeMutableBufferPointer { buffer in
+                var offset = 0
+                while offset < all.count {
+                    let end = min(offset + step, all.count)
+                    written += decoder.decode(
+                        UnsafeRawBufferPointer(rebasing: all[offset..<end]),
+                        into: UnsafeMutableBufferPointer(rebasing: buffer[written...]))
+                    offset = end
+                }
+            }
+        }
+        XCTAssertEqual(written, output.count)
+        return output
+    }
+
+    /// Decode `bytes` as single precision values in one call.
+    private func decodeFloats(_ bytes: [UInt8], _ format: WaveformFormat) -> [Float] {
+        var decoder = WaveformDecoder(format: format)
+        var output = [Float](repeating: .nan, count: bytes.count / format.sampleSize)
+        let written = bytes.withUnsafeBytes { all in
+            output.withUnsafeMutableBufferPointer { buffer in
+                decoder.decode(all, into: buffer)
+            }
+        }
+        XCTAssertEqual(written, output.count)
+        return output
+    }
+}